@@ -0,0 +1,123 @@
+#include "AudioGate.h"
+
+static const char* const GATE_STATE_NAMES[] = { "closed", "confirming", "open", "lockout" };
+
+AudioGate::AudioGate() :
+  config(nullptr),
+  state(GATE_CLOSED),
+  stateSince(0),
+  wasAboveOn(false),
+  relaysWereActive(false),
+  offThreshold(0.0),
+  hystDb(-1.0),
+  hystRatio(1.0),
+  slowEnvelope(0.0),
+  preArmCondition(false),
+  preArmRequest(false),
+  openCount(0),
+  suppressedShort(0),
+  suppressedLockout(0),
+  lockoutCount(0) {
+}
+
+void AudioGate::init(ConfigManager* config) {
+  this->config = config;
+  stateSince = millis();
+}
+
+void AudioGate::enter(AudioGateState newState, unsigned long now) {
+  state = newState;
+  stateSince = now;
+}
+
+// Zwraca true, gdy sygnał audio jest obecny (bramka otwarta)
+bool AudioGate::update(float envelope, float onThreshold, bool relaysActive) {
+  unsigned long now = millis();
+
+  if (config->getAudioHystDb() != hystDb) {
+    hystDb = config->getAudioHystDb();
+    hystRatio = powf(10.0f, -hystDb / 20.0f);
+  }
+  offThreshold = onThreshold * hystRatio;
+
+  bool aboveOn = envelope >= onThreshold;
+  bool risingEdge = aboveOn && !wasAboveOn;
+  wasAboveOn = aboveOn;
+
+  // Wyłączenie przekaźników rozpoczyna blokadę detekcji
+  if (relaysWereActive && !relaysActive && config->getAudioLockoutMs() > 0) {
+    enter(GATE_LOCKOUT, now);
+    lockoutCount++;
+  }
+  relaysWereActive = relaysActive;
+
+  bool open = evaluate(envelope, onThreshold, aboveOn, risingEdge, now);
+
+  // Żądanie pre-arm na zboczu warunku: obwiednia rośnie szybciej niż wolna
+  // obwiednia odniesienia albo już przekroczyła próg i czeka na potwierdzenie
+  bool rising = envelope - slowEnvelope >= AUDIO_PREARM_RISE * (onThreshold - offThreshold);
+  bool condition = (state == GATE_CLOSED || state == GATE_CONFIRMING) && envelope >= offThreshold &&
+                   (rising || state == GATE_CONFIRMING);
+  if (condition && !preArmCondition) preArmRequest = true;
+  preArmCondition = condition;
+  slowEnvelope += AUDIO_PREARM_SLOW_ALPHA * (envelope - slowEnvelope);
+
+  return open;
+}
+
+bool AudioGate::evaluate(float envelope, float onThreshold, bool aboveOn, bool risingEdge, unsigned long now) {
+  switch (state) {
+    case GATE_LOCKOUT:
+      if (now - stateSince < config->getAudioLockoutMs()) {
+        if (risingEdge) suppressedLockout++;
+        return false;
+      }
+      enter(GATE_CLOSED, now);
+      // fall through - sygnał trwający w chwili końca blokady jest oceniany od razu
+
+    case GATE_CLOSED:
+      if (!aboveOn) return false;
+      enter(GATE_CONFIRMING, now);
+      // fall through - przy audioConfirmMs = 0 bramka otwiera się od razu
+
+    case GATE_CONFIRMING:
+      if (!aboveOn) {
+        suppressedShort++;
+        enter(GATE_CLOSED, now);
+        return false;
+      }
+      if (now - stateSince < config->getAudioConfirmMs()) return false;
+      enter(GATE_OPEN, now);
+      openCount++;
+      return true;
+
+    case GATE_OPEN:
+      if (envelope >= offThreshold) return true;
+      enter(GATE_CLOSED, now);
+      return false;
+  }
+  return false;
+}
+
+const char* AudioGate::getStateName() {
+  return GATE_STATE_NAMES[state];
+}
+
+void AudioGate::addDiagnostics(JsonObject diag) {
+  diag["state"] = getStateName();
+  diag["offThreshold"] = offThreshold;
+  diag["opens"] = openCount;
+  diag["suppressedShort"] = suppressedShort;
+  diag["suppressedLockout"] = suppressedLockout;
+  diag["lockouts"] = lockoutCount;
+}
+
+void AudioGate::printDiagnostics(Stream* out) {
+  out->println();
+  out->println("BRAMKA AUDIO:");
+  out->printf("  stan:            %s (%lu ms)\n", getStateName(), millis() - stateSince);
+  out->printf("  próg wyłączenia: %.3f V (histereza %.1f dB)\n", offThreshold, config->getAudioHystDb());
+  out->printf("  potwierdzenie:   %u ms, blokada: %u ms\n", config->getAudioConfirmMs(), config->getAudioLockoutMs());
+  out->printf("  otwarć:          %lu, blokad: %lu\n", (unsigned long)openCount, (unsigned long)lockoutCount);
+  out->printf("  odrzucone:       %lu krótkich, %lu w blokadzie\n", (unsigned long)suppressedShort, (unsigned long)suppressedLockout);
+}
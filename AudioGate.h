@@ -0,0 +1,64 @@
+#ifndef AUDIO_GATE_H
+#define AUDIO_GATE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ConfigManager.h"
+
+#define AUDIO_PREARM_SLOW_ALPHA 0.05f   // wolna obwiednia odniesienia dla nachylenia
+#define AUDIO_PREARM_RISE 0.5f          // wzrost ponad wolną obwiednię, ułamek (próg wł. - próg wył.)
+
+enum AudioGateState {
+  GATE_CLOSED,       // cisza, czeka na przekroczenie progu włączenia
+  GATE_CONFIRMING,   // obwiednia powyżej progu włączenia, odliczanie audioConfirmMs
+  GATE_OPEN,         // sygnał obecny, utrzymany do spadku poniżej progu wyłączenia
+  GATE_LOCKOUT       // po wyłączeniu przekaźników detekcja zablokowana
+};
+
+// Bramka audio z histerezą. Otwiera się dopiero, gdy obwiednia utrzyma się
+// powyżej progu włączenia przez audioConfirmMs, i zamyka po spadku poniżej
+// progu wyłączenia (próg włączenia - audioHystDb). Tylko otwarta bramka
+// przedłuża czas podtrzymania. Po wyłączeniu przekaźników krótki impuls
+// (np. trzask przy wyłączaniu radia) nie uruchamia ponownie sekwencji przez
+// audioLockoutMs.
+//
+// Narastająca obwiednia (powyżej progu wyłączenia i szybko ponad wolną
+// obwiednię odniesienia) zgłasza żądanie pre-arm przetwornicy, zanim
+// detekcja zostanie potwierdzona.
+class AudioGate {
+private:
+  ConfigManager* config;
+  AudioGateState state;
+  unsigned long stateSince;       // ms
+  bool wasAboveOn;
+  bool relaysWereActive;
+  float offThreshold;
+  float hystDb;
+  float hystRatio;
+  float slowEnvelope;
+  bool preArmCondition;
+  bool preArmRequest;
+
+  uint32_t openCount;
+  uint32_t suppressedShort;       // impulsy krótsze niż audioConfirmMs
+  uint32_t suppressedLockout;     // przekroczenia progu w czasie blokady
+  uint32_t lockoutCount;
+
+  void enter(AudioGateState newState, unsigned long now);
+  bool evaluate(float envelope, float onThreshold, bool aboveOn, bool risingEdge, unsigned long now);
+
+public:
+  AudioGate();
+  void init(ConfigManager* config);
+  bool update(float envelope, float onThreshold, bool relaysActive);
+  bool isOpen() { return state == GATE_OPEN; }
+  bool takePreArmRequest() { bool request = preArmRequest; preArmRequest = false; return request; }
+  AudioGateState getState() { return state; }
+  const char* getStateName();
+  float getOffThreshold() { return offThreshold; }
+  uint32_t getSuppressedCount() { return suppressedShort + suppressedLockout; }
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "BatteryGuard.h"
+
+BatteryGuard::BatteryGuard() :
+  sampleTimer(NULL),
+  alertTask(NULL),
+  mode(BATT_MONITOR_LOOP),
+  monitorActive(false),
+  alertCount(0),
+  batteryOk(true),
+  belowSince(0),
+  aboveSince(0),
+  lastMillivolts(0),
+  minMillivolts(0xFFFF),
+  tripCount(0),
+  sagsIgnored(0),
+  skippedSamples(0),
+  sagInProgress(false),
+  brownout(false),
+  brownoutCount(0),
+  tripIndex(0),
+  tripPending(false),
+  restorePending(false) {
+  memset(trips, 0, sizeof(trips));
+}
+
+void BatteryGuard::init(SensorManager* sensorManager, RelayController* relayControllers, ConfigManager* config, ConsoleLogger* logger) {
+  this->sensorManager = sensorManager;
+  this->relayControllers = relayControllers;
+  this->config = config;
+  this->logger = logger;
+
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = &BatteryGuard::handleTimer;
+  timerArgs.arg = this;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "batt_guard";
+  timerArgs.skip_unhandled_events = true;
+  if (esp_timer_create(&timerArgs, &sampleTimer) != ESP_OK) sampleTimer = NULL;
+
+#if BATT_USE_MONITOR
+  if (xTaskCreate(&BatteryGuard::alertTaskMain, "batt_guard", BATT_GUARD_TASK_STACK, this,
+                  BATT_GUARD_TASK_PRIORITY, &alertTask) == pdPASS) {
+    if (sensorManager->startBatteryMonitor(alertThresholdMv(), alertTask)) {
+      mode = BATT_MONITOR_ADC;
+      monitorActive = true;
+      return;
+    }
+    vTaskDelete(alertTask);
+    alertTask = NULL;
+  }
+#endif
+  fallBackToTimer();
+}
+
+void BatteryGuard::fallBackToTimer() {
+  monitorActive = false;
+  if (alertTask != NULL) sensorManager->stopBatteryMonitor();
+  if (sampleTimer != NULL && esp_timer_start_periodic(sampleTimer, BATT_GUARD_PERIOD_US) == ESP_OK) {
+    mode = BATT_MONITOR_TIMER;
+    if (alertTask != NULL) logger->addLog("BATTERY", "warning", "Monitor ADC niedostępny - próbkowanie co 2 ms");
+  } else {
+    mode = BATT_MONITOR_LOOP;
+    logger->addLog("BATTERY", "warning", "Brak szybkiego monitora - kontrola napięcia z pętli");
+  }
+}
+
+void BatteryGuard::sample() {
+  int64_t sampleTime = esp_timer_get_time();
+  uint16_t millivolts;
+  if (!sensorManager->readBatteryMillivoltsFast(&millivolts)) {
+    skippedSamples++;
+    return;
+  }
+  update(millivolts, sampleTime);
+}
+
+void BatteryGuard::handleTimer(void* arg) {
+  ((BatteryGuard*)arg)->sample();
+}
+
+// Zadanie monitora ADC. Bez alarmu pojedynczy odczyt co BATT_GUARD_CHECK_MS
+// (napięcie do wyświetlania, próg z bieżącej konfiguracji). Po alarmie monitor
+// jest wyłączany - zdarzenie przychodziłoby z każdą konwersją - i napięcie
+// próbkowane co BATT_GUARD_PERIOD_US do powrotu powyżej progu przyciągnięcia.
+void BatteryGuard::alertTaskMain(void* arg) {
+  BatteryGuard* self = (BatteryGuard*)arg;
+  while (true) {
+    bool alert = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BATT_GUARD_CHECK_MS)) != 0;
+    if (!self->monitorActive) continue;
+    self->sample();
+    if (!alert && self->isSettled()) {
+      self->sensorManager->setBatteryAlert(self->alertThresholdMv(), true);
+      continue;
+    }
+
+    if (alert) self->alertCount++;
+    self->sensorManager->setBatteryAlert(self->alertThresholdMv(), false);
+    while (self->monitorActive && !self->isSettled()) {
+      vTaskDelay(pdMS_TO_TICKS(BATT_GUARD_PERIOD_US / 1000));
+      self->sample();
+    }
+    if (self->monitorActive) self->sensorManager->setBatteryAlert(self->alertThresholdMv(), true);
+  }
+}
+
+void BatteryGuard::update(uint16_t millivolts, int64_t sampleTime) {
+  int64_t now = sampleTime;
+  uint16_t cutMv = config->getProgNapieciaMv();
+  uint16_t restoreMv = cutMv + BATT_RESTORE_HYSTERESIS_MV;
+
+  lastMillivolts = millivolts;
+  if (millivolts < minMillivolts) minMillivolts = millivolts;
+
+  uint16_t repullMv = cutMv + BATT_REPULL_MARGIN_MV;
+  bool low = brownout ? millivolts < repullMv + BATT_REPULL_HYSTERESIS_MV : millivolts < repullMv;
+  if (low != brownout) {
+    brownout = low;
+    if (low) brownoutCount++;
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      relayControllers[z].setBrownout(low);
+    }
+  }
+
+  if (batteryOk) {
+    if (millivolts >= cutMv) {
+      if (sagInProgress) sagsIgnored++;  // ugięcie wróciło przed upływem hold-off
+      sagInProgress = false;
+      belowSince = 0;
+      return;
+    }
+
+    if (belowSince == 0) {
+      belowSince = now;
+      sagInProgress = true;
+    }
+
+    bool collapse = millivolts + BATT_COLLAPSE_MARGIN_MV < cutMv;
+    if (collapse || now - belowSince >= BATT_CUT_HOLDOFF_MS * 1000LL) {
+      batteryOk = false;
+      sagInProgress = false;
+      aboveSince = 0;
+      for (int z = 0; z < ZONE_COUNT; z++) {
+        relayControllers[z].fastShutdown();
+      }
+      recordTrip(millivolts, (uint32_t)((now - belowSince) / 1000),
+                 (uint32_t)(esp_timer_get_time() - sampleTime), collapse);
+    }
+  } else {
+    if (millivolts < restoreMv) {
+      aboveSince = 0;
+      return;
+    }
+    if (aboveSince == 0) aboveSince = now;
+    if (now - aboveSince >= BATT_RESTORE_HOLD_MS * 1000LL) {
+      batteryOk = true;
+      belowSince = 0;
+      restorePending = true;
+    }
+  }
+}
+
+void BatteryGuard::recordTrip(uint16_t millivolts, uint32_t belowMs, uint32_t latencyUs, bool collapse) {
+  BatteryTripEvent& trip = trips[tripIndex];
+  trip.timestamp = millis();
+  trip.millivolts = millivolts;
+  trip.belowMs = belowMs;
+  trip.latencyUs = latencyUs;
+  trip.collapse = collapse;
+  tripIndex = (tripIndex + 1) % BATT_TRIP_HISTORY;
+  tripCount++;
+  tripPending = true;
+}
+
+// Wstrzymanie na czas bezczynności audio (przekaźniki wyłączone) - ADC pracuje
+// wtedy tylko w oknach monitora audio, odczyty oneshot byłyby odrzucane
+void BatteryGuard::suspend() {
+  if (mode == BATT_MONITOR_ADC) {
+    monitorActive = false;
+    sensorManager->stopBatteryMonitor();
+  } else if (mode == BATT_MONITOR_TIMER) {
+    esp_timer_stop(sampleTimer);
+  }
+}
+
+void BatteryGuard::resume() {
+  belowSince = 0;
+  if (mode == BATT_MONITOR_ADC) {
+    if (!sensorManager->startBatteryMonitor(alertThresholdMv(), alertTask)) {
+      fallBackToTimer();
+      return;
+    }
+    monitorActive = true;
+    // Monitor zgłasza tylko przejście poniżej progu - trwający spadek dalej próbkowany
+    if (!isSettled()) xTaskNotifyGive(alertTask);
+  } else if (mode == BATT_MONITOR_TIMER) {
+    esp_timer_start_periodic(sampleTimer, BATT_GUARD_PERIOD_US);
+  }
+}
+
+const char* BatteryGuard::getMonitorName() {
+  switch (mode) {
+    case BATT_MONITOR_ADC: return "adc_monitor";
+    case BATT_MONITOR_TIMER: return "esp_timer";
+    default: return "loop";
+  }
+}
+
+// Logowanie zdarzeń z kontekstu pętli
+void BatteryGuard::handleEvents() {
+  // Strumień ADC nie wystartował ponownie po zmianie progu
+  if (mode == BATT_MONITOR_ADC && monitorActive && !sensorManager->isAdcStreamRunning()) {
+    fallBackToTimer();
+  }
+  if (mode == BATT_MONITOR_LOOP) {
+    int64_t sampleTime = esp_timer_get_time();
+    if (sensorManager->readBattery()) {
+      update(sensorManager->getBatteryMillivolts(), sampleTime);
+    } else {
+      skippedSamples++;
+    }
+  }
+  if (tripPending) {
+    tripPending = false;
+    const BatteryTripEvent& trip = trips[(tripIndex - 1 + BATT_TRIP_HISTORY) % BATT_TRIP_HISTORY];
+    logger->addLog("BATTERY", "error", "Odcięcie: %.2fV po %lu ms poniżej progu, reakcja %lu us%s",
+                   trip.millivolts / 1000.0f, (unsigned long)trip.belowMs, (unsigned long)trip.latencyUs,
+                   trip.collapse ? " (zanik)" : "");
+  }
+  if (restorePending) {
+    restorePending = false;
+    logger->addLog("BATTERY", "success", "Napięcie przywrócone: %.2fV", lastMillivolts / 1000.0f);
+  }
+}
+
+void BatteryGuard::addDiagnostics(JsonObject diag) {
+  diag["ok"] = (bool)batteryOk;
+  diag["fastMonitor"] = isFastMonitorRunning();
+  diag["monitor"] = getMonitorName();
+  diag["alerts"] = alertCount;
+  diag["mv"] = lastMillivolts;
+  diag["minMv"] = minMillivolts;
+  diag["trips"] = tripCount;
+  diag["sagsIgnored"] = sagsIgnored;
+  diag["skippedSamples"] = skippedSamples;
+  diag["brownouts"] = brownoutCount;
+
+  JsonArray history = diag.createNestedArray("history");
+  for (int i = 0; i < BATT_TRIP_HISTORY && i < (int)tripCount; i++) {
+    const BatteryTripEvent& trip = trips[(tripIndex - 1 - i + 2 * BATT_TRIP_HISTORY) % BATT_TRIP_HISTORY];
+    JsonObject event = history.createNestedObject();
+    event["t"] = trip.timestamp;
+    event["mv"] = trip.millivolts;
+    event["belowMs"] = trip.belowMs;
+    event["latencyUs"] = trip.latencyUs;
+    event["collapse"] = trip.collapse;
+  }
+}
+
+void BatteryGuard::printDiagnostics(Stream* out) {
+  out->println();
+  out->println("AKUMULATOR:");
+  out->printf("  napięcie:        %u mV (min %u mV)\n", lastMillivolts, minMillivolts);
+  out->printf("  stan:            %s\n", batteryOk ? "OK" : "ODCIĘTY");
+  if (mode == BATT_MONITOR_ADC) {
+    out->printf("  monitor:         ADC, próg %u mV (alarmów %lu), po alarmie próbki co 2 ms%s\n", alertThresholdMv(),
+                (unsigned long)alertCount, monitorActive ? "" : ", wstrzymany");
+  } else {
+    out->printf("  monitor:         %s\n", mode == BATT_MONITOR_TIMER ? "esp_timer 2 ms" : "pętla");
+  }
+  out->printf("  odcięć:          %lu, zignorowanych ugięć: %lu\n", (unsigned long)tripCount, (unsigned long)sagsIgnored);
+  out->printf("  pominięte próbki: %lu (ADC zajęty lub błąd konwersji)\n", (unsigned long)skippedSamples);
+  out->printf("  przyciągnięć:    %lu (spadek poniżej %u mV)%s\n", (unsigned long)brownoutCount,
+              config->getProgNapieciaMv() + BATT_REPULL_MARGIN_MV, brownout ? ", trwa" : "");
+  for (int i = 0; i < BATT_TRIP_HISTORY && i < (int)tripCount; i++) {
+    const BatteryTripEvent& trip = trips[(tripIndex - 1 - i + 2 * BATT_TRIP_HISTORY) % BATT_TRIP_HISTORY];
+    out->printf("    %lus: %u mV po %lu ms poniżej progu, reakcja %lu us%s\n", trip.timestamp / 1000, trip.millivolts,
+                (unsigned long)trip.belowMs, (unsigned long)trip.latencyUs, trip.collapse ? " (zanik)" : "");
+  }
+}
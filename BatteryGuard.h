@@ -0,0 +1,110 @@
+#ifndef BATTERY_GUARD_H
+#define BATTERY_GUARD_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "ConfigManager.h"
+#include "ConsoleLogger.h"
+#include "RelayController.h"
+#include "SensorManager.h"
+
+#define BATT_GUARD_PERIOD_US 2000          // okres szybkiego próbkowania (monitor: tylko po alarmie)
+#define BATT_GUARD_CHECK_MS 100            // monitor: odczyt do wyświetlania i kontrola progu z konfiguracji
+#define BATT_GUARD_TASK_PRIORITY 20        // powyżej loopTask, poniżej zadania esp_timer (22)
+#define BATT_GUARD_TASK_STACK 3072
+#define BATT_RESTORE_HYSTERESIS_MV 500     // próg powrotu = próg odcięcia + histereza
+#define BATT_CUT_HOLDOFF_MS 250            // spadek musi trwać tyle, by odciąć (ugięcie od basu)
+#define BATT_RESTORE_HOLD_MS 2000          // napięcie musi się utrzymać tyle, by przywrócić
+#define BATT_COLLAPSE_MARGIN_MV 1500       // poniżej progu o tyle - odcięcie natychmiast
+#define BATT_TRIP_HISTORY 4
+#define BATT_REPULL_MARGIN_MV 1000         // poniżej progu odcięcia + margines cewki wracają do pełnego wysterowania
+#define BATT_REPULL_HYSTERESIS_MV 300
+
+enum BatteryMonitorMode {
+  BATT_MONITOR_ADC,      // monitor progu ADC budzi zadanie, próbkowanie tylko poniżej progu
+  BATT_MONITOR_TIMER,    // esp_timer co BATT_GUARD_PERIOD_US
+  BATT_MONITOR_LOOP      // odczyt z pętli
+};
+
+struct BatteryTripEvent {
+  unsigned long timestamp;   // ms
+  uint16_t millivolts;       // napięcie w chwili odcięcia
+  uint32_t belowMs;          // od pierwszej próbki poniżej progu do próbki decydującej
+  uint32_t latencyUs;        // od próbki decydującej do wyłączenia przekaźników
+  bool collapse;             // true = gwałtowny zanik, bez odczekania
+};
+
+// Ochrona przed rozładowaniem akumulatora, niezależnie od loop(). Krótkie
+// ugięcia pod obciążeniem są ignorowane przez czas BATT_CUT_HOLDOFF_MS,
+// gwałtowny zanik odcina przekaźniki od razu. Powrót wymaga napięcia powyżej
+// progu + histereza. Próbka, której nie udało się pobrać (ADC zajęty,
+// nieudana konwersja), jest pomijana.
+//
+// Z monitorem ADC (BATT_USE_MONITOR) kanał akumulatora jest w strumieniu DMA
+// SensorManager, a monitor progu dolnego (próg przyciągnięcia cewek) budzi
+// zadanie "batt_guard". Dopiero wtedy napięcie próbkowane jest co 2 ms, do
+// powrotu powyżej progu; w normalnej pracy zadanie odczytuje je co
+// BATT_GUARD_CHECK_MS. Bez monitora (kilka stref, starsze ESP-IDF, nieudany
+// start strumienia) próbkowanie co 2 ms w callbacku esp_timer, a gdy i timer
+// nie wystartuje - w handleEvents() z pętli.
+//
+// Ten sam pomiar steruje ekonomizerem cewek: spadek poniżej progu odcięcia
+// + BATT_REPULL_MARGIN_MV przełącza przekaźniki w podtrzymaniu PWM na pełne
+// wysterowanie, zanim obniżone napięcie cewki pozwoli im odpaść.
+class BatteryGuard {
+private:
+  SensorManager* sensorManager;
+  RelayController* relayControllers;    // ZONE_COUNT stref
+  ConfigManager* config;
+  ConsoleLogger* logger;
+  esp_timer_handle_t sampleTimer;
+  TaskHandle_t alertTask;
+  BatteryMonitorMode mode;
+  volatile bool monitorActive;   // strumień ADC działa (poza bezczynnością)
+  uint32_t alertCount;
+
+  volatile bool batteryOk;
+  int64_t belowSince;            // us, 0 = napięcie powyżej progu odcięcia
+  int64_t aboveSince;            // us, 0 = napięcie poniżej progu powrotu
+  uint16_t lastMillivolts;
+  uint16_t minMillivolts;
+  uint32_t tripCount;
+  uint32_t sagsIgnored;
+  uint32_t skippedSamples;       // ADC zajęty albo nieudana konwersja
+  bool sagInProgress;
+  bool brownout;                 // przekaźniki w trybie ponownego przyciągnięcia
+  uint32_t brownoutCount;
+
+  BatteryTripEvent trips[BATT_TRIP_HISTORY];
+  int tripIndex;
+  volatile bool tripPending;
+  volatile bool restorePending;
+
+  static void handleTimer(void* arg);
+  static void alertTaskMain(void* arg);
+  void sample();
+  bool isSettled() { return batteryOk && !brownout && belowSince == 0; }
+  uint16_t alertThresholdMv() { return config->getProgNapieciaMv() + BATT_REPULL_MARGIN_MV; }
+  void fallBackToTimer();
+  void update(uint16_t millivolts, int64_t sampleTime);
+  void recordTrip(uint16_t millivolts, uint32_t belowMs, uint32_t latencyUs, bool collapse);
+
+public:
+  BatteryGuard();
+  void init(SensorManager* sensorManager, RelayController* relayControllers, ConfigManager* config, ConsoleLogger* logger);
+  void handleEvents();
+  void suspend();
+  void resume();
+  bool isBatteryOk() { return batteryOk; }
+  bool isFastMonitorRunning() { return mode != BATT_MONITOR_LOOP; }
+  BatteryMonitorMode getMonitorMode() { return mode; }
+  const char* getMonitorName();
+  uint32_t getTripCount() { return tripCount; }
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
+};
+
+#endif
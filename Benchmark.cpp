@@ -0,0 +1,148 @@
+#include "Benchmark.h"
+#include "HeapMonitor.h"
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+
+// Lista benchmarków. Zapis do EEPROM ma mało iteracji, żeby nie zużywać flasha.
+const BenchmarkCase BenchmarkRunner::cases[] = {
+  { "audioFilter", 1000, &BenchmarkRunner::benchAudioFilter },
+  { "addLog", 200, &BenchmarkRunner::benchAddLog },
+  { "getLogsAsJson", 50, &BenchmarkRunner::benchLogsJson },
+  { "fastdataJson", 100, &BenchmarkRunner::benchFastDataJson },
+  { "handleRootPage", 10, &BenchmarkRunner::benchRootPage },
+  { "parseCommands", 50, &BenchmarkRunner::benchParseCommand },
+  { "loadSettings", 50, &BenchmarkRunner::benchLoadSettings },
+  { "saveSettings", 2, &BenchmarkRunner::benchSaveSettings },
+};
+
+BenchmarkRunner::BenchmarkRunner() : resultCount(0), lastRunTime(0) {
+}
+
+void BenchmarkRunner::init(ConsoleLogger* logger, ConfigManager* config, SensorManager* sensorManager, SubwooferWebServer* webServer, UartManager* uartManager) {
+  this->logger = logger;
+  this->config = config;
+  this->sensorManager = sensorManager;
+  this->webServer = webServer;
+  this->uartManager = uartManager;
+}
+
+void BenchmarkRunner::run(const BenchmarkCase& bench, BenchmarkResult& result) {
+  // Rozgrzewka - pierwsze wywołanie alokuje bufory statyczne
+  (this->*bench.fn)();
+
+  uint32_t freeBefore = ESP.getFreeHeap();
+  uint32_t allocsBefore = HeapMonitor::getAllocCount();
+  int64_t start = esp_timer_get_time();
+
+  for (uint32_t i = 0; i < bench.iterations; i++) {
+    (this->*bench.fn)();
+  }
+
+  int64_t elapsed = esp_timer_get_time() - start;
+  uint32_t allocs = HeapMonitor::getAllocCount() - allocsBefore;
+
+  result.name = bench.name;
+  result.iterations = bench.iterations;
+  result.nsPerOp = (uint32_t)((elapsed * 1000) / bench.iterations);
+  // Bez hooków sterty różnica bloków netto nie widzi alokacji zwolnionych w wywołaniu
+  result.allocsPerOp = HeapMonitor::hasAllocHooks() ? (float)allocs / bench.iterations : -1;
+  result.heapDelta = (int32_t)ESP.getFreeHeap() - (int32_t)freeBefore;
+}
+
+void BenchmarkRunner::runAll() {
+  resultCount = 0;
+  int caseCount = sizeof(cases) / sizeof(cases[0]);
+  for (int i = 0; i < caseCount && i < MAX_BENCHMARKS; i++) {
+    run(cases[i], results[resultCount]);
+    resultCount++;
+  }
+  lastRunTime = millis();
+  logger->addLog("BENCH", "info", "Benchmark zakończony");
+}
+
+// Sam filtr toru audio, bez analogRead() i delay(1) z readAudio(). Próbka to
+// bieżąca składowa stała + obwiednia, więc stan strefy prawie się nie zmienia.
+void BenchmarkRunner::benchAudioFilter() {
+  float sample = sensorManager->getAudioBias(0) + sensorManager->getFilteredAudio(0);
+  sensorManager->processAudio(config, 0, sample);
+}
+
+// Formatowanie wpisu bez kopii na Serial
+void BenchmarkRunner::benchAddLog() {
+  logger->setSerialEcho(false);
+  logger->addLog("BENCH", "info", "Wpis testowy benchmarku");
+  logger->setSerialEcho(true);
+}
+
+void BenchmarkRunner::benchLogsJson() {
+  String json = logger->getLogsAsJson();
+}
+
+void BenchmarkRunner::benchFastDataJson() {
+  char json[FASTDATA_JSON_SIZE];
+  webServer->buildFastDataJson(json, sizeof(json));
+}
+
+void BenchmarkRunner::benchRootPage() {
+  String html = webServer->buildRootPage();
+}
+
+// Parsowanie komendy w trybie cichym - bez wypisywania ustawień na UART.
+// Komenda ustawia aktualną wartość, więc konfiguracja się nie zmienia.
+void BenchmarkRunner::benchParseCommand() {
+  String linia = "audio=" + String(config->getAudioThreshold(), 3);
+  uartManager->setQuiet(true);
+  uartManager->executeCommand(linia, config);
+  uartManager->setQuiet(false);
+}
+
+void BenchmarkRunner::benchLoadSettings() {
+  config->loadSettings();
+}
+
+void BenchmarkRunner::benchSaveSettings() {
+  config->saveSettings();
+}
+
+String BenchmarkRunner::getResultsAsJson() {
+  DynamicJsonDocument doc(2048);
+  doc["timestamp"] = lastRunTime;
+  doc["allocMode"] = HeapMonitor::getAllocMode();
+  JsonArray benchArray = doc.createNestedArray("benchmarks");
+
+  for (int i = 0; i < resultCount; i++) {
+    JsonObject bench = benchArray.createNestedObject();
+    bench["name"] = results[i].name;
+    bench["iterations"] = results[i].iterations;
+    bench["ns_per_op"] = results[i].nsPerOp;
+    if (results[i].allocsPerOp >= 0) {
+      bench["allocs_per_op"] = results[i].allocsPerOp;
+    } else {
+      bench["allocs_per_op"] = "n/a";
+    }
+    bench["heap_delta"] = results[i].heapDelta;
+  }
+
+  String result;
+  serializeJson(doc, result);
+  return result;
+}
+
+void BenchmarkRunner::printResults(Stream* out) {
+  out->println();
+  out->println("WYNIKI BENCHMARKU:");
+  for (int i = 0; i < resultCount; i++) {
+    char allocs[12];
+    if (results[i].allocsPerOp >= 0) {
+      snprintf(allocs, sizeof(allocs), "%6.2f", results[i].allocsPerOp);
+    } else {
+      strlcpy(allocs, "   n/a", sizeof(allocs));
+    }
+    out->printf("  %-16s %10lu ns/op  %s alloc/op  (%lu iter.)\n",
+                results[i].name, (unsigned long)results[i].nsPerOp,
+                allocs, (unsigned long)results[i].iterations);
+  }
+  // Linia JSON do skopiowania i porównania między commitami
+  out->print("BENCH_JSON ");
+  out->println(getResultsAsJson());
+}
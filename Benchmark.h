@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <Arduino.h>
+#include "ConfigManager.h"
+#include "ConsoleLogger.h"
+#include "SensorManager.h"
+#include "SubwooferWebServer.h"
+#include "UartManager.h"
+
+#define MAX_BENCHMARKS 10
+
+struct BenchmarkResult {
+  const char* name;
+  uint32_t iterations;
+  uint32_t nsPerOp;
+  float allocsPerOp;       // -1 = brak hooków sterty
+  int32_t heapDelta;       // bajty, zmiana wolnej sterty po serii
+};
+
+class BenchmarkRunner;
+typedef void (BenchmarkRunner::*BenchmarkFn)();
+
+struct BenchmarkCase {
+  const char* name;
+  uint32_t iterations;
+  BenchmarkFn fn;
+};
+
+class BenchmarkRunner {
+private:
+  ConsoleLogger* logger;
+  ConfigManager* config;
+  SensorManager* sensorManager;
+  SubwooferWebServer* webServer;
+  UartManager* uartManager;
+  BenchmarkResult results[MAX_BENCHMARKS];
+  int resultCount;
+  unsigned long lastRunTime;
+
+  static const BenchmarkCase cases[];
+
+  void run(const BenchmarkCase& bench, BenchmarkResult& result);
+
+  // Pojedyncze wywołania mierzonych ścieżek
+  void benchAudioFilter();
+  void benchAddLog();
+  void benchLogsJson();
+  void benchFastDataJson();
+  void benchRootPage();
+  void benchParseCommand();
+  void benchLoadSettings();
+  void benchSaveSettings();
+
+public:
+  BenchmarkRunner();
+  void init(ConsoleLogger* logger, ConfigManager* config, SensorManager* sensorManager, SubwooferWebServer* webServer, UartManager* uartManager);
+  void runAll();
+  String getResultsAsJson();
+  void printResults(Stream* out);
+  int getResultCount() { return resultCount; }
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "ButtonManager.h"
+
+ButtonManager::ButtonManager() :
+  pin(-1),
+  debounceTimer(NULL),
+  longPressTimer(NULL),
+  eventQueue(NULL),
+  wakeTask(NULL),
+  sleepWakeArmed(false),
+  lastEdgeTime(0),
+  pressStartTime(0),
+  pressed(false),
+  longPressFired(false),
+  lastLatencyUs(0),
+  maxLatencyUs(0),
+  droppedEvents(0) {
+}
+
+void ButtonManager::init(int pin) {
+  this->pin = pin;
+  pinMode(pin, INPUT_PULLUP);
+
+  eventQueue = xQueueCreate(BUTTON_QUEUE_LEN, sizeof(ButtonEvent));
+
+  esp_timer_create_args_t debounceArgs = {};
+  debounceArgs.callback = &ButtonManager::handleDebounce;
+  debounceArgs.arg = this;
+  debounceArgs.dispatch_method = ESP_TIMER_TASK;
+  debounceArgs.name = "btn_debounce";
+  esp_timer_create(&debounceArgs, &debounceTimer);
+
+  esp_timer_create_args_t longPressArgs = {};
+  longPressArgs.callback = &ButtonManager::handleLongPress;
+  longPressArgs.arg = this;
+  longPressArgs.dispatch_method = ESP_TIMER_TASK;
+  longPressArgs.name = "btn_long";
+  esp_timer_create(&longPressArgs, &longPressTimer);
+
+  attachInterruptArg(digitalPinToInterrupt(pin), &ButtonManager::handleInterrupt, this, CHANGE);
+}
+
+void IRAM_ATTR ButtonManager::handleInterrupt(void* arg) {
+  ButtonManager* self = (ButtonManager*)arg;
+  self->lastEdgeTime = esp_timer_get_time();
+
+  // Wybudzenie z light sleep wymaga przerwania poziomem - po pierwszym
+  // wywołaniu wracamy do zboczy, inaczej przerwanie powtarzałoby się
+  // przez cały czas trzymania przycisku
+  if (self->sleepWakeArmed) {
+    self->sleepWakeArmed = false;
+    gpio_wakeup_disable((gpio_num_t)self->pin);
+    gpio_set_intr_type((gpio_num_t)self->pin, GPIO_INTR_ANYEDGE);
+  }
+
+  // Każde zbocze przesuwa okno antydrgań
+  esp_timer_stop(self->debounceTimer);
+  esp_timer_start_once(self->debounceTimer, BUTTON_DEBOUNCE_MS * 1000ULL);
+}
+
+void ButtonManager::setSleepWake(bool enabled) {
+  if (enabled == sleepWakeArmed) return;
+  if (enabled) {
+    sleepWakeArmed = true;
+    gpio_wakeup_enable((gpio_num_t)pin, GPIO_INTR_LOW_LEVEL);
+  } else {
+    sleepWakeArmed = false;
+    gpio_wakeup_disable((gpio_num_t)pin);
+    gpio_set_intr_type((gpio_num_t)pin, GPIO_INTR_ANYEDGE);
+  }
+}
+
+void ButtonManager::handleDebounce(void* arg) {
+  ButtonManager* self = (ButtonManager*)arg;
+  bool nowPressed = (digitalRead(self->pin) == LOW);
+  int64_t edgeTime = self->lastEdgeTime;
+
+  if (nowPressed && !self->pressed) {
+    // Stabilne wciśnięcie - start odliczania długiego przytrzymania
+    self->pressed = true;
+    self->longPressFired = false;
+    self->pressStartTime = edgeTime;
+    esp_timer_stop(self->longPressTimer);
+    esp_timer_start_once(self->longPressTimer, BUTTON_LONG_PRESS_MS * 1000ULL);
+  } else if (!nowPressed && self->pressed) {
+    // Stabilne zwolnienie
+    self->pressed = false;
+    esp_timer_stop(self->longPressTimer);
+    if (!self->longPressFired && edgeTime - self->pressStartTime < BUTTON_SHORT_PRESS_MAX_MS * 1000LL) {
+      self->postEvent(BUTTON_SHORT_PRESS, edgeTime);
+    }
+  }
+}
+
+void ButtonManager::handleLongPress(void* arg) {
+  ButtonManager* self = (ButtonManager*)arg;
+  if (self->pressed) {
+    self->longPressFired = true;
+    self->postEvent(BUTTON_LONG_PRESS, self->pressStartTime);
+  }
+}
+
+void ButtonManager::postEvent(ButtonEventType type, int64_t edgeTime) {
+  ButtonEvent event;
+  event.type = type;
+  event.edgeTime = edgeTime;
+  event.postTime = esp_timer_get_time();
+  if (xQueueSend(eventQueue, &event, 0) != pdTRUE) {
+    droppedEvents++;
+  }
+
+  // Wybudzenie pętli uśpionej w trybie bezczynności
+  if (wakeTask != NULL) xTaskNotifyGive(wakeTask);
+}
+
+bool ButtonManager::getEvent(ButtonEvent& event) {
+  if (eventQueue == NULL || xQueueReceive(eventQueue, &event, 0) != pdTRUE) {
+    return false;
+  }
+
+  // Opóźnienie od wysłania zdarzenia do jego obsługi w loop()
+  lastLatencyUs = (uint32_t)(esp_timer_get_time() - event.postTime);
+  if (lastLatencyUs > maxLatencyUs) maxLatencyUs = lastLatencyUs;
+  return true;
+}
@@ -0,0 +1,62 @@
+#ifndef BUTTON_MANAGER_H
+#define BUTTON_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#define BUTTON_DEBOUNCE_MS 30
+#define BUTTON_SHORT_PRESS_MAX_MS 1000
+#define BUTTON_LONG_PRESS_MS 4000
+#define BUTTON_QUEUE_LEN 4
+
+enum ButtonEventType {
+  BUTTON_SHORT_PRESS,
+  BUTTON_LONG_PRESS
+};
+
+struct ButtonEvent {
+  ButtonEventType type;
+  int64_t edgeTime;    // us, zbocze które rozpoczęło zdarzenie
+  int64_t postTime;    // us, moment wysłania zdarzenia do pętli
+};
+
+// Przycisk obsługiwany przerwaniem GPIO i timerami esp_timer.
+// Przerwanie uruchamia timer antydrgań, a stan naciśnięcia (krótkie/długie)
+// wyznaczany jest w callbackach timerów niezależnie od obciążenia loop().
+class ButtonManager {
+private:
+  int pin;
+  esp_timer_handle_t debounceTimer;
+  esp_timer_handle_t longPressTimer;
+  QueueHandle_t eventQueue;
+  TaskHandle_t wakeTask;
+  volatile bool sleepWakeArmed;
+  volatile int64_t lastEdgeTime;
+  int64_t pressStartTime;
+  bool pressed;
+  bool longPressFired;
+  uint32_t lastLatencyUs;
+  uint32_t maxLatencyUs;
+  uint32_t droppedEvents;
+
+  static void IRAM_ATTR handleInterrupt(void* arg);
+  static void handleDebounce(void* arg);
+  static void handleLongPress(void* arg);
+  void postEvent(ButtonEventType type, int64_t edgeTime);
+
+public:
+  ButtonManager();
+  void init(int pin);
+  void setWakeTask(TaskHandle_t wakeTask) { this->wakeTask = wakeTask; }
+  void setSleepWake(bool enabled);
+  bool getEvent(ButtonEvent& event);
+  uint32_t getLastLatencyUs() { return lastLatencyUs; }
+  uint32_t getMaxLatencyUs() { return maxLatencyUs; }
+  uint32_t getDroppedEvents() { return droppedEvents; }
+};
+
+#endif
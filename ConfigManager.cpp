@@ -1,14 +1,69 @@
 #include "ConfigManager.h"
+#include "HeapMonitor.h"
 
 ConfigManager::ConfigManager() : 
   czasPoSyg(30),
   progNapiecia(11.5),
-  audioThreshold(1.000),
-  tempMin(35.0),
-  tempPrzegrzania(60.0),
-  tempMax(50.0),
-  delayRelaySwitch(4000),
-  tempSave(45.0) {
+  progNapieciaMv(11500),
+  audioMode(AUDIO_MODE_ABSOLUTE),
+  audioFloorDb(12.0),
+  audioHystDb(6.0),
+  audioConfirmMs(150),
+  audioLockoutMs(5000),
+  preArmMs(2000),
+  holdMode(HOLD_MODE_FIXED),
+  holdPercentile(90),
+  holdMinS(15),
+  holdMaxS(180),
+  tempOvershoot(0) {
+  memset(&tempSensors, 0, sizeof(tempSensors));
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    zones[z].audioThreshold = 1.000;
+    zones[z].tempMin = 35.0;
+    zones[z].tempPrzegrzania = 60.0;
+    zones[z].tempMax = 50.0;
+    zones[z].delayRelaySwitch = 4000;
+    zones[z].tempSave = 45.0;
+  }
+  setFanDefaults();
+  setRelayHoldDefaults();
+}
+
+// Domyślna krzywa odpowiada dawnemu liniowemu 0..100% w tempMin..tempMax
+void ConfigManager::setFanDefaults() {
+  static const uint8_t temps[FAN_CURVE_POINTS] = { 0, 33, 67, 100 };
+  static const uint8_t duties[FAN_CURVE_POINTS] = { 0, 33, 67, 100 };
+  memcpy(fan.curveTemp, temps, sizeof(temps));
+  memcpy(fan.curveDuty, duties, sizeof(duties));
+  fan.maxRpm = 0;
+  fan.slewPctPerS = 20;
+  fan.tachPulses = 2;
+}
+
+// Ekonomizer domyślnie wyłączony - dopuszczalne wypełnienie zależy od
+// przekaźnika i modułu (transoptor na wejściu nie przeniesie 25 kHz)
+void ConfigManager::setRelayHoldDefaults() {
+  for (int i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    relayHold.pullInMs[i] = 100;
+    relayHold.holdPct[i] = 100;
+  }
+}
+
+// Parametry spoza bloku bazowego 0..31 (strefy 1..N mają własną walidację)
+void ConfigManager::setExtendedDefaults() {
+  audioMode = AUDIO_MODE_ABSOLUTE;
+  audioFloorDb = 12.0;
+  audioHystDb = 6.0;
+  audioConfirmMs = 150;
+  audioLockoutMs = 5000;
+  preArmMs = 2000;
+  holdMode = HOLD_MODE_FIXED;
+  holdPercentile = 90;
+  holdMinS = 15;
+  holdMaxS = 180;
+  setFanDefaults();
+  setRelayHoldDefaults();
+  tempOvershoot = 0;
 }
 
 void ConfigManager::init(EEPROMClass* eeprom, ConsoleLogger* logger) {
@@ -17,37 +72,174 @@ void ConfigManager::init(EEPROMClass* eeprom, ConsoleLogger* logger) {
 }
 
 void ConfigManager::loadSettings() {
+  HeapScope heapScope(HEAP_SYS_CONFIG);
   EEPROM.get(EEPROM_ADR_CZAS, czasPoSyg);
   EEPROM.get(EEPROM_ADR_NAPIECIE, progNapiecia);
-  EEPROM.get(EEPROM_ADR_AUDIO, audioThreshold);
-  EEPROM.get(EEPROM_ADR_TMIN, tempMin);
-  EEPROM.get(EEPROM_ADR_TPRZEGRZ, tempPrzegrzania);
-  EEPROM.get(EEPROM_ADR_TMAX, tempMax);
-  EEPROM.get(EEPROM_ADR_DELAY_RELAY, delayRelaySwitch);
-  EEPROM.get(EEPROM_ADR_SAVETEMP, tempSave);
+  EEPROM.get(EEPROM_ADR_AUDIO, zones[0].audioThreshold);
+  EEPROM.get(EEPROM_ADR_TMIN, zones[0].tempMin);
+  EEPROM.get(EEPROM_ADR_TPRZEGRZ, zones[0].tempPrzegrzania);
+  EEPROM.get(EEPROM_ADR_TMAX, zones[0].tempMax);
+  EEPROM.get(EEPROM_ADR_DELAY_RELAY, zones[0].delayRelaySwitch);
+  EEPROM.get(EEPROM_ADR_SAVETEMP, zones[0].tempSave);
+  EEPROM.get(EEPROM_ADR_AUDIO_MODE, audioMode);
+  EEPROM.get(EEPROM_ADR_AUDIO_FLOOR_DB, audioFloorDb);
+  EEPROM.get(EEPROM_ADR_AUDIO_HYST_DB, audioHystDb);
+  EEPROM.get(EEPROM_ADR_AUDIO_CONFIRM, audioConfirmMs);
+  EEPROM.get(EEPROM_ADR_AUDIO_LOCKOUT, audioLockoutMs);
+  EEPROM.get(EEPROM_ADR_PREARM, preArmMs);
+  EEPROM.get(EEPROM_ADR_HOLD_MODE, holdMode);
+  EEPROM.get(EEPROM_ADR_HOLD_PERCENTILE, holdPercentile);
+  EEPROM.get(EEPROM_ADR_HOLD_MIN, holdMinS);
+  EEPROM.get(EEPROM_ADR_HOLD_MAX, holdMaxS);
 
   // Walidacja wartości
   if (czasPoSyg == 0xFFFFFFFF || czasPoSyg < 5 || czasPoSyg > 600) czasPoSyg = 30;
-  if (progNapiecia < 11.0 || progNapiecia > 15.0) progNapiecia = 11.5;
-  if (audioThreshold < 0.1 || audioThreshold > 3.0) audioThreshold = 1.0;
-  if (isnan(tempMin) || tempMin < 30.0 || tempMin > 70.0) tempMin = 35.0;
-  if (isnan(tempPrzegrzania) || tempPrzegrzania < 40.0 || tempPrzegrzania > 85.0) tempPrzegrzania = 60.0;
-  if (isnan(tempMax) || tempMax < 50.0 || tempMax > 100.0) tempMax = 80.0;
-  if (isnan(tempSave) || tempSave < 30.0 || tempSave > 70.0) tempSave = 45.0;
-  if (delayRelaySwitch < 100 || delayRelaySwitch > 10000) delayRelaySwitch = 4000;
+  if (isnan(progNapiecia) || progNapiecia < 11.0 || progNapiecia > 15.0) progNapiecia = 11.5;
+  setProgNapiecia(progNapiecia);
+  ZoneSettings& zone0 = zones[0];
+  if (zone0.audioThreshold < 0.1 || zone0.audioThreshold > 3.0) zone0.audioThreshold = 1.0;
+  if (isnan(zone0.tempMin) || zone0.tempMin < 30.0 || zone0.tempMin > 70.0) zone0.tempMin = 35.0;
+  if (isnan(zone0.tempPrzegrzania) || zone0.tempPrzegrzania < 40.0 || zone0.tempPrzegrzania > 85.0) zone0.tempPrzegrzania = 60.0;
+  if (isnan(zone0.tempMax) || zone0.tempMax < 50.0 || zone0.tempMax > 100.0) zone0.tempMax = 80.0;
+  if (isnan(zone0.tempSave) || zone0.tempSave < 30.0 || zone0.tempSave > 70.0) zone0.tempSave = 45.0;
+  if (zone0.delayRelaySwitch < 100 || zone0.delayRelaySwitch > 10000) zone0.delayRelaySwitch = 4000;
+
+  // Niezapisana lub uszkodzona strefa przejmuje ustawienia strefy 0
+  for (int z = 1; z < ZONE_COUNT; z++) {
+    EEPROM.get(EEPROM_ADR_ZONES + (z - 1) * sizeof(ZoneSettings), zones[z]);
+    if (!isZoneValid(zones[z])) zones[z] = zones[0];
+  }
+  EEPROM.get(EEPROM_ADR_FAN, fan);
+  if (!isFanValid(fan)) setFanDefaults();
+  EEPROM.get(EEPROM_ADR_RELAY_HOLD, relayHold);
+  if (!isRelayHoldValid(relayHold)) setRelayHoldDefaults();
+  EEPROM.get(EEPROM_ADR_TEMP_OVERSHOOT, tempOvershoot);
+  if (isnan(tempOvershoot) || tempOvershoot < 0.0 || tempOvershoot > TEMP_OVERSHOOT_MAX) tempOvershoot = 0;
+  EEPROM.get(EEPROM_ADR_TEMP_SENSORS, tempSensors);
+  for (int r = 0; r < TEMP_ROLE_COUNT; r++) {
+    if (!isTempSensorAssigned(r)) memset(tempSensors.rom[r], 0, sizeof(tempSensors.rom[r]));
+  }
+  if (audioMode != AUDIO_MODE_ABSOLUTE && audioMode != AUDIO_MODE_FLOOR) audioMode = AUDIO_MODE_ABSOLUTE;
+  if (isnan(audioFloorDb) || audioFloorDb < 3.0 || audioFloorDb > 40.0) audioFloorDb = 12.0;
+  if (isnan(audioHystDb) || audioHystDb < 0.0 || audioHystDb > 20.0) audioHystDb = 6.0;
+  if (audioConfirmMs > 2000) audioConfirmMs = 150;
+  if (audioLockoutMs > 60000) audioLockoutMs = 5000;
+  if (preArmMs > 10000) preArmMs = 2000;
+  if (holdMode != HOLD_MODE_FIXED && holdMode != HOLD_MODE_ADAPTIVE) holdMode = HOLD_MODE_FIXED;
+  if (holdPercentile < 50 || holdPercentile > 99) holdPercentile = 90;
+  if (holdMinS < 5 || holdMinS > 600) holdMinS = 15;
+  if (holdMaxS < holdMinS || holdMaxS > 600) holdMaxS = max(holdMinS, 180UL);
+
+  uint16_t layout;
+  EEPROM.get(EEPROM_ADR_LAYOUT, layout);
+  if (layout != EEPROM_LAYOUT_MAGIC) {
+    setExtendedDefaults();
+    logger->addLog("CONFIG", "warning", "Brak znacznika układu EEPROM - ustawienia od adresu 32 domyślne");
+  }
   
   logger->addLog("CONFIG", "success", "Ustawienia wczytane z EEPROM");
 }
 
+bool ConfigManager::isZoneValid(const ZoneSettings& zone) {
+  return zone.audioThreshold >= 0.1 && zone.audioThreshold <= 3.0 &&
+         zone.tempMin >= 30.0 && zone.tempMin <= 70.0 &&
+         zone.tempPrzegrzania >= 40.0 && zone.tempPrzegrzania <= 85.0 &&
+         zone.tempMax >= 50.0 && zone.tempMax <= 100.0 &&
+         zone.tempSave >= 30.0 && zone.tempSave <= 70.0 &&
+         zone.delayRelaySwitch >= 100 && zone.delayRelaySwitch <= 10000;
+}
+
+bool ConfigManager::isFanValid(const FanSettings& fan) {
+  for (int i = 0; i < FAN_CURVE_POINTS; i++) {
+    if (fan.curveTemp[i] > 100 || fan.curveDuty[i] > 100) return false;
+    if (i > 0 && fan.curveTemp[i] <= fan.curveTemp[i - 1]) return false;
+  }
+  return fan.maxRpm <= 20000 && fan.slewPctPerS >= 1 && fan.slewPctPerS <= 100 &&
+         fan.tachPulses >= 1 && fan.tachPulses <= 4;
+}
+
+bool ConfigManager::isRelayHoldValid(const RelayHoldSettings& hold) {
+  for (int i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    if (hold.pullInMs[i] < 20 || hold.pullInMs[i] > 1000) return false;
+    if (hold.holdPct[i] < 20 || hold.holdPct[i] > 100) return false;
+  }
+  return true;
+}
+
+// Zwraca false przy niepoprawnej krzywej (zakres, kolejność punktów)
+bool ConfigManager::setFanCurve(const uint8_t* temps, const uint8_t* duties) {
+  FanSettings candidate = fan;
+  memcpy(candidate.curveTemp, temps, FAN_CURVE_POINTS);
+  memcpy(candidate.curveDuty, duties, FAN_CURVE_POINTS);
+  if (!isFanValid(candidate)) return false;
+  fan = candidate;
+  return true;
+}
+
+// Kod rodziny 0 albo 0xFF (pusta pamięć) - brak przypisania
+bool ConfigManager::isTempSensorAssigned(int role) {
+  return tempSensors.rom[role][0] != 0x00 && tempSensors.rom[role][0] != 0xFF;
+}
+
+void ConfigManager::setTempSensorRom(int role, const uint8_t* rom) {
+  if (rom == nullptr) {
+    memset(tempSensors.rom[role], 0, sizeof(tempSensors.rom[role]));
+    return;
+  }
+  // Jeden czujnik ma jedną rolę
+  for (int r = 0; r < TEMP_ROLE_COUNT; r++) {
+    if (r != role && memcmp(tempSensors.rom[r], rom, sizeof(tempSensors.rom[r])) == 0) {
+      memset(tempSensors.rom[r], 0, sizeof(tempSensors.rom[r]));
+    }
+  }
+  memcpy(tempSensors.rom[role], rom, sizeof(tempSensors.rom[role]));
+}
+
+const char* ConfigManager::getTempRoleName(int role) {
+  static const char* const zoneNames[ZONE_MAX] = { "strefa0", "strefa1", "strefa2" };
+  if (role >= 0 && role < ZONE_MAX) return zoneNames[role];
+  if (role == TEMP_ROLE_ENCLOSURE) return "obudowa";
+  if (role == TEMP_ROLE_CONVERTER) return "przetwornica";
+  return "-";
+}
+
+// Nazwa roli albo jej numer, -1 = nieznana
+int ConfigManager::parseTempRole(const String& name) {
+  for (int r = 0; r < TEMP_ROLE_COUNT; r++) {
+    if (name.equalsIgnoreCase(getTempRoleName(r))) return r;
+  }
+  if (name.length() == 1 && isDigit(name[0]) && name.toInt() < TEMP_ROLE_COUNT) return name.toInt();
+  return -1;
+}
+
 void ConfigManager::saveSettings() {
+  HeapScope heapScope(HEAP_SYS_CONFIG);
   EEPROM.put(EEPROM_ADR_CZAS, czasPoSyg);
   EEPROM.put(EEPROM_ADR_NAPIECIE, progNapiecia);
-  EEPROM.put(EEPROM_ADR_AUDIO, audioThreshold);
-  EEPROM.put(EEPROM_ADR_TMIN, tempMin);
-  EEPROM.put(EEPROM_ADR_TPRZEGRZ, tempPrzegrzania);
-  EEPROM.put(EEPROM_ADR_TMAX, tempMax);
-  EEPROM.put(EEPROM_ADR_DELAY_RELAY, delayRelaySwitch);
-  EEPROM.put(EEPROM_ADR_SAVETEMP, tempSave);
+  EEPROM.put(EEPROM_ADR_AUDIO, zones[0].audioThreshold);
+  EEPROM.put(EEPROM_ADR_TMIN, zones[0].tempMin);
+  EEPROM.put(EEPROM_ADR_TPRZEGRZ, zones[0].tempPrzegrzania);
+  EEPROM.put(EEPROM_ADR_TMAX, zones[0].tempMax);
+  EEPROM.put(EEPROM_ADR_DELAY_RELAY, zones[0].delayRelaySwitch);
+  EEPROM.put(EEPROM_ADR_SAVETEMP, zones[0].tempSave);
+  EEPROM.put(EEPROM_ADR_AUDIO_MODE, audioMode);
+  EEPROM.put(EEPROM_ADR_AUDIO_FLOOR_DB, audioFloorDb);
+  EEPROM.put(EEPROM_ADR_AUDIO_HYST_DB, audioHystDb);
+  EEPROM.put(EEPROM_ADR_AUDIO_CONFIRM, audioConfirmMs);
+  EEPROM.put(EEPROM_ADR_AUDIO_LOCKOUT, audioLockoutMs);
+  EEPROM.put(EEPROM_ADR_PREARM, preArmMs);
+  EEPROM.put(EEPROM_ADR_HOLD_MODE, holdMode);
+  EEPROM.put(EEPROM_ADR_HOLD_PERCENTILE, holdPercentile);
+  EEPROM.put(EEPROM_ADR_HOLD_MIN, holdMinS);
+  EEPROM.put(EEPROM_ADR_HOLD_MAX, holdMaxS);
+  for (int z = 1; z < ZONE_COUNT; z++) {
+    EEPROM.put(EEPROM_ADR_ZONES + (z - 1) * sizeof(ZoneSettings), zones[z]);
+  }
+  EEPROM.put(EEPROM_ADR_FAN, fan);
+  EEPROM.put(EEPROM_ADR_RELAY_HOLD, relayHold);
+  EEPROM.put(EEPROM_ADR_TEMP_OVERSHOOT, tempOvershoot);
+  EEPROM.put(EEPROM_ADR_TEMP_SENSORS, tempSensors);
+  EEPROM.put(EEPROM_ADR_LAYOUT, (uint16_t)EEPROM_LAYOUT_MAGIC);
   EEPROM.commit();
   
   Serial.println("Ustawienia zapisane do EEPROM.");
@@ -56,13 +248,17 @@ void ConfigManager::saveSettings() {
 
 void ConfigManager::resetToDefaults() {
   czasPoSyg = 60;
-  progNapiecia = 12.0;
-  audioThreshold = 1.000;
-  tempMin = 35.0;
-  tempPrzegrzania = 60.0;
-  tempMax = 50.0;
-  delayRelaySwitch = 4000;
-  tempSave = 45.0;
+  setProgNapiecia(12.0);
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    zones[z].audioThreshold = 1.000;
+    zones[z].tempMin = 35.0;
+    zones[z].tempPrzegrzania = 60.0;
+    zones[z].tempMax = 50.0;
+    zones[z].delayRelaySwitch = 4000;
+    zones[z].tempSave = 45.0;
+  }
+  setExtendedDefaults();
+  // Przypisania czujników zostają - opisują sprzęt, nie nastawy
   
   Serial.println("Ustawiono wartości domyślne.");
   logger->addLog("FACTORY RESET", "warning", "Przywrócono ustawienia fabryczne");
@@ -73,27 +269,81 @@ void ConfigManager::showSettings() {
   Serial.print("  czasPoSyg: ");
   Serial.print(czasPoSyg);
   Serial.println("s.");
+  Serial.print("  holdMode: ");
+  Serial.println(holdMode == HOLD_MODE_ADAPTIVE ? "adaptacyjny" : "stały");
+  Serial.print("  holdPercentile: ");
+  Serial.println(holdPercentile);
+  Serial.print("  holdMin/Max: ");
+  Serial.print(holdMinS);
+  Serial.print("/");
+  Serial.print(holdMaxS);
+  Serial.println("s.");
   Serial.print("  progNapiecia: ");
   Serial.print(progNapiecia);
   Serial.println(" V.");
   Serial.print("  audioThreshold: ");
-  Serial.print(audioThreshold);
+  Serial.print(zones[0].audioThreshold);
   Serial.println(" V.");
+  Serial.print("  audioMode: ");
+  Serial.println(audioMode == AUDIO_MODE_FLOOR ? "szum + dB" : "bezwzględny");
+  Serial.print("  audioFloorDb: ");
+  Serial.print(audioFloorDb);
+  Serial.println(" dB.");
+  Serial.print("  audioHystDb: ");
+  Serial.print(audioHystDb);
+  Serial.println(" dB.");
+  Serial.print("  audioConfirmMs: ");
+  Serial.print(audioConfirmMs);
+  Serial.println("ms.");
+  Serial.print("  audioLockoutMs: ");
+  Serial.print(audioLockoutMs);
+  Serial.println("ms.");
+  Serial.print("  preArmMs: ");
+  Serial.print(preArmMs);
+  Serial.println("ms.");
   Serial.print("  delayRelaySwitch: ");
-  Serial.print(delayRelaySwitch);
+  Serial.print(zones[0].delayRelaySwitch);
   Serial.println("ms.");
   Serial.println();
   Serial.print("  tempMin: ");
-  Serial.print(tempMin);
+  Serial.print(zones[0].tempMin);
   Serial.println(" *C");
   Serial.print("  tempPrzegrzania: ");
-  Serial.print(tempPrzegrzania);
+  Serial.print(zones[0].tempPrzegrzania);
   Serial.println(" *C");
   Serial.print("  tempMax: ");
-  Serial.print(tempMax);
+  Serial.print(zones[0].tempMax);
   Serial.println(" *C");
   Serial.print("  tempSave: ");
-  Serial.print(tempSave);
+  Serial.print(zones[0].tempSave);
   Serial.println(" *C");
+  Serial.print("  tempOvershoot: ");
+  Serial.print(tempOvershoot);
+  Serial.println(tempOvershoot > 0 ? " *C" : " *C (wyłączenie na tempMax)");
+  Serial.print("  fanCurve: ");
+  for (int i = 0; i < FAN_CURVE_POINTS; i++) {
+    Serial.printf("%s%u:%u", i > 0 ? "," : "", fan.curveTemp[i], fan.curveDuty[i]);
+  }
+  Serial.println(" %");
+  Serial.printf("  fanMaxRpm: %u, fanSlew: %u %%/s, tachPulses: %u\n", fan.maxRpm, fan.slewPctPerS, fan.tachPulses);
+  for (int i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    Serial.printf("  relayHold %d: pull-in %u ms, podtrzymanie %u %%%s\n", i, relayHold.pullInMs[i],
+                  relayHold.holdPct[i], relayHold.holdPct[i] >= 100 ? " (wyłączony)" : "");
+  }
+  for (int r = 0; r < TEMP_ROLE_COUNT; r++) {
+    if (r < ZONE_MAX && r >= ZONE_COUNT) continue;
+    Serial.printf("  czujnik %-12s ", getTempRoleName(r));
+    if (isTempSensorAssigned(r)) {
+      for (int i = 0; i < 8; i++) Serial.printf("%02X", tempSensors.rom[r][i]);
+      Serial.println();
+    } else {
+      Serial.println("nieprzypisany");
+    }
+  }
+  for (int z = 1; z < ZONE_COUNT; z++) {
+    Serial.printf("  strefa %d: audio %.3f V, delay %u ms, temp %.1f/%.1f/%.1f/%.1f *C\n", z,
+                  zones[z].audioThreshold, zones[z].delayRelaySwitch, zones[z].tempMin,
+                  zones[z].tempPrzegrzania, zones[z].tempMax, zones[z].tempSave);
+  }
   Serial.println();
 }
@@ -4,6 +4,10 @@
 #include <Arduino.h>
 #include <EEPROM.h>
 #include "ConsoleLogger.h"
+#include "Zones.h"
+#include "RelaySequence.h"
+
+#define EEPROM_SIZE 256
 
 // EEPROM adresy
 #define EEPROM_ADR_CZAS 0
@@ -14,6 +18,89 @@
 #define EEPROM_ADR_TMAX 20
 #define EEPROM_ADR_DELAY_RELAY 24
 #define EEPROM_ADR_SAVETEMP 28
+#define EEPROM_ADR_AUDIO_MODE 32
+#define EEPROM_ADR_AUDIO_FLOOR_DB 36
+#define EEPROM_ADR_AUDIO_HYST_DB 40
+#define EEPROM_ADR_AUDIO_CONFIRM 44
+#define EEPROM_ADR_AUDIO_LOCKOUT 48
+#define EEPROM_ADR_PREARM 52
+#define EEPROM_ADR_HOLD_MODE 56
+#define EEPROM_ADR_HOLD_PERCENTILE 60
+#define EEPROM_ADR_HOLD_MIN 64
+#define EEPROM_ADR_HOLD_MAX 68
+#define EEPROM_ADR_HOLD_HISTOGRAM 72      // HoldHistogramRecord, 34 bajty
+#define EEPROM_ADR_ZONES 108              // ZoneSettings stref 1..ZONE_COUNT-1 (strefa 0 pod adresami powyżej)
+#define EEPROM_ADR_FAN 160                // FanSettings, 12 bajtów
+#define EEPROM_ADR_RELAY_HOLD 172         // RelayHoldSettings, 6 bajtów
+#define EEPROM_ADR_TEMP_OVERSHOOT 180
+#define EEPROM_ADR_TEMP_SENSORS 184       // TempSensorMap, 40 bajtów
+#define EEPROM_ADR_LAYOUT 224             // EEPROM_LAYOUT_MAGIC - zapisany blok od adresu 32
+
+// Firmware bazowe zapisywało tylko adresy 0..31; dalej pusta albo
+// rozszerzona pamięć zawiera zera, a zero jest poprawną wartością części
+// parametrów. Bez znacznika blok od adresu 32 dostaje wartości domyślne.
+#define EEPROM_LAYOUT_MAGIC 0x5357
+
+// Tryb detekcji audio
+#define AUDIO_MODE_ABSOLUTE 0   // próg bezwzględny audioThreshold [V]
+#define AUDIO_MODE_FLOOR 1      // próg = poziom szumu + audioFloorDb
+
+// Tryb czasu podtrzymania
+#define HOLD_MODE_FIXED 0       // stały czasPoSyg
+#define HOLD_MODE_ADAPTIVE 1    // percentyl wyuczonych przerw między utworami
+
+// Parametry jednej strefy. Strefa 0 zapisana jest pod dotychczasowymi
+// adresami, kolejne jako cała struktura od EEPROM_ADR_ZONES.
+struct ZoneSettings {
+  float audioThreshold;             // V
+  float tempMin;                    // C
+  float tempPrzegrzania;            // C
+  float tempMax;                    // C
+  float tempSave;                   // C
+  unsigned int delayRelaySwitch;    // ms
+};
+
+static_assert(EEPROM_ADR_ZONES + (ZONE_MAX - 1) * sizeof(ZoneSettings) <= EEPROM_ADR_FAN,
+              "Bloki stref nachodzą na ustawienia wentylatora");
+
+#define FAN_CURVE_POINTS 4
+
+// Krzywa i regulacja wentylatorów, wspólna dla stref. Punkt krzywej: położenie
+// temperatury w przedziale tempMin..tempMax strefy [%] i zapotrzebowanie [%].
+struct FanSettings {
+  uint8_t curveTemp[FAN_CURVE_POINTS];   // % przedziału, rosnąco
+  uint8_t curveDuty[FAN_CURVE_POINTS];   // % wypełnienia (lub obrotów maksymalnych z tachometrem)
+  uint16_t maxRpm;                       // obroty przy 100%, 0 = bez regulacji obrotów
+  uint8_t slewPctPerS;                   // maksymalna zmiana wypełnienia [%/s]
+  uint8_t tachPulses;                    // impulsy tachometru na obrót
+};
+
+static_assert(EEPROM_ADR_FAN + sizeof(FanSettings) <= EEPROM_ADR_RELAY_HOLD, "Ustawienia wentylatora nachodzą na ekonomizer");
+
+// Ekonomizer cewek przekaźników, osobno dla każdego wyjścia (RelayOutput)
+struct RelayHoldSettings {
+  uint16_t pullInMs[RELAY_OUTPUT_COUNT];   // pełne wysterowanie po załączeniu
+  uint8_t holdPct[RELAY_OUTPUT_COUNT];     // wypełnienie podtrzymania, 100 = bez ekonomizera
+};
+
+static_assert(EEPROM_ADR_RELAY_HOLD + sizeof(RelayHoldSettings) <= EEPROM_ADR_TEMP_OVERSHOOT, "Ekonomizer nachodzi na zapas tempMax");
+static_assert(EEPROM_ADR_TEMP_OVERSHOOT + sizeof(float) <= EEPROM_ADR_TEMP_SENSORS, "Zapas tempMax nachodzi na mapę czujników");
+
+#define TEMP_OVERSHOOT_MAX 5.0          // C, górna granica zapasu ponad tempMax
+
+// Role czujników DS18B20: 0..ZONE_MAX-1 to radiatory stref, dalej punkty pomocnicze
+#define TEMP_ROLE_ENCLOSURE ZONE_MAX
+#define TEMP_ROLE_CONVERTER (ZONE_MAX + 1)
+#define TEMP_ROLE_COUNT (ZONE_MAX + 2)
+
+// Przypisanie czujników do ról po adresie ROM - niezależne od kolejności
+// wyszukiwania i od tego, czy inne czujniki odpowiadają
+struct TempSensorMap {
+  uint8_t rom[TEMP_ROLE_COUNT][8];       // same zera = rola nieprzypisana
+};
+
+static_assert(EEPROM_ADR_TEMP_SENSORS + sizeof(TempSensorMap) <= EEPROM_ADR_LAYOUT, "Mapa czujników nachodzi na znacznik układu");
+static_assert(EEPROM_ADR_LAYOUT + sizeof(uint16_t) <= EEPROM_SIZE, "Znacznik układu nie mieści się w EEPROM_SIZE");
 
 class ConfigManager {
 private:
@@ -23,12 +110,29 @@ private:
   // Parametry konfigurowalne
   unsigned long czasPoSyg;          // sekundy
   float progNapiecia;               // V
-  float audioThreshold;             // V
-  float tempMin;                    // C
-  float tempPrzegrzania;            // C
-  float tempMax;                    // C
-  unsigned int delayRelaySwitch;    // ms
-  float tempSave;                   // C
+  uint16_t progNapieciaMv;          // mV, przeliczane przy zmianie (porównania w ścieżce próbkowania)
+  ZoneSettings zones[ZONE_COUNT];
+  int audioMode;                    // AUDIO_MODE_*
+  float audioFloorDb;               // dB ponad poziom szumu
+  float audioHystDb;                // dB, próg wyłączenia poniżej progu włączenia
+  unsigned int audioConfirmMs;      // ms, minimalny czas sygnału przed startem
+  unsigned int audioLockoutMs;      // ms, blokada detekcji po wyłączeniu
+  unsigned int preArmMs;            // ms, czas pre-arm przetwornicy, 0 = wyłączone
+  int holdMode;                     // HOLD_MODE_*
+  int holdPercentile;               // % przerw pokrytych podtrzymaniem
+  unsigned long holdMinS;           // s, dolna granica czasu adaptacyjnego
+  unsigned long holdMaxS;           // s, górna granica czasu adaptacyjnego
+  FanSettings fan;
+  RelayHoldSettings relayHold;
+  float tempOvershoot;              // C ponad tempMax przy prognozie spadku, 0 = wyłączenie na tempMax
+  TempSensorMap tempSensors;
+
+  bool isZoneValid(const ZoneSettings& zone);
+  bool isFanValid(const FanSettings& fan);
+  void setFanDefaults();
+  bool isRelayHoldValid(const RelayHoldSettings& hold);
+  void setRelayHoldDefaults();
+  void setExtendedDefaults();
 
 public:
   ConfigManager();
@@ -41,22 +145,59 @@ public:
   // Gettery
   unsigned long getCzasPoSyg() { return czasPoSyg; }
   float getProgNapiecia() { return progNapiecia; }
-  float getAudioThreshold() { return audioThreshold; }
-  float getTempMin() { return tempMin; }
-  float getTempPrzegrzania() { return tempPrzegrzania; }
-  float getTempMax() { return tempMax; }
-  unsigned int getDelayRelaySwitch() { return delayRelaySwitch; }
-  float getTempSave() { return tempSave; }
+  uint16_t getProgNapieciaMv() { return progNapieciaMv; }
+  float getAudioThreshold(int zone = 0) { return zones[zone].audioThreshold; }
+  float getTempMin(int zone = 0) { return zones[zone].tempMin; }
+  float getTempPrzegrzania(int zone = 0) { return zones[zone].tempPrzegrzania; }
+  float getTempMax(int zone = 0) { return zones[zone].tempMax; }
+  unsigned int getDelayRelaySwitch(int zone = 0) { return zones[zone].delayRelaySwitch; }
+  float getTempSave(int zone = 0) { return zones[zone].tempSave; }
+  int getAudioMode() { return audioMode; }
+  float getAudioFloorDb() { return audioFloorDb; }
+  float getAudioHystDb() { return audioHystDb; }
+  unsigned int getAudioConfirmMs() { return audioConfirmMs; }
+  unsigned int getAudioLockoutMs() { return audioLockoutMs; }
+  unsigned int getPreArmMs() { return preArmMs; }
+  int getHoldMode() { return holdMode; }
+  int getHoldPercentile() { return holdPercentile; }
+  unsigned long getHoldMinS() { return holdMinS; }
+  unsigned long getHoldMaxS() { return holdMaxS; }
+  const FanSettings& getFanSettings() { return fan; }
+  unsigned int getRelayPullInMs(int output) { return relayHold.pullInMs[output]; }
+  int getRelayHoldPct(int output) { return relayHold.holdPct[output]; }
+  float getTempOvershoot() { return tempOvershoot; }
+  const uint8_t* getTempSensorRom(int role) { return tempSensors.rom[role]; }
+  bool isTempSensorAssigned(int role);
+  static const char* getTempRoleName(int role);
+  static int parseTempRole(const String& name);
   
   // Settery
   void setCzasPoSyg(unsigned long val) { czasPoSyg = val; }
-  void setProgNapiecia(float val) { progNapiecia = val; }
-  void setAudioThreshold(float val) { audioThreshold = val; }
-  void setTempMin(float val) { tempMin = val; }
-  void setTempPrzegrzania(float val) { tempPrzegrzania = val; }
-  void setTempMax(float val) { tempMax = val; }
-  void setDelayRelaySwitch(unsigned int val) { delayRelaySwitch = val; }
-  void setTempSave(float val) { tempSave = val; }
+  void setProgNapiecia(float val) { progNapiecia = val; progNapieciaMv = (uint16_t)lroundf(val * 1000); }
+  void setAudioThreshold(float val, int zone = 0) { zones[zone].audioThreshold = val; }
+  void setTempMin(float val, int zone = 0) { zones[zone].tempMin = val; }
+  void setTempPrzegrzania(float val, int zone = 0) { zones[zone].tempPrzegrzania = val; }
+  void setTempMax(float val, int zone = 0) { zones[zone].tempMax = val; }
+  void setDelayRelaySwitch(unsigned int val, int zone = 0) { zones[zone].delayRelaySwitch = val; }
+  void setTempSave(float val, int zone = 0) { zones[zone].tempSave = val; }
+  void setAudioMode(int val) { audioMode = val; }
+  void setAudioFloorDb(float val) { audioFloorDb = val; }
+  void setAudioHystDb(float val) { audioHystDb = val; }
+  void setAudioConfirmMs(unsigned int val) { audioConfirmMs = val; }
+  void setAudioLockoutMs(unsigned int val) { audioLockoutMs = val; }
+  void setPreArmMs(unsigned int val) { preArmMs = val; }
+  void setHoldMode(int val) { holdMode = val; }
+  void setHoldPercentile(int val) { holdPercentile = val; }
+  void setHoldMinS(unsigned long val) { holdMinS = val; }
+  void setHoldMaxS(unsigned long val) { holdMaxS = val; }
+  bool setFanCurve(const uint8_t* temps, const uint8_t* duties);
+  void setFanMaxRpm(uint16_t val) { fan.maxRpm = val; }
+  void setFanSlew(uint8_t val) { fan.slewPctPerS = val; }
+  void setFanTachPulses(uint8_t val) { fan.tachPulses = val; }
+  void setRelayPullInMs(unsigned int val, int output) { relayHold.pullInMs[output] = val; }
+  void setRelayHoldPct(int val, int output) { relayHold.holdPct[output] = val; }
+  void setTempOvershoot(float val) { tempOvershoot = val; }
+  void setTempSensorRom(int role, const uint8_t* rom);
 };
 
 #endif
@@ -1,28 +1,31 @@
 #include "ConsoleLogger.h"
 #include <ArduinoJson.h>
+#include "HeapMonitor.h"
 
-ConsoleLogger::ConsoleLogger() : logIndex(0), logCount(0) {
+ConsoleLogger::ConsoleLogger() : logIndex(0), logCount(0), serialEcho(true) {
 }
 
 void ConsoleLogger::init() {
-  for (int i = 0; i < MAX_LOGS; i++) {
-    logs[i].timestamp = 0;
-    logs[i].operation = "";
-    logs[i].status = "";
-    logs[i].message = "";
-  }
+  memset(logs, 0, sizeof(logs));
 }
 
-void ConsoleLogger::addLog(String operation, String status, String message) {
-  logs[logIndex].timestamp = millis();
-  logs[logIndex].operation = operation;
-  logs[logIndex].status = status;
-  logs[logIndex].message = message;
+void ConsoleLogger::addLog(const char* operation, const char* status, const char* message, ...) {
+  HeapScope heapScope(HEAP_SYS_LOGGER);
+  ConsoleLog& log = logs[logIndex];
+  log.timestamp = millis();
+  strlcpy(log.operation, operation, sizeof(log.operation));
+  strlcpy(log.status, status, sizeof(log.status));
+
+  va_list args;
+  va_start(args, message);
+  vsnprintf(log.message, sizeof(log.message), message, args);
+  va_end(args);
   
   logIndex = (logIndex + 1) % MAX_LOGS;
   if (logCount < MAX_LOGS) logCount++;
   
   // Also print to Serial if active
+  if (!serialEcho) return;
   Serial.print("[");
   Serial.print(millis() / 1000);
   Serial.print("s] ");
@@ -30,7 +33,7 @@ void ConsoleLogger::addLog(String operation, String status, String message) {
   Serial.print(" (");
   Serial.print(status);
   Serial.print("): ");
-  Serial.println(message);
+  Serial.println(log.message);
 }
 
 String ConsoleLogger::getLogsAsJson() {
@@ -4,12 +4,16 @@
 #include <Arduino.h>
 
 #define MAX_LOGS 20
+#define LOG_OPERATION_LEN 16
+#define LOG_STATUS_LEN 8
+#define LOG_MESSAGE_LEN 96
 
+// Wpis o stałym rozmiarze - logowanie nie alokuje pamięci na stercie
 struct ConsoleLog {
   unsigned long timestamp;
-  String operation;
-  String status;  // "success", "warning", "error", "info"
-  String message;
+  char operation[LOG_OPERATION_LEN];
+  char status[LOG_STATUS_LEN];  // "success", "warning", "error", "info"
+  char message[LOG_MESSAGE_LEN];
 };
 
 class ConsoleLogger {
@@ -17,12 +21,16 @@ private:
   ConsoleLog logs[MAX_LOGS];
   int logIndex;
   int logCount;
+  bool serialEcho;              // kopia wpisów na Serial
 
 public:
   ConsoleLogger();
   void init();
-  void addLog(String operation, String status, String message);
+  // message to format printf - argumenty formatowane do bufora wpisu
+  void addLog(const char* operation, const char* status, const char* message, ...)
+    __attribute__((format(printf, 4, 5)));
   String getLogsAsJson();
+  void setSerialEcho(bool enabled) { serialEcho = enabled; }
   int getLogCount() { return logCount; }
   ConsoleLog* getLogs() { return logs; }
 };
@@ -0,0 +1,229 @@
+#include "FanController.h"
+
+FanController::FanController() :
+  config(nullptr),
+  logger(nullptr),
+  pwmPin(-1),
+  tachPin(-1),
+  zone(0),
+  lutBuilds(0),
+  demand(0),
+  command(0),
+  duty(0),
+  integral(0),
+  lastControl(0),
+  kicking(false),
+#if FAN_TACH_USE_PCNT
+  pcntUnit(NULL),
+#endif
+  tachCount(0),
+  lastTachCount(0),
+  rpm(0),
+  stallSince(0),
+  stalled(false),
+  stallAlarms(0),
+  kicks(0),
+  powerIntegral(0),
+  timeIntegral(0) {
+  memset(lut, 0, sizeof(lut));
+  memset(&lutSettings, 0, sizeof(lutSettings));
+}
+
+void FanController::init(int pwmPin, int tachPin, int zone, ConfigManager* config, ConsoleLogger* logger) {
+  this->pwmPin = pwmPin;
+  this->tachPin = tachPin;
+  this->zone = zone;
+  this->config = config;
+  this->logger = logger;
+
+  ledcAttach(pwmPin, FAN_PWM_FREQ, FAN_PWM_BITS);
+  ledcWrite(pwmPin, 0);
+  buildLut();
+  if (tachPin >= 0) initTach();
+  lastControl = millis();
+}
+
+void FanController::initTach() {
+  pinMode(tachPin, INPUT_PULLUP);  // wyjście tachometru to otwarty kolektor
+
+#if FAN_TACH_USE_PCNT
+  pcnt_unit_config_t unitConfig = {};
+  unitConfig.low_limit = -1;
+  unitConfig.high_limit = 30000;
+  pcnt_chan_config_t channelConfig = {};
+  channelConfig.edge_gpio_num = tachPin;
+  channelConfig.level_gpio_num = -1;
+  pcnt_glitch_filter_config_t filterConfig = {};
+  filterConfig.max_glitch_ns = 1000;
+  pcnt_channel_handle_t channel;
+
+  if (pcnt_new_unit(&unitConfig, &pcntUnit) == ESP_OK) {
+    if (pcnt_new_channel(pcntUnit, &channelConfig, &channel) == ESP_OK) {
+      pcnt_unit_set_glitch_filter(pcntUnit, &filterConfig);
+      pcnt_channel_set_edge_action(channel, PCNT_CHANNEL_EDGE_ACTION_HOLD, PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+      pcnt_unit_enable(pcntUnit);
+      pcnt_unit_clear_count(pcntUnit);
+      pcnt_unit_start(pcntUnit);
+      return;
+    }
+    pcnt_del_unit(pcntUnit);
+  }
+  pcntUnit = NULL;
+  logger->addLog("FAN", "warning", "Strefa %d: brak jednostki PCNT - tachometr na przerwaniu GPIO", zone);
+#endif
+
+  attachInterruptArg(tachPin, &FanController::handleTach, this, FALLING);
+}
+
+void IRAM_ATTR FanController::handleTach(void* arg) {
+  FanController* self = (FanController*)arg;
+  self->tachCount++;
+}
+
+// Narastająca liczba impulsów od startu
+uint32_t FanController::readTach() {
+#if FAN_TACH_USE_PCNT
+  if (pcntUnit != NULL) {
+    int count = 0;
+    pcnt_unit_get_count(pcntUnit, &count);
+    pcnt_unit_clear_count(pcntUnit);
+    tachCount += count;
+  }
+#endif
+  return tachCount;
+}
+
+// Tablica krzywej: interpolacja liniowa między punktami, poza nimi wartość skrajna
+void FanController::buildLut() {
+  lutSettings = config->getFanSettings();
+  const uint8_t* temps = lutSettings.curveTemp;
+  const uint8_t* duties = lutSettings.curveDuty;
+
+  for (int i = 0; i < FAN_LUT_SIZE; i++) {
+    float pct;
+    if (i <= temps[0]) {
+      pct = duties[0];
+    } else if (i >= temps[FAN_CURVE_POINTS - 1]) {
+      pct = duties[FAN_CURVE_POINTS - 1];
+    } else {
+      int k = 0;
+      while (i >= temps[k + 1]) k++;
+      pct = duties[k] + (float)(i - temps[k]) * (duties[k + 1] - duties[k]) / (temps[k + 1] - temps[k]);
+    }
+    lut[i] = (uint8_t)lroundf(pct * 255 / 100);
+  }
+  lutBuilds++;
+}
+
+// Zapotrzebowanie 0..1 dla temperatury strefy
+float FanController::curve(float temp) {
+  if (memcmp(&config->getFanSettings(), &lutSettings, sizeof(FanSettings)) != 0) buildLut();
+
+  float tempMin = config->getTempMin(zone);
+  float tempMax = config->getTempMax(zone);
+  if (tempMax <= tempMin) return temp >= tempMax ? 1.0f : 0.0f;
+  int index = constrain((int)lroundf((temp - tempMin) * 100 / (tempMax - tempMin)), 0, FAN_LUT_SIZE - 1);
+  return lut[index] / 255.0f;
+}
+
+// immediate pomija ograniczenie szybkości zmian (chłodzenie awaryjne)
+void FanController::setDemand(float value, bool immediate) {
+  demand = constrain(value, 0.0f, 1.0f);
+  if (immediate && demand > duty) {
+    command = demand;
+    apply(demand);
+  }
+}
+
+void FanController::apply(float value) {
+  duty = value;
+  ledcWrite(pwmPin, kicking ? (1 << FAN_PWM_BITS) - 1 : (uint32_t)lroundf(duty * ((1 << FAN_PWM_BITS) - 1)));
+}
+
+void FanController::update() {
+  unsigned long now = millis();
+  if (now - lastControl < FAN_CONTROL_MS) return;
+  float dt = (now - lastControl) / 1000.0f;
+  lastControl = now;
+  const FanSettings& settings = config->getFanSettings();
+
+  if (hasTach()) {
+    uint32_t count = readTach();
+    float measured = (count - lastTachCount) * 60.0f / (settings.tachPulses * dt);
+    lastTachCount = count;
+    rpm += FAN_RPM_ALPHA * (measured - rpm);
+  }
+
+  // Regulacja obrotów: wyprzedzenie z zapotrzebowania plus korekta PI
+  bool closedLoop = hasTach() && settings.maxRpm > 0;
+  if (demand <= 0) {
+    command = 0;
+    integral = 0;
+  } else if (closedLoop && !stalled) {
+    float error = (demand * settings.maxRpm - rpm) / settings.maxRpm;
+    integral = constrain(integral + (float)FAN_PI_KI * error * dt, -(float)FAN_PI_TRIM, (float)FAN_PI_TRIM);
+    command = constrain(demand + (float)FAN_PI_KP * error + integral, 0.0f, 1.0f);
+  } else {
+    command = demand;
+  }
+
+  // Zatrzymany wirnik mimo wypełnienia
+  if (hasTach()) {
+    if (duty >= FAN_STALL_MIN_DUTY && rpm < FAN_STALL_RPM) {
+      if (stallSince == 0) {
+        stallSince = now;
+      } else if (!stalled && now - stallSince >= FAN_STALL_MS) {
+        stalled = true;
+        stallAlarms++;
+        logger->addLog("FAN", "error", "Strefa %d: wentylator zatrzymany przy wypełnieniu %.0f%%", zone, duty * 100);
+      }
+    } else {
+      if (stalled) logger->addLog("FAN", "success", "Strefa %d: wentylator ponownie się obraca (%.0f obr/min)", zone, rpm);
+      stalled = false;
+      stallSince = 0;
+    }
+  }
+  if (stalled) command = 1.0f;
+
+  // Ograniczenie szybkości zmian - mniej słyszalne skoki obrotów
+  float step = settings.slewPctPerS / 100.0f * dt;
+  float next = constrain(command, duty - step, duty + step);
+  kicking = duty == 0 && next > 0 && next < FAN_KICK_DUTY;
+  if (kicking) kicks++;
+  apply(next);
+
+  powerIntegral += (double)duty * duty * duty * dt;
+  timeIntegral += dt;
+}
+
+void FanController::addDiagnostics(JsonObject diag) {
+  const FanSettings& settings = config->getFanSettings();
+  diag["zone"] = zone;
+  diag["tach"] = hasTach();
+  diag["closedLoop"] = hasTach() && settings.maxRpm > 0;
+  diag["demand"] = demand;
+  diag["command"] = command;
+  diag["duty"] = duty;
+  diag["rpm"] = rpm;
+  diag["targetRpm"] = demand * settings.maxRpm;
+  diag["integral"] = integral;
+  diag["stalled"] = stalled;
+  diag["stallAlarms"] = stallAlarms;
+  diag["kicks"] = kicks;
+  diag["relPowerPct"] = timeIntegral > 0 ? powerIntegral / timeIntegral * 100 : 0;
+  diag["lutBuilds"] = lutBuilds;
+}
+
+void FanController::printDiagnostics(Stream* out) {
+  const FanSettings& settings = config->getFanSettings();
+  out->println();
+  out->println("WENTYLATOR:");
+  out->printf("  tryb:            %s\n", hasTach() && settings.maxRpm > 0 ? "regulacja obrotów (PI)" : "wypełnienie z krzywej");
+  out->printf("  zapotrzebowanie: %.0f%%, wypełnienie %.0f%% (zadane %.0f%%)\n", demand * 100, duty * 100, command * 100);
+  if (hasTach()) {
+    out->printf("  obroty:          %.0f obr/min (zadane %.0f), korekta %.2f\n", rpm, demand * settings.maxRpm, integral);
+    out->printf("  zatrzymania:     %lu%s\n", (unsigned long)stallAlarms, stalled ? " - ALARM" : "");
+  }
+  out->printf("  pobór wzgl.:     %.1f%% pełnych obrotów, impulsy startowe %lu\n",
+              timeIntegral > 0 ? powerIntegral / timeIntegral * 100 : 0.0, (unsigned long)kicks);
+}
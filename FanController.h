@@ -0,0 +1,93 @@
+#ifndef FAN_CONTROLLER_H
+#define FAN_CONTROLLER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <soc/soc_caps.h>
+#include "ConfigManager.h"
+#include "ConsoleLogger.h"
+
+// ESP32-C3 nie ma licznika PCNT - tachometr liczony przerwaniem GPIO
+#if defined(SOC_PCNT_SUPPORTED) && SOC_PCNT_SUPPORTED
+#define FAN_TACH_USE_PCNT 1
+#include <driver/pulse_cnt.h>
+#else
+#define FAN_TACH_USE_PCNT 0
+#endif
+
+#define FAN_PWM_FREQ 25000          // Hz, poza pasmem słyszalnym
+#define FAN_PWM_BITS 8
+#define FAN_LUT_SIZE 101            // 0..100% przedziału tempMin..tempMax
+#define FAN_CONTROL_MS 500          // okres regulacji i pomiaru obrotów
+#define FAN_RPM_ALPHA 0.5           // filtr obrotów
+#define FAN_PI_KP 0.3               // na 100% błędu obrotów
+#define FAN_PI_KI 0.2               // 1/s
+#define FAN_PI_TRIM 0.5             // granica korekty całkującej
+#define FAN_KICK_DUTY 0.5           // start z mniejszym wypełnieniem poprzedza impuls 100% na jeden okres
+#define FAN_STALL_MIN_DUTY 0.3      // poniżej niskie obroty nie są alarmem
+#define FAN_STALL_RPM 100
+#define FAN_STALL_MS 3000
+
+// Wentylator strefy: zapotrzebowanie z krzywej (tablica przeliczana przy
+// zmianie konfiguracji), ograniczenie szybkości zmian wypełnienia i
+// opcjonalny tachometr. Z tachometrem i fanMaxRpm > 0 zapotrzebowanie jest
+// zadanymi obrotami, a wypełnienie koryguje regulator PI; bez niego
+// zapotrzebowanie jest wprost wypełnieniem. Zatrzymany wirnik przy
+// wypełnieniu >= FAN_STALL_MIN_DUTY zgłasza alarm i wymusza pełne wypełnienie.
+class FanController {
+private:
+  ConfigManager* config;
+  ConsoleLogger* logger;
+  int pwmPin;
+  int tachPin;
+  int zone;
+
+  uint8_t lut[FAN_LUT_SIZE];
+  FanSettings lutSettings;       // ustawienia, z których zbudowano tablicę
+  uint32_t lutBuilds;
+
+  float demand;                  // 0..1 z krzywej i modelu cieplnego
+  float command;                 // wypełnienie po regulatorze, przed ograniczeniem zmian
+  float duty;                    // wypełnienie wystawione na pin
+  float integral;
+  unsigned long lastControl;
+  bool kicking;
+
+#if FAN_TACH_USE_PCNT
+  pcnt_unit_handle_t pcntUnit;
+#endif
+  volatile uint32_t tachCount;
+  uint32_t lastTachCount;
+  float rpm;
+
+  unsigned long stallSince;      // ms, 0 = wirnik obraca się
+  bool stalled;
+  uint32_t stallAlarms;
+  uint32_t kicks;
+  double powerIntegral;          // całka duty^3 - pobór wentylatora rośnie z sześcianem obrotów
+  double timeIntegral;
+
+  void buildLut();
+  void initTach();
+  uint32_t readTach();
+  void apply(float value);
+
+  static void IRAM_ATTR handleTach(void* arg);
+
+public:
+  FanController();
+  void init(int pwmPin, int tachPin, int zone, ConfigManager* config, ConsoleLogger* logger);
+  float curve(float temp);
+  void setDemand(float value, bool immediate = false);
+  void update();
+
+  float getDemand() { return demand; }
+  float getDuty() { return duty; }
+  float getRpm() { return rpm; }
+  bool hasTach() { return tachPin >= 0; }
+  bool isStalled() { return stalled; }
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
+};
+
+#endif
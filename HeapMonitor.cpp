@@ -0,0 +1,250 @@
+#include "HeapMonitor.h"
+#ifndef HEAP_HOST_BUILD
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+// Liczniki aktualizowane przez hooki sterty ESP-IDF (CONFIG_HEAP_USE_HOOKS
+// w sdkconfig) albo przez opakowanie malloc/calloc/realloc na etapie
+// linkowania (HEAP_WRAP_MALLOC + -Wl,--wrap=..., bez przebudowy ESP-IDF).
+// Bez żadnego z nich alokacje nie są liczone. Różnica zajętych bloków nie
+// widzi alokacji zwolnionych w tej samej iteracji i zmienia się przez inne zadania.
+static volatile uint32_t allocCounts[HEAP_SYS_COUNT] = { 0 };
+static volatile HeapSubsystem currentSubsystem = HEAP_SYS_CORE;
+
+#ifdef HEAP_HOST_BUILD
+// Kompilacja testów na PC (test/): jeden wątek, po init() wszystkie
+// alokacje należą do pętli
+static bool loopTaskSet = false;
+
+static bool inLoopTask() {
+  return loopTaskSet;
+}
+#else
+static TaskHandle_t loopTask = NULL;
+
+static bool inLoopTask() {
+  return loopTask != NULL && xTaskGetCurrentTaskHandle() == loopTask;
+}
+#endif
+
+static const char* const subsystemNames[HEAP_SYS_COUNT] = {
+  "core", "sensors", "relays", "logger", "web", "uart", "config", "other"
+};
+
+static void countAlloc() {
+  if (inLoopTask()) {
+    allocCounts[currentSubsystem]++;
+  } else {
+    allocCounts[HEAP_SYS_OTHER]++;
+  }
+}
+
+#if defined(CONFIG_HEAP_USE_HOOKS)
+extern "C" void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+  countAlloc();
+}
+
+extern "C" void esp_heap_trace_free_hook(void* ptr) {
+}
+#elif defined(HEAP_WRAP_MALLOC)
+// Wymaga -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc przy linkowaniu
+// (README, sekcja Benchmark). realloc liczony jak alokacja - String rośnie
+// przez realloc.
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  countAlloc();
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  countAlloc();
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  countAlloc();
+  return __real_realloc(ptr, size);
+}
+}
+#elif defined(HEAP_LOOP_CHECK)
+#error "HEAP_LOOP_CHECK wymaga CONFIG_HEAP_USE_HOOKS albo HEAP_WRAP_MALLOC"
+#endif
+
+HeapMonitor::HeapMonitor() :
+  loopCount(0),
+  loopAllocStart(0),
+  lastLoopAllocs(0),
+  maxLoopAllocs(0),
+  allocatingLoops(0),
+  checkFailed(false) {
+}
+
+void HeapMonitor::init() {
+#ifdef HEAP_HOST_BUILD
+  loopTaskSet = true;
+#else
+  loopTask = xTaskGetCurrentTaskHandle();
+#endif
+}
+
+bool HeapMonitor::hasAllocHooks() {
+#if defined(CONFIG_HEAP_USE_HOOKS) || defined(HEAP_WRAP_MALLOC)
+  return true;
+#else
+  return false;
+#endif
+}
+
+const char* HeapMonitor::getAllocMode() {
+#if defined(CONFIG_HEAP_USE_HOOKS)
+  return "hooks";
+#elif defined(HEAP_WRAP_MALLOC)
+  return "wrap";
+#else
+  return "unsupported";
+#endif
+}
+
+uint32_t HeapMonitor::getAllocCount() {
+  uint32_t total = 0;
+  for (int i = 0; i < HEAP_SYS_COUNT; i++) total += allocCounts[i];
+  return total;
+}
+
+uint32_t HeapMonitor::getAllocCount(HeapSubsystem subsystem) {
+  return allocCounts[subsystem];
+}
+
+HeapSubsystem HeapMonitor::enterSubsystem(HeapSubsystem subsystem) {
+  HeapSubsystem previous = currentSubsystem;
+  currentSubsystem = subsystem;
+  return previous;
+}
+
+void HeapMonitor::leaveSubsystem(HeapSubsystem previous) {
+  currentSubsystem = previous;
+}
+
+const char* HeapMonitor::getSubsystemName(HeapSubsystem subsystem) {
+  return subsystemNames[subsystem];
+}
+
+// Alokacje w stanie ustalonym - bez obsługi żądań HTTP/UART i innych zadań
+uint32_t HeapMonitor::steadyStateAllocs() {
+  return allocCounts[HEAP_SYS_CORE] + allocCounts[HEAP_SYS_SENSORS] +
+         allocCounts[HEAP_SYS_RELAYS] + allocCounts[HEAP_SYS_LOGGER] +
+         allocCounts[HEAP_SYS_CONFIG];
+}
+
+void HeapMonitor::beginLoop() {
+  if (!hasAllocHooks()) return;
+  loopAllocStart = steadyStateAllocs();
+}
+
+void HeapMonitor::endLoop() {
+  if (!hasAllocHooks()) return;
+  uint32_t allocs = steadyStateAllocs() - loopAllocStart;
+
+  lastLoopAllocs = allocs;
+  loopCount++;
+  if (loopCount <= HEAP_LOOP_WARMUP) return;
+
+  if (allocs > maxLoopAllocs) maxLoopAllocs = allocs;
+  if (allocs > 0) {
+    allocatingLoops++;
+#ifdef HEAP_LOOP_CHECK
+    // Tryb testowy: pierwsza alokująca iteracja oznacza niezaliczony test
+    if (!checkFailed) {
+      Serial.print("HEAP_LOOP_CHECK FAIL: alokacje w iteracji ");
+      Serial.print(loopCount);
+      Serial.print(": ");
+      Serial.println(allocs);
+    }
+#endif
+    checkFailed = true;
+  }
+}
+
+const char* HeapMonitor::getLoopCheckStatus() {
+  if (!hasAllocHooks()) return "UNSUPPORTED";
+  if (loopCount <= HEAP_LOOP_WARMUP) return "WARMUP";
+  return checkFailed ? "FAIL" : "PASS";
+}
+
+#ifdef HEAP_HOST_BUILD
+// Na PC nie ma sterty o stałym rozmiarze - liczone są tylko alokacje
+uint32_t HeapMonitor::getFreeHeap() {
+  return 0;
+}
+
+uint32_t HeapMonitor::getLargestFreeBlock() {
+  return 0;
+}
+
+uint32_t HeapMonitor::getMinFreeHeap() {
+  return 0;
+}
+#else
+uint32_t HeapMonitor::getFreeHeap() {
+  return ESP.getFreeHeap();
+}
+
+uint32_t HeapMonitor::getLargestFreeBlock() {
+  return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+uint32_t HeapMonitor::getMinFreeHeap() {
+  return ESP.getMinFreeHeap();
+}
+#endif
+
+uint8_t HeapMonitor::getFragmentation() {
+  uint32_t freeHeap = getFreeHeap();
+  if (freeHeap == 0) return 0;
+  return 100 - (uint8_t)((uint64_t)getLargestFreeBlock() * 100 / freeHeap);
+}
+
+void HeapMonitor::addDiagnostics(JsonObject doc) {
+  doc["freeHeap"] = getFreeHeap();
+  doc["largestFreeBlock"] = getLargestFreeBlock();
+  doc["minFreeHeap"] = getMinFreeHeap();
+  doc["fragmentation"] = getFragmentation();
+  doc["allocMode"] = getAllocMode();
+  doc["loopCheck"] = getLoopCheckStatus();
+  if (!hasAllocHooks()) return;
+
+  doc["loopAllocs"] = lastLoopAllocs;
+  doc["maxLoopAllocs"] = maxLoopAllocs;
+  doc["allocatingLoops"] = allocatingLoops;
+
+  JsonObject allocs = doc.createNestedObject("allocs");
+  for (int i = 0; i < HEAP_SYS_COUNT; i++) {
+    allocs[subsystemNames[i]] = allocCounts[i];
+  }
+}
+
+void HeapMonitor::printDiagnostics(Stream* out) {
+  out->println();
+  out->println("STERTA:");
+  out->printf("  wolna:              %lu B\n", (unsigned long)getFreeHeap());
+  out->printf("  największy blok:    %lu B\n", (unsigned long)getLargestFreeBlock());
+  out->printf("  minimum od startu:  %lu B\n", (unsigned long)getMinFreeHeap());
+  out->printf("  fragmentacja:       %u %%\n", getFragmentation());
+  if (!hasAllocHooks()) {
+    out->println("  (liczenie alokacji wymaga CONFIG_HEAP_USE_HOOKS albo HEAP_WRAP_MALLOC)");
+    return;
+  }
+  out->printf("  alokacje/iterację:  %lu (max %lu, iteracji z alokacją: %lu) - %s\n",
+              (unsigned long)lastLoopAllocs, (unsigned long)maxLoopAllocs,
+              allocatingLoops, getLoopCheckStatus());
+  out->println("  alokacje wg podsystemu:");
+  for (int i = 0; i < HEAP_SYS_COUNT; i++) {
+    out->printf("    %-10s %lu\n", subsystemNames[i], (unsigned long)allocCounts[i]);
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Podsystemy, którym przypisywane są alokacje sterty
+enum HeapSubsystem {
+  HEAP_SYS_CORE,      // logika sterowania w loop()
+  HEAP_SYS_SENSORS,
+  HEAP_SYS_RELAYS,
+  HEAP_SYS_LOGGER,
+  HEAP_SYS_WEB,
+  HEAP_SYS_UART,
+  HEAP_SYS_CONFIG,
+  HEAP_SYS_OTHER,     // inne zadania (WiFi, lwIP, timery)
+  HEAP_SYS_COUNT
+};
+
+// Liczba iteracji loop() po setup() traktowanych jako rozgrzewka
+#define HEAP_LOOP_WARMUP 500
+
+class HeapMonitor {
+private:
+  unsigned long loopCount;
+  uint32_t loopAllocStart;
+  uint32_t lastLoopAllocs;
+  uint32_t maxLoopAllocs;          // high-water alokacji w jednej iteracji
+  unsigned long allocatingLoops;   // iteracje w stanie ustalonym z alokacją
+  bool checkFailed;
+
+  static uint32_t steadyStateAllocs();
+
+public:
+  HeapMonitor();
+  void init();
+
+  // Pomiar alokacji w pojedynczej iteracji loop()
+  void beginLoop();
+  void endLoop();
+
+  static uint32_t getAllocCount();
+  static uint32_t getAllocCount(HeapSubsystem subsystem);
+  static HeapSubsystem enterSubsystem(HeapSubsystem subsystem);
+  static void leaveSubsystem(HeapSubsystem previous);
+  static const char* getSubsystemName(HeapSubsystem subsystem);
+  static bool hasAllocHooks();
+  static const char* getAllocMode();
+
+  uint32_t getFreeHeap();
+  uint32_t getLargestFreeBlock();
+  uint32_t getMinFreeHeap();
+  uint8_t getFragmentation();
+  uint32_t getLastLoopAllocs() { return lastLoopAllocs; }
+  uint32_t getMaxLoopAllocs() { return maxLoopAllocs; }
+  unsigned long getAllocatingLoops() { return allocatingLoops; }
+  const char* getLoopCheckStatus();
+
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
+};
+
+// Przypisuje alokacje w bieżącym zakresie do podsystemu
+class HeapScope {
+private:
+  HeapSubsystem previous;
+
+public:
+  HeapScope(HeapSubsystem subsystem) { previous = HeapMonitor::enterSubsystem(subsystem); }
+  ~HeapScope() { HeapMonitor::leaveSubsystem(previous); }
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "HoldTimeLearner.h"
+#include "HeapMonitor.h"
+
+// Granice przedziałów histogramu [s] - gęściej dla krótkich przerw między utworami
+static const uint16_t HOLD_BIN_EDGES_S[HOLD_BINS + 1] = {
+  0, 1, 2, 3, 4, 6, 8, 11, 15, 20, 30, 45, 60, 90, 150, 300, 600
+};
+
+HoldTimeLearner::HoldTimeLearner() :
+  config(nullptr),
+  logger(nullptr),
+  eeprom(nullptr),
+  totalGaps(0),
+  learnedHoldS(0),
+  dirty(false),
+  lastPersist(0),
+  gateWasOpen(false),
+  relaysWereActive(false),
+  gapStart(0),
+  shutdownAt(0),
+  shutdownHoldS(0),
+  predictedSavedS(0),
+  actualSavedS(0),
+  extraCycles(0),
+  avoidedCycles(0) {
+  memset(counts, 0, sizeof(counts));
+}
+
+void HoldTimeLearner::init(ConfigManager* config, ConsoleLogger* logger, EEPROMClass* eeprom) {
+  this->config = config;
+  this->logger = logger;
+  this->eeprom = eeprom;
+
+  HoldHistogramRecord record;
+  eeprom->get(EEPROM_ADR_HOLD_HISTOGRAM, record);
+  if (record.magic == HOLD_RECORD_MAGIC) {
+    for (int i = 0; i < HOLD_BINS; i++) {
+      counts[i] = record.counts[i];
+      totalGaps += counts[i];
+    }
+    logger->addLog("HOLD", "info", "Histogram przerw wczytany (%lu próbek)", (unsigned long)totalGaps);
+  }
+  recompute();
+  lastPersist = millis();
+}
+
+void HoldTimeLearner::update(bool gateOpen, bool relaysActive) {
+  unsigned long now = millis();
+  long fixedS = (long)config->getCzasPoSyg();
+
+  // Wyłączenie w trakcie przerwy - oszczędność przewidywana względem stałego czasu
+  if (relaysWereActive && !relaysActive && gapStart != 0) {
+    shutdownAt = now;
+    shutdownHoldS = (now - gapStart) / 1000;
+    predictedSavedS += fixedS - (long)shutdownHoldS;
+  }
+
+  if (gateWasOpen && !gateOpen && relaysActive) {
+    gapStart = now;
+    shutdownAt = 0;
+  } else if (!gateWasOpen && gateOpen && gapStart != 0) {
+    unsigned long gapMs = now - gapStart;
+    if (gapMs <= HOLD_MAX_GAP_S * 1000UL) {
+      addGap(gapMs);
+      resolveGap(gapMs, true);
+    } else {
+      resolveGap(gapMs, false);
+    }
+    gapStart = 0;
+    shutdownAt = 0;
+  } else if (gapStart != 0 && now - gapStart > HOLD_MAX_GAP_S * 1000UL) {
+    // Sygnał nie wrócił - koniec słuchania
+    resolveGap(now - gapStart, false);
+    gapStart = 0;
+    shutdownAt = 0;
+  }
+
+  gateWasOpen = gateOpen;
+  relaysWereActive = relaysActive;
+
+  // Zapis do EEPROM tylko przy wyłączonych przekaźnikach
+  if (dirty && !relaysActive && now - lastPersist >= HOLD_PERSIST_INTERVAL_MS) {
+    persist();
+  }
+}
+
+void HoldTimeLearner::addGap(unsigned long gapMs) {
+  unsigned long gapS = gapMs / 1000;
+  int bin = HOLD_BINS - 1;
+  for (int i = 0; i < HOLD_BINS; i++) {
+    if (gapS < HOLD_BIN_EDGES_S[i + 1]) {
+      bin = i;
+      break;
+    }
+  }
+
+  counts[bin]++;
+  totalGaps++;
+
+  // Starzenie - nowsze przerwy ważą więcej niż historia sprzed miesięcy
+  if (totalGaps >= HOLD_AGING_TOTAL) {
+    totalGaps = 0;
+    for (int i = 0; i < HOLD_BINS; i++) {
+      counts[i] /= 2;
+      totalGaps += counts[i];
+    }
+  }
+
+  dirty = true;
+  recompute();
+}
+
+// Rozliczenie rzeczywistej oszczędności po zakończeniu przerwy
+void HoldTimeLearner::resolveGap(unsigned long gapMs, bool returned) {
+  unsigned long fixedMs = config->getCzasPoSyg() * 1000UL;
+
+  if (shutdownAt != 0) {
+    if (returned && gapMs <= fixedMs) {
+      // Stały czas pokryłby przerwę - wzmacniacz był wyłączony, ale kosztem cyklu
+      actualSavedS += (long)(gapMs / 1000) - (long)shutdownHoldS;
+      extraCycles++;
+    } else {
+      actualSavedS += (long)config->getCzasPoSyg() - (long)shutdownHoldS;
+    }
+  } else if (returned && gapMs > fixedMs) {
+    // Stały czas wyłączyłby wzmacniacz - adaptacyjny pokrył przerwę dłuższą pracą
+    actualSavedS -= (long)((gapMs - fixedMs) / 1000);
+    avoidedCycles++;
+  }
+}
+
+// Percentyl przerw, interpolowany liniowo w przedziale histogramu.
+// Granice holdMinS/holdMaxS nakładane są przy odczycie w getHoldSeconds().
+void HoldTimeLearner::recompute() {
+  if (totalGaps < HOLD_MIN_GAPS) {
+    learnedHoldS = 0;
+    return;
+  }
+
+  float target = totalGaps * config->getHoldPercentile() / 100.0f;
+  float cumulative = 0;
+  float holdS = HOLD_BIN_EDGES_S[HOLD_BINS];
+  for (int i = 0; i < HOLD_BINS; i++) {
+    if (counts[i] == 0) continue;
+    if (cumulative + counts[i] >= target) {
+      float fraction = (target - cumulative) / counts[i];
+      holdS = HOLD_BIN_EDGES_S[i] + fraction * (HOLD_BIN_EDGES_S[i + 1] - HOLD_BIN_EDGES_S[i]);
+      break;
+    }
+    cumulative += counts[i];
+  }
+
+  learnedHoldS = (unsigned long)ceilf(holdS);
+}
+
+void HoldTimeLearner::persist() {
+  HeapScope heapScope(HEAP_SYS_CONFIG);
+  HoldHistogramRecord record;
+  record.magic = HOLD_RECORD_MAGIC;
+  memcpy(record.counts, counts, sizeof(counts));
+  eeprom->put(EEPROM_ADR_HOLD_HISTOGRAM, record);
+  eeprom->commit();
+
+  dirty = false;
+  lastPersist = millis();
+  logger->addLog("HOLD", "info", "Histogram przerw zapisany (%lu próbek, podtrzymanie %lus)",
+                 (unsigned long)totalGaps, learnedHoldS);
+}
+
+unsigned long HoldTimeLearner::getHoldSeconds() {
+  if (config->getHoldMode() != HOLD_MODE_ADAPTIVE) return config->getCzasPoSyg();
+  unsigned long holdS = totalGaps < HOLD_MIN_GAPS ? config->getCzasPoSyg() : learnedHoldS;
+  return constrain(holdS, config->getHoldMinS(), config->getHoldMaxS());
+}
+
+void HoldTimeLearner::addDiagnostics(JsonObject diag) {
+  diag["mode"] = config->getHoldMode() == HOLD_MODE_ADAPTIVE ? "adaptive" : "fixed";
+  diag["holdS"] = getHoldSeconds();
+  diag["learnedS"] = learnedHoldS;
+  diag["gaps"] = totalGaps;
+  diag["predictedSavedS"] = predictedSavedS;
+  diag["actualSavedS"] = actualSavedS;
+  diag["extraCycles"] = extraCycles;
+  diag["avoidedCycles"] = avoidedCycles;
+
+  JsonArray histogram = diag.createNestedArray("histogram");
+  for (int i = 0; i < HOLD_BINS; i++) {
+    histogram.add(counts[i]);
+  }
+}
+
+void HoldTimeLearner::printDiagnostics(Stream* out) {
+  out->println();
+  out->println("PODTRZYMANIE:");
+  out->printf("  tryb:            %s, czas %lus (wyuczony %lus, stały %lus)\n",
+              config->getHoldMode() == HOLD_MODE_ADAPTIVE ? "adaptacyjny" : "stały",
+              getHoldSeconds(), learnedHoldS, config->getCzasPoSyg());
+  out->printf("  przerw:          %lu, percentyl %d\n", (unsigned long)totalGaps, config->getHoldPercentile());
+  out->printf("  oszczędność:     przewidywana %lds, rzeczywista %lds\n", (long)predictedSavedS, (long)actualSavedS);
+  out->printf("  cykle:           dodatkowe %lu, uniknięte %lu\n", (unsigned long)extraCycles, (unsigned long)avoidedCycles);
+  for (int i = 0; i < HOLD_BINS; i++) {
+    if (counts[i] == 0) continue;
+    out->printf("    %3u-%3us: %u\n", HOLD_BIN_EDGES_S[i], HOLD_BIN_EDGES_S[i + 1], counts[i]);
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef HOLD_TIME_LEARNER_H
+#define HOLD_TIME_LEARNER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <EEPROM.h>
+#include "ConfigManager.h"
+#include "ConsoleLogger.h"
+
+#define HOLD_BINS 16
+#define HOLD_MAX_GAP_S 600                  // dłuższa cisza = koniec słuchania, nie przerwa
+#define HOLD_MIN_GAPS 10                    // próbek potrzebnych przed użyciem histogramu
+#define HOLD_AGING_TOTAL 1000               // po przekroczeniu liczniki są połowione
+#define HOLD_PERSIST_INTERVAL_MS 1800000UL  // zapis histogramu do EEPROM co 30 min
+#define HOLD_RECORD_MAGIC 0x4854
+
+// Zapis histogramu w EEPROM
+struct HoldHistogramRecord {
+  uint16_t magic;
+  uint16_t counts[HOLD_BINS];
+};
+
+// Uczenie czasu podtrzymania. Mierzy przerwy w sygnale (od zamknięcia do
+// ponownego otwarcia bramki audio) i zlicza je w histogramie o
+// logarytmicznych przedziałach. W trybie adaptacyjnym czas podtrzymania
+// pokrywa zadany percentyl przerw, w granicach holdMinS..holdMaxS.
+//
+// Dla porównania ze stałym czasPoSyg liczone są dwie oszczędności czasu
+// pracy wzmacniacza: przewidywana (czasPoSyg - czas adaptacyjny przy każdym
+// wyłączeniu) i rzeczywista, rozliczana po powrocie sygnału lub upływie
+// HOLD_MAX_GAP_S - uwzględnia dodatkowe cykle przekaźników i cykle uniknięte.
+class HoldTimeLearner {
+private:
+  ConfigManager* config;
+  ConsoleLogger* logger;
+  EEPROMClass* eeprom;
+
+  uint16_t counts[HOLD_BINS];
+  uint32_t totalGaps;
+  unsigned long learnedHoldS;
+  bool dirty;
+  unsigned long lastPersist;
+
+  bool gateWasOpen;
+  bool relaysWereActive;
+  unsigned long gapStart;        // ms, 0 = brak trwającej przerwy
+  unsigned long shutdownAt;      // ms, 0 = przekaźniki nie zostały wyłączone w przerwie
+  unsigned long shutdownHoldS;
+
+  int32_t predictedSavedS;
+  int32_t actualSavedS;
+  uint32_t extraCycles;          // wyłączenie, którego stały czas by uniknął
+  uint32_t avoidedCycles;        // przerwa dłuższa niż stały czas, pokryta adaptacyjnym
+
+  void addGap(unsigned long gapMs);
+  void resolveGap(unsigned long gapMs, bool returned);
+  void recompute();
+  void persist();
+
+public:
+  HoldTimeLearner();
+  void init(ConfigManager* config, ConsoleLogger* logger, EEPROMClass* eeprom);
+  void update(bool gateOpen, bool relaysActive);
+  unsigned long getHoldSeconds();
+  unsigned long getLearnedHoldSeconds() { return learnedHoldS; }
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
+};
+
+#endif
@@ -0,0 +1,537 @@
+#include "HttpServer.h"
+#include <ctype.h>
+#include <lwip/sockets.h>
+
+HttpServer::HttpServer(uint16_t port) :
+  port(port),
+  listenFd(-1),
+  routeCount(0),
+  current(nullptr),
+  currentPath(""),
+  currentQuery(nullptr),
+  extraLength(0),
+  accepted(0),
+  requests(0),
+  keepAliveReuses(0),
+  deferred(0),
+  timeouts(0),
+  errors(0),
+  bytesSent(0),
+  maxActive(0),
+  lastServiceUs(0),
+  maxServiceUs(0) {
+  for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    connections[i].fd = -1;
+    connections[i].state = HTTP_FREE;
+  }
+  extraHeaders[0] = '\0';
+}
+
+bool HttpServer::begin() {
+  if (listenFd >= 0) return true;
+
+  listenFd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (listenFd < 0) return false;
+
+  int enable = 1;
+  lwip_setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (lwip_bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+      lwip_listen(listenFd, HTTP_MAX_CONNECTIONS) < 0) {
+    lwip_close(listenFd);
+    listenFd = -1;
+    return false;
+  }
+  lwip_fcntl(listenFd, F_SETFL, lwip_fcntl(listenFd, F_GETFL, 0) | O_NONBLOCK);
+  return true;
+}
+
+void HttpServer::on(const char* path, std::function<void(void)> handler, bool large) {
+  if (routeCount >= HTTP_MAX_ROUTES) return;
+  routes[routeCount].path = path;
+  routes[routeCount].handler = handler;
+  routes[routeCount].large = large;
+  routeCount++;
+}
+
+bool HttpServer::hasConnections() {
+  for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (connections[i].state != HTTP_FREE) return true;
+  }
+  return false;
+}
+
+// Jedno przejście po wszystkich połączeniach - bez czekania na sieć
+void HttpServer::handleClient() {
+  if (listenFd < 0) return;
+  unsigned long startUs = micros();
+
+  acceptConnections();
+
+  unsigned long now = millis();
+  uint8_t active = 0;
+  for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (connections[i].state == HTTP_FREE) continue;
+    service(connections[i], now);
+    if (connections[i].state != HTTP_FREE) active++;
+  }
+  if (active > maxActive) maxActive = active;
+
+  lastServiceUs = micros() - startUs;
+  if (lastServiceUs > maxServiceUs) maxServiceUs = lastServiceUs;
+}
+
+// Nowe połączenia tylko do liczby wolnych miejsc - reszta czeka w kolejce listen()
+void HttpServer::acceptConnections() {
+  for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    HttpConnection& conn = connections[i];
+    if (conn.state != HTTP_FREE) continue;
+
+    int fd = lwip_accept(listenFd, NULL, NULL);
+    if (fd < 0) return;
+
+    lwip_fcntl(fd, F_SETFL, lwip_fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int noDelay = 1;
+    lwip_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    conn.fd = fd;
+    conn.state = HTTP_READING;
+    conn.rxLength = 0;
+    conn.requestLength = 0;
+    conn.rx[0] = '\0';
+    conn.headLength = 0;
+    conn.headSent = 0;
+    conn.bodyData = nullptr;
+    conn.bodyLength = 0;
+    conn.bodySent = 0;
+    conn.keepAlive = false;
+    conn.large = false;
+    conn.lastActivity = millis();
+    conn.requests = 0;
+    accepted++;
+  }
+}
+
+void HttpServer::service(HttpConnection& conn, unsigned long now) {
+  if (conn.state == HTTP_READING) {
+    if (!receive(conn, now)) return;
+    if (conn.requestLength == 0) {
+      // Niekompletne nagłówki albo bezczynne keep-alive
+      unsigned long limit = conn.rxLength > 0 ? HTTP_REQUEST_TIMEOUT_MS : HTTP_KEEPALIVE_MS;
+      if (now - conn.lastActivity > limit) {
+        if (conn.rxLength > 0) timeouts++;
+        closeConnection(conn);
+      }
+      return;
+    }
+    if (!parseRequest(conn)) {
+      transmit(conn, now);
+      return;
+    }
+    dispatch(conn);
+  } else if (conn.state == HTTP_WAITING) {
+    if (now - conn.lastActivity > HTTP_SEND_TIMEOUT_MS) {
+      timeouts++;
+      closeConnection(conn);
+      return;
+    }
+    dispatch(conn);
+  }
+
+  if (conn.state == HTTP_SENDING) transmit(conn, now);
+}
+
+// Odbiór tego, co już czeka w gnieździe. false = połączenie zamknięte.
+bool HttpServer::receive(HttpConnection& conn, unsigned long now) {
+  int space = HTTP_RX_BUFFER - 1 - conn.rxLength;
+  if (space > 0) {
+    int received = lwip_recv(conn.fd, conn.rx + conn.rxLength, space, MSG_DONTWAIT);
+    if (received == 0) {
+      closeConnection(conn);
+      return false;
+    }
+    if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      errors++;
+      closeConnection(conn);
+      return false;
+    }
+    if (received > 0) {
+      conn.rxLength += received;
+      conn.rx[conn.rxLength] = '\0';
+      conn.lastActivity = now;
+    }
+  }
+
+  const char* end = strstr(conn.rx, "\r\n\r\n");
+  if (end != nullptr) {
+    conn.requestLength = end + 4 - conn.rx;
+  } else if (conn.rxLength >= HTTP_RX_BUFFER - 1) {
+    reject(conn, 431);
+    transmit(conn, now);
+    return false;
+  }
+  return true;
+}
+
+// Linia żądania dzielona w miejscu (zera w rx). false = odrzucone, odpowiedź błędu gotowa.
+bool HttpServer::parseRequest(HttpConnection& conn) {
+  char* line = conn.rx;
+  char* lineEnd = strstr(line, "\r\n");
+  conn.headersOffset = lineEnd + 2 - conn.rx;
+  *lineEnd = '\0';
+
+  if (strncmp(line, "GET ", 4) != 0) {
+    reject(conn, 405);
+    return false;
+  }
+  char* target = line + 4;
+  char* version = strchr(target, ' ');
+  if (version == nullptr || target[0] != '/') {
+    reject(conn, 400);
+    return false;
+  }
+  *version++ = '\0';
+
+  char* query = strchr(target, '?');
+  if (query != nullptr) {
+    *query++ = '\0';
+    conn.queryOffset = query - conn.rx;
+  } else {
+    conn.queryOffset = 0;
+  }
+  conn.pathOffset = target - conn.rx;
+
+  // HTTP/1.1 domyślnie keep-alive, HTTP/1.0 tylko na życzenie
+  conn.keepAlive = strcmp(version, "HTTP/1.1") == 0;
+  const char* value;
+  size_t length;
+  if (findHeader(conn, "Connection", &value, &length)) {
+    if (length == 5 && strncasecmp(value, "close", 5) == 0) conn.keepAlive = false;
+    if (length == 10 && strncasecmp(value, "keep-alive", 10) == 0) conn.keepAlive = true;
+  }
+  return true;
+}
+
+bool HttpServer::largeResponseInFlight() {
+  for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (connections[i].state == HTTP_SENDING && connections[i].large) return true;
+  }
+  return false;
+}
+
+const HttpRoute* HttpServer::findRoute(const char* path) {
+  for (uint8_t i = 0; i < routeCount; i++) {
+    if (strcmp(routes[i].path, path) == 0) return &routes[i];
+  }
+  return nullptr;
+}
+
+// Wywołanie handlera. Duża odpowiedź przy innej dużej w toku czeka (HTTP_WAITING).
+void HttpServer::dispatch(HttpConnection& conn) {
+  const char* path = conn.rx + conn.pathOffset;
+  const HttpRoute* route = findRoute(path);
+  if (route != nullptr && route->large && largeResponseInFlight()) {
+    if (conn.state != HTTP_WAITING) deferred++;
+    conn.state = HTTP_WAITING;
+    return;
+  }
+
+  requests++;
+  conn.requests++;
+  if (conn.requests > 1) keepAliveReuses++;
+  if (conn.requests >= HTTP_MAX_REQUESTS) conn.keepAlive = false;
+
+  current = &conn;
+  currentPath = path;
+  currentQuery = conn.queryOffset != 0 ? conn.rx + conn.queryOffset : nullptr;
+  extraLength = 0;
+  extraHeaders[0] = '\0';
+  conn.headLength = 0;
+  conn.large = route != nullptr && route->large;
+
+  if (route != nullptr) {
+    route->handler();
+  } else if (notFoundHandler) {
+    notFoundHandler();
+  } else {
+    send(404);
+  }
+  if (conn.headLength == 0) send(500);  // handler bez odpowiedzi
+
+  current = nullptr;
+  conn.state = HTTP_SENDING;
+}
+
+// Najwyżej HTTP_TX_SLICE bajtów, tyle ile przyjmie bufor TCP. false = zamknięte.
+bool HttpServer::transmit(HttpConnection& conn, unsigned long now) {
+  size_t budget = HTTP_TX_SLICE;
+  bool progress = false;
+
+  while (budget > 0) {
+    const char* data;
+    size_t remaining;
+    if (conn.headSent < conn.headLength) {
+      data = conn.head + conn.headSent;
+      remaining = conn.headLength - conn.headSent;
+    } else if (conn.bodySent < conn.bodyLength) {
+      data = conn.bodyData + conn.bodySent;
+      remaining = conn.bodyLength - conn.bodySent;
+    } else {
+      finishResponse(conn, now);
+      return conn.state != HTTP_FREE;
+    }
+
+    int sent = lwip_send(conn.fd, data, min(remaining, budget), MSG_DONTWAIT);
+    if (sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      errors++;
+      closeConnection(conn);
+      return false;
+    }
+    if (conn.headSent < conn.headLength) {
+      conn.headSent += sent;
+    } else {
+      conn.bodySent += sent;
+    }
+    budget -= sent;
+    bytesSent += sent;
+    progress = true;
+  }
+
+  if (progress) {
+    conn.lastActivity = now;
+  } else if (now - conn.lastActivity > HTTP_SEND_TIMEOUT_MS) {
+    timeouts++;
+    closeConnection(conn);
+    return false;
+  }
+  return true;
+}
+
+// Koniec odpowiedzi: zwolnienie treści, przy keep-alive następne żądanie
+// (także już odebrane w potoku)
+void HttpServer::finishResponse(HttpConnection& conn, unsigned long now) {
+  conn.body = String();
+  conn.bodyData = nullptr;
+  conn.bodyLength = 0;
+  conn.bodySent = 0;
+  conn.headLength = 0;
+  conn.headSent = 0;
+  conn.large = false;
+
+  if (!conn.keepAlive) {
+    closeConnection(conn);
+    return;
+  }
+
+  uint16_t leftover = conn.rxLength - conn.requestLength;
+  memmove(conn.rx, conn.rx + conn.requestLength, leftover);
+  conn.rxLength = leftover;
+  conn.rx[leftover] = '\0';
+  conn.requestLength = 0;
+  conn.state = HTTP_READING;
+  conn.lastActivity = now;
+}
+
+void HttpServer::reject(HttpConnection& conn, int code) {
+  errors++;
+  conn.keepAlive = false;
+  conn.body = String();
+  conn.bodyData = nullptr;
+  conn.bodyLength = 0;
+  conn.bodySent = 0;
+  conn.headSent = 0;
+  conn.headLength = snprintf(conn.head, sizeof(conn.head),
+                             "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                             code, statusText(code));
+  conn.state = HTTP_SENDING;
+}
+
+void HttpServer::closeConnection(HttpConnection& conn) {
+  if (conn.fd >= 0) lwip_close(conn.fd);
+  conn.fd = -1;
+  conn.state = HTTP_FREE;
+  conn.body = String();
+  conn.bodyData = nullptr;
+  conn.large = false;
+}
+
+const char* HttpServer::statusText(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 302: return "Found";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    default: return "";
+  }
+}
+
+// --- Interfejs żądania ---
+
+String HttpServer::uri() {
+  return String(currentPath);
+}
+
+bool HttpServer::findArg(const char* name, const char** value, size_t* length) {
+  if (currentQuery == nullptr) return false;
+  size_t nameLength = strlen(name);
+  const char* pair = currentQuery;
+  while (*pair != '\0') {
+    const char* end = strchr(pair, '&');
+    if (end == nullptr) end = pair + strlen(pair);
+    const char* equals = (const char*)memchr(pair, '=', end - pair);
+    const char* keyEnd = equals != nullptr ? equals : end;
+    if ((size_t)(keyEnd - pair) == nameLength && strncmp(pair, name, nameLength) == 0) {
+      *value = equals != nullptr ? equals + 1 : end;
+      *length = end - *value;
+      return true;
+    }
+    pair = *end == '&' ? end + 1 : end;
+  }
+  return false;
+}
+
+bool HttpServer::hasArg(const char* name) {
+  const char* value;
+  size_t length;
+  return findArg(name, &value, &length);
+}
+
+String HttpServer::arg(const char* name) {
+  const char* value;
+  size_t length;
+  if (!findArg(name, &value, &length)) return String();
+  return urlDecode(value, length);
+}
+
+String HttpServer::urlDecode(const char* start, size_t length) {
+  String decoded;
+  decoded.reserve(length);
+  for (size_t i = 0; i < length; i++) {
+    char c = start[i];
+    if (c == '+') {
+      c = ' ';
+    } else if (c == '%' && i + 2 < length && isxdigit(start[i + 1]) && isxdigit(start[i + 2])) {
+      char hex[3] = { start[i + 1], start[i + 2], '\0' };
+      c = (char)strtol(hex, nullptr, 16);
+      i += 2;
+    }
+    decoded += c;
+  }
+  return decoded;
+}
+
+bool HttpServer::findHeader(const HttpConnection& conn, const char* name, const char** value, size_t* length) {
+  size_t nameLength = strlen(name);
+  const char* line = conn.rx + conn.headersOffset;
+  const char* end = conn.rx + conn.requestLength - 2;  // bez pustej linii
+  while (line < end) {
+    const char* lineEnd = strstr(line, "\r\n");
+    if (lineEnd == nullptr || lineEnd > end) break;
+    if ((size_t)(lineEnd - line) > nameLength && line[nameLength] == ':' &&
+        strncasecmp(line, name, nameLength) == 0) {
+      const char* start = line + nameLength + 1;
+      while (start < lineEnd && *start == ' ') start++;
+      *value = start;
+      *length = lineEnd - start;
+      return true;
+    }
+    line = lineEnd + 2;
+  }
+  return false;
+}
+
+String HttpServer::header(const char* name) {
+  const char* value;
+  size_t length;
+  if (current == nullptr || !findHeader(*current, name, &value, &length)) return String();
+  String result;
+  result.concat(value, length);
+  return result;
+}
+
+// --- Odpowiedź ---
+
+void HttpServer::sendHeader(const char* name, const char* value) {
+  int written = snprintf(extraHeaders + extraLength, sizeof(extraHeaders) - extraLength, "%s: %s\r\n", name, value);
+  if (written > 0 && extraLength + written < (int)sizeof(extraHeaders)) {
+    extraLength += written;
+  } else {
+    extraHeaders[extraLength] = '\0';  // nie zmieścił się - pominięty
+  }
+}
+
+void HttpServer::prepareResponse(int code, const char* contentType, size_t length) {
+  current->headSent = 0;
+  current->bodySent = 0;
+  current->headLength = snprintf(current->head, sizeof(current->head),
+                                 "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n"
+                                 "Connection: %s\r\n%s\r\n",
+                                 code, statusText(code), contentType, (unsigned)length,
+                                 current->keepAlive ? "keep-alive" : "close", extraHeaders);
+  if (current->headLength >= sizeof(current->head)) current->headLength = sizeof(current->head) - 1;
+}
+
+void HttpServer::send(int code, const char* contentType, const String& content) {
+  if (current == nullptr) return;
+  current->body = content;
+  current->bodyData = current->body.c_str();
+  current->bodyLength = current->body.length();
+  prepareResponse(code, contentType, current->bodyLength);
+}
+
+void HttpServer::send(int code, const char* contentType, String&& content) {
+  if (current == nullptr) return;
+  current->body = std::move(content);
+  current->bodyData = current->body.c_str();
+  current->bodyLength = current->body.length();
+  prepareResponse(code, contentType, current->bodyLength);
+}
+
+void HttpServer::send(int code, const char* contentType, const char* data, size_t length) {
+  if (current == nullptr) return;
+  current->body = String();
+  current->body.reserve(length);
+  current->body.concat(data, length);
+  current->bodyData = current->body.c_str();
+  current->bodyLength = current->body.length();
+  prepareResponse(code, contentType, current->bodyLength);
+}
+
+void HttpServer::send_P(int code, const char* contentType, PGM_P content) {
+  if (current == nullptr) return;
+  current->body = String();
+  current->bodyData = content;
+  current->bodyLength = strlen(content);
+  prepareResponse(code, contentType, current->bodyLength);
+}
+
+void HttpServer::addDiagnostics(JsonObject diag) {
+  uint8_t active = 0;
+  uint8_t waiting = 0;
+  for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (connections[i].state != HTTP_FREE) active++;
+    if (connections[i].state == HTTP_WAITING) waiting++;
+  }
+  diag["listening"] = listenFd >= 0;
+  diag["connections"] = active;
+  diag["waiting"] = waiting;
+  diag["maxConnections"] = maxActive;
+  diag["accepted"] = accepted;
+  diag["requests"] = requests;
+  diag["keepAliveReuses"] = keepAliveReuses;
+  diag["deferred"] = deferred;
+  diag["timeouts"] = timeouts;
+  diag["errors"] = errors;
+  diag["bytesSent"] = bytesSent;
+  diag["lastServiceUs"] = lastServiceUs;
+  diag["maxServiceUs"] = maxServiceUs;
+}
@@ -0,0 +1,135 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+
+#define HTTP_MAX_CONNECTIONS 4           // jednoczesne połączenia (limit klientów softAP)
+#define HTTP_MAX_ROUTES 24
+#define HTTP_RX_BUFFER 1024              // linia żądania + nagłówki
+#define HTTP_HEAD_BUFFER 320             // nagłówki odpowiedzi
+#define HTTP_EXTRA_HEADERS 128           // nagłówki z sendHeader() dla bieżącej odpowiedzi
+#define HTTP_TX_SLICE 2920               // bajtów na połączenie na jedno handleClient() (2 segmenty TCP)
+#define HTTP_REQUEST_TIMEOUT_MS 3000     // na komplet nagłówków
+#define HTTP_KEEPALIVE_MS 5000           // bezczynne połączenie keep-alive
+#define HTTP_SEND_TIMEOUT_MS 10000       // brak postępu wysyłki - klient poza zasięgiem
+#define HTTP_MAX_REQUESTS 100            // żądań na jedno połączenie keep-alive
+
+enum HttpConnectionState : uint8_t {
+  HTTP_FREE,
+  HTTP_READING,        // zbieranie nagłówków żądania
+  HTTP_WAITING,        // duża odpowiedź czeka, aż zwolni się bufor innego połączenia
+  HTTP_SENDING         // wysyłka wznawiana w kolejnych wywołaniach handleClient()
+};
+
+struct HttpConnection {
+  int fd;
+  HttpConnectionState state;
+  char rx[HTTP_RX_BUFFER];
+  uint16_t rxLength;
+  uint16_t requestLength;        // długość żądania z pustą linią, 0 = nagłówki niekompletne
+  uint16_t pathOffset;           // ścieżka, zapytanie i nagłówki - przesunięcia w rx
+  uint16_t queryOffset;          // 0 = brak zapytania
+  uint16_t headersOffset;
+  char head[HTTP_HEAD_BUFFER];
+  uint16_t headLength;
+  uint16_t headSent;
+  String body;                   // treść zbudowana przez handler (zwalniana po wysyłce)
+  const char* bodyData;          // wskaźnik do wysyłki: body albo stała we flashu
+  size_t bodyLength;
+  size_t bodySent;
+  bool keepAlive;
+  bool large;                    // odpowiedź trasy oznaczonej jako duża
+  unsigned long lastActivity;    // ms, ostatni odebrany lub wysłany bajt
+  uint16_t requests;
+};
+
+struct HttpRoute {
+  const char* path;
+  std::function<void(void)> handler;
+  bool large;
+};
+
+// Nieblokujący serwer HTTP/1.1 na gniazdach lwIP, obsługiwany z loop().
+// Każde handleClient() przyjmuje nowe połączenia, odbiera tylko to, co już
+// czeka w gnieździe, i wysyła najwyżej HTTP_TX_SLICE bajtów na połączenie
+// (MSG_DONTWAIT) - wolny klient na słabym łączu nie zatrzymuje pętli, a
+// niedokończona wysyłka wznawiana jest w następnej iteracji.
+//
+// Handlery wywoływane są w kontekście pętli (bez wyścigów z logiką
+// sterownika) i używają interfejsu zgodnego z WebServer: arg(), hasArg(),
+// header(), sendHeader(), send(). Odpowiedź jest buforowana w połączeniu,
+// keep-alive i kilka połączeń naraz. Bufory odbioru i nagłówków mają stały
+// rozmiar; trasy oznaczone jako duże (panel, /diag) budują treść tylko dla
+// jednego połączenia naraz, pozostałe czekają w stanie HTTP_WAITING.
+class HttpServer {
+private:
+  uint16_t port;
+  int listenFd;
+  HttpConnection connections[HTTP_MAX_CONNECTIONS];
+  HttpRoute routes[HTTP_MAX_ROUTES];
+  uint8_t routeCount;
+  std::function<void(void)> notFoundHandler;
+
+  // Bieżące żądanie (ważne w trakcie wywołania handlera)
+  HttpConnection* current;
+  const char* currentPath;
+  const char* currentQuery;
+  char extraHeaders[HTTP_EXTRA_HEADERS];
+  uint8_t extraLength;
+
+  uint32_t accepted;
+  uint32_t requests;
+  uint32_t keepAliveReuses;
+  uint32_t deferred;             // duże odpowiedzi odłożone na później
+  uint32_t timeouts;
+  uint32_t errors;               // błąd gniazda, przepełnienie bufora, zła metoda
+  uint64_t bytesSent;
+  uint8_t maxActive;
+  uint32_t lastServiceUs;
+  uint32_t maxServiceUs;
+
+  void acceptConnections();
+  void service(HttpConnection& conn, unsigned long now);
+  bool receive(HttpConnection& conn, unsigned long now);
+  bool parseRequest(HttpConnection& conn);
+  void dispatch(HttpConnection& conn);
+  bool transmit(HttpConnection& conn, unsigned long now);
+  void finishResponse(HttpConnection& conn, unsigned long now);
+  void reject(HttpConnection& conn, int code);
+  void prepareResponse(int code, const char* contentType, size_t length);
+  void closeConnection(HttpConnection& conn);
+  bool largeResponseInFlight();
+  const HttpRoute* findRoute(const char* path);
+  bool findArg(const char* name, const char** value, size_t* length);
+  static bool findHeader(const HttpConnection& conn, const char* name, const char** value, size_t* length);
+  static const char* statusText(int code);
+  static String urlDecode(const char* start, size_t length);
+
+public:
+  HttpServer(uint16_t port = 80);
+  bool begin();
+  void handleClient();
+  bool hasConnections();
+  void on(const char* path, std::function<void(void)> handler, bool large = false);
+  void onNotFound(std::function<void(void)> handler) { notFoundHandler = handler; }
+
+  // Interfejs żądania - jak w WebServer
+  String uri();
+  bool hasArg(const char* name);
+  String arg(const char* name);
+  String header(const char* name);
+
+  // Odpowiedź: send() kopiuje treść do połączenia, send_P() wysyła stałą
+  // z flasha bez kopiowania
+  void sendHeader(const char* name, const char* value);
+  void send(int code, const char* contentType = "text/plain", const String& content = String());
+  void send(int code, const char* contentType, String&& content);
+  void send(int code, const char* contentType, const char* data, size_t length);
+  void send_P(int code, const char* contentType, PGM_P content);
+
+  void addDiagnostics(JsonObject diag);
+};
+
+#endif
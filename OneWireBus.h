@@ -0,0 +1,27 @@
+#ifndef ONE_WIRE_BUS_H
+#define ONE_WIRE_BUS_H
+
+// Wybór sterownika magistrali 1-Wire w czasie kompilacji:
+// 0 - biblioteka OneWire (bit-bang z wyłączaniem przerwań na każdy slot),
+// 1 - OneWireRmt na peryferium RMT. Oba mają to samo API.
+#ifndef ONEWIRE_USE_RMT
+#define ONEWIRE_USE_RMT 0
+#endif
+
+#if ONEWIRE_USE_RMT
+#include "OneWireRmt.h"
+typedef OneWireRmt OneWireBus;
+#else
+#include <OneWire.h>
+typedef OneWire OneWireBus;
+#endif
+
+// Koniec transakcji na magistrali. Sterownik RMT wyłącza kanały i zwalnia
+// blokadę PM; biblioteka OneWire nie trzyma żadnych zasobów między slotami.
+inline void oneWireIdle(OneWireBus* bus) {
+#if ONEWIRE_USE_RMT
+  bus->idle();
+#endif
+}
+
+#endif
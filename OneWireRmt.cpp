@@ -0,0 +1,279 @@
+#include "OneWireRmt.h"
+#include <driver/gpio.h>
+
+static rmt_symbol_word_t slotSymbol(uint16_t lowUs, uint16_t highUs) {
+  rmt_symbol_word_t symbol;
+  symbol.level0 = 0;
+  symbol.duration0 = lowUs;
+  symbol.level1 = 1;
+  symbol.duration1 = highUs;
+  return symbol;
+}
+
+OneWireRmt::OneWireRmt(uint8_t pin) :
+  pin((gpio_num_t)pin),
+  ready(false),
+  failed(false),
+  enabled(false),
+  txChannel(NULL),
+  rxChannel(NULL),
+  encoder(NULL),
+  rxQueue(NULL),
+  lastDiscrepancy(0),
+  lastDevice(false) {
+  memset(searchRom, 0, sizeof(searchRom));
+}
+
+// Kanały tworzone przy pierwszym użyciu - konstruktor obiektu globalnego
+// działa przed startem sterowników
+bool OneWireRmt::begin() {
+  if (ready) return true;
+  if (failed) return false;
+  failed = true;
+
+  // RX przed TX - kanał TX w pętli zwrotnej podłącza się do tego samego pinu
+  rmt_rx_channel_config_t rxConfig = {};
+  rxConfig.gpio_num = pin;
+  rxConfig.clk_src = ONEWIRE_RMT_CLK_SRC;
+  rxConfig.resolution_hz = ONEWIRE_RMT_RESOLUTION_HZ;
+  rxConfig.mem_block_symbols = ONEWIRE_RMT_MEM_SYMBOLS;
+  if (rmt_new_rx_channel(&rxConfig, &rxChannel) != ESP_OK) return false;
+
+  rmt_tx_channel_config_t txConfig = {};
+  txConfig.gpio_num = pin;
+  txConfig.clk_src = ONEWIRE_RMT_CLK_SRC;
+  txConfig.resolution_hz = ONEWIRE_RMT_RESOLUTION_HZ;
+  txConfig.mem_block_symbols = ONEWIRE_RMT_MEM_SYMBOLS;
+  txConfig.trans_queue_depth = 4;
+  txConfig.flags.io_loop_back = 1;
+  txConfig.flags.io_od_mode = 1;
+  if (rmt_new_tx_channel(&txConfig, &txChannel) != ESP_OK) {
+    rmt_del_channel(rxChannel);
+    return false;
+  }
+
+  rmt_copy_encoder_config_t encoderConfig = {};
+  rxQueue = xQueueCreate(1, sizeof(rmt_rx_done_event_data_t));
+  if (rxQueue == NULL || rmt_new_copy_encoder(&encoderConfig, &encoder) != ESP_OK) {
+    rmt_del_channel(txChannel);
+    rmt_del_channel(rxChannel);
+    return false;
+  }
+
+  rmt_rx_event_callbacks_t callbacks = {};
+  callbacks.on_recv_done = &OneWireRmt::handleReceive;
+  rmt_rx_register_event_callbacks(rxChannel, &callbacks, this);
+
+  // Wewnętrzne podciąganie tylko wspiera zewnętrzny rezystor 4.7k
+  gpio_pullup_en(pin);
+
+  ready = true;
+  failed = false;
+
+  // Zwolnienie linii - do pierwszej transmisji wyjście TX trzyma stan niski.
+  // Po transmisji poziom bezczynności (eot_level = 1) zostaje także przy
+  // wyłączonym kanale.
+  txSymbols[0].level0 = 1;
+  txSymbols[0].duration0 = 1;
+  txSymbols[0].level1 = 1;
+  txSymbols[0].duration1 = 1;
+  acquire();
+  transmit(1);
+  idle();
+  return true;
+}
+
+// Włączenie kanałów na czas transakcji
+bool OneWireRmt::acquire() {
+  if (!begin()) return false;
+  if (enabled) return true;
+  if (rmt_enable(rxChannel) != ESP_OK) return false;
+  if (rmt_enable(txChannel) != ESP_OK) {
+    rmt_disable(rxChannel);
+    return false;
+  }
+  enabled = true;
+  return true;
+}
+
+// Koniec transakcji - wyłączenie kanałów zwalnia blokadę PM
+void OneWireRmt::idle() {
+  if (!enabled) return;
+  rmt_disable(txChannel);
+  rmt_disable(rxChannel);
+  enabled = false;
+}
+
+bool IRAM_ATTR OneWireRmt::handleReceive(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t* data, void* arg) {
+  OneWireRmt* self = (OneWireRmt*)arg;
+  BaseType_t woken = pdFALSE;
+  xQueueSendFromISR(self->rxQueue, data, &woken);
+  return woken == pdTRUE;
+}
+
+// Nadanie txSymbols[0..count); linia zostaje zwolniona (poziom wysoki)
+bool OneWireRmt::transmit(size_t count) {
+  rmt_transmit_config_t config = {};
+  config.flags.eot_level = 1;
+  if (rmt_transmit(txChannel, encoder, txSymbols, count * sizeof(rmt_symbol_word_t), &config) != ESP_OK) return false;
+  return rmt_tx_wait_all_done(txChannel, ONEWIRE_RMT_TIMEOUT_MS) == ESP_OK;
+}
+
+// Nadanie slotów z jednoczesnym odbiorem linii. Stan dłuższy niż idleNs
+// kończy odbiór. Zwraca liczbę odebranych symboli, 0 przy błędzie lub
+// przekroczeniu czasu.
+size_t OneWireRmt::exchange(size_t count, uint32_t idleNs) {
+  rmt_rx_done_event_data_t event;
+  while (xQueueReceive(rxQueue, &event, 0) == pdTRUE) {
+  }
+
+  rmt_receive_config_t config = {};
+  config.signal_range_min_ns = ONEWIRE_RX_FILTER_NS;
+  config.signal_range_max_ns = idleNs;
+  if (rmt_receive(rxChannel, rxSymbols, sizeof(rxSymbols), &config) != ESP_OK) return 0;
+
+  if (!transmit(count) || xQueueReceive(rxQueue, &event, pdMS_TO_TICKS(ONEWIRE_RMT_TIMEOUT_MS)) != pdTRUE) {
+    // Przerwanie zawieszonego odbioru
+    rmt_disable(rxChannel);
+    rmt_enable(rxChannel);
+    return 0;
+  }
+  return event.num_symbols;
+}
+
+void OneWireRmt::writeBits(uint8_t value, uint8_t count) {
+  if (!acquire()) return;
+  for (uint8_t i = 0; i < count; i++) {
+    txSymbols[i] = (value >> i) & 0x01
+      ? slotSymbol(ONEWIRE_WRITE1_LOW_US, ONEWIRE_SLOT_US - ONEWIRE_WRITE1_LOW_US)
+      : slotSymbol(ONEWIRE_WRITE0_LOW_US, ONEWIRE_SLOT_US - ONEWIRE_WRITE0_LOW_US);
+  }
+  transmit(count);
+}
+
+// Slot odczytu: krótki stan niski mastera, czujnik nadający 0 przedłuża go
+// ponad ONEWIRE_READ_SAMPLE_US. Brak odpowiedzi czyta się jako 1, jak w OneWire.
+uint8_t OneWireRmt::readBits(uint8_t count) {
+  if (!acquire()) return 0xFF;
+  for (uint8_t i = 0; i < count; i++) {
+    txSymbols[i] = slotSymbol(ONEWIRE_READ_LOW_US, ONEWIRE_SLOT_US - ONEWIRE_READ_LOW_US);
+  }
+  size_t received = exchange(count, ONEWIRE_RX_IDLE_NS);
+
+  uint8_t value = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (i >= received || rxSymbols[i].duration0 <= ONEWIRE_READ_SAMPLE_US) value |= 1 << i;
+  }
+  return value;
+}
+
+// Zwraca 1, gdy po resecie na linii pojawił się impuls presence
+uint8_t OneWireRmt::reset() {
+  if (!acquire()) return 0;
+  txSymbols[0] = slotSymbol(ONEWIRE_RESET_LOW_US, ONEWIRE_RESET_WAIT_US);
+  // Pierwszy odebrany stan niski to własny reset, presence jest kolejnym.
+  // Zakres odbioru musi obejmować 480 us resetu - przy zakresie slotów
+  // (100 us) odbiór kończy się wewnątrz resetu i presence nie jest widoczny.
+  return exchange(1, ONEWIRE_RX_RESET_IDLE_NS) >= 2 ? 1 : 0;
+}
+
+void OneWireRmt::select(const uint8_t rom[8]) {
+  write(0x55);  // MATCH ROM
+  write_bytes(rom, 8);
+}
+
+void OneWireRmt::skip() {
+  write(0xCC);  // SKIP ROM
+}
+
+void OneWireRmt::write(uint8_t value, uint8_t power) {
+  writeBits(value, 8);
+}
+
+void OneWireRmt::write_bytes(const uint8_t* buf, uint16_t count, bool power) {
+  for (uint16_t i = 0; i < count; i++) {
+    write(buf[i]);
+  }
+}
+
+uint8_t OneWireRmt::read() {
+  return readBits(8);
+}
+
+void OneWireRmt::read_bytes(uint8_t* buf, uint16_t count) {
+  for (uint16_t i = 0; i < count; i++) {
+    buf[i] = read();
+  }
+}
+
+void OneWireRmt::write_bit(uint8_t value) {
+  writeBits(value ? 1 : 0, 1);
+}
+
+uint8_t OneWireRmt::read_bit() {
+  return readBits(1);
+}
+
+void OneWireRmt::reset_search() {
+  lastDiscrepancy = 0;
+  lastDevice = false;
+  memset(searchRom, 0, sizeof(searchRom));
+}
+
+// Wyszukiwanie ROM wg Maxim AN187; bit i jego dopełnienie czytane jednym
+// odbiorem RMT
+uint8_t OneWireRmt::search(uint8_t* newAddr, bool search_mode) {
+  if (lastDevice || !reset()) {
+    reset_search();
+    return 0;
+  }
+  write(search_mode ? 0xF0 : 0xEC);  // SEARCH ROM / ALARM SEARCH
+
+  int lastZero = 0;
+  for (int bit = 1; bit <= 64; bit++) {
+    uint8_t pair = readBits(2);
+    uint8_t idBit = pair & 0x01;
+    uint8_t complementBit = (pair >> 1) & 0x01;
+    if (idBit && complementBit) {
+      reset_search();
+      return 0;
+    }
+
+    uint8_t index = (bit - 1) / 8;
+    uint8_t mask = 1 << ((bit - 1) % 8);
+    uint8_t direction;
+    if (idBit != complementBit) {
+      direction = idBit;
+    } else {
+      direction = bit < lastDiscrepancy ? (searchRom[index] & mask ? 1 : 0) : (bit == lastDiscrepancy ? 1 : 0);
+      if (direction == 0) lastZero = bit;
+    }
+
+    if (direction) {
+      searchRom[index] |= mask;
+    } else {
+      searchRom[index] &= ~mask;
+    }
+    writeBits(direction, 1);
+  }
+
+  lastDiscrepancy = lastZero;
+  if (lastDiscrepancy == 0) lastDevice = true;
+  memcpy(newAddr, searchRom, 8);
+  return 1;
+}
+
+// CRC-8 Dallas/Maxim (x^8 + x^5 + x^4 + 1)
+uint8_t OneWireRmt::crc8(const uint8_t* addr, uint8_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    uint8_t inbyte = *addr++;
+    for (uint8_t i = 8; i; i--) {
+      uint8_t mix = (crc ^ inbyte) & 0x01;
+      crc >>= 1;
+      if (mix) crc ^= 0x8C;
+      inbyte >>= 1;
+    }
+  }
+  return crc;
+}
@@ -0,0 +1,94 @@
+#ifndef ONE_WIRE_RMT_H
+#define ONE_WIRE_RMT_H
+
+#include <Arduino.h>
+#include <driver/rmt_tx.h>
+#include <driver/rmt_rx.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <soc/soc_caps.h>
+
+#define ONEWIRE_RMT_RESOLUTION_HZ 1000000  // 1 tick = 1 us
+#define ONEWIRE_RMT_MEM_SYMBOLS 48         // blok pamięci kanału ESP32-C3
+#define ONEWIRE_RMT_TIMEOUT_MS 10
+
+// Zegar RMT z kwarcu: przy włączonym kanale sterownik trzyma tylko blokadę
+// NO_LIGHT_SLEEP zamiast APB_FREQ_MAX, więc DFS działa także w trakcie transakcji
+#if SOC_RMT_SUPPORT_XTAL
+#define ONEWIRE_RMT_CLK_SRC RMT_CLK_SRC_XTAL
+#else
+#define ONEWIRE_RMT_CLK_SRC RMT_CLK_SRC_DEFAULT
+#endif
+
+// Czasy slotów 1-Wire [us] (tryb standardowy)
+#define ONEWIRE_RESET_LOW_US 480
+#define ONEWIRE_RESET_WAIT_US 480          // presence + odstęp po resecie
+#define ONEWIRE_SLOT_US 70
+#define ONEWIRE_WRITE1_LOW_US 6
+#define ONEWIRE_WRITE0_LOW_US 60
+#define ONEWIRE_READ_LOW_US 6
+#define ONEWIRE_READ_SAMPLE_US 15          // dłuższe zero na linii = czujnik nadaje 0
+#define ONEWIRE_RX_IDLE_NS 100000          // koniec odbioru slotów po 100 us ciszy
+#define ONEWIRE_RX_RESET_IDLE_NS 1000000   // reset: dłużej niż impuls 480 us, inaczej odbiór kończy się przed presence
+#define ONEWIRE_RX_FILTER_NS 1000
+
+// Sterownik 1-Wire na peryferium RMT z API zgodnym z biblioteką OneWire.
+// Kanał TX w trybie open-drain nadaje sloty, kanał RX na tym samym pinie
+// (pętla zwrotna) mierzy szerokość stanu niskiego - odczyt bitu i presence
+// bez wyłączania przerwań. Wywołania są blokujące dla zadania, ale czekają
+// na kolejce FreeRTOS, więc przerwania, WiFi i timery działają normalnie.
+// Wymaga zewnętrznego rezystora podciągającego; zasilanie pasożytnicze
+// (silne podciąganie po write(v, 1)) nie jest obsługiwane.
+//
+// Kanały włączane są przy pierwszym slocie transakcji i wyłączane przez
+// idle() - włączony kanał RMT trzyma blokadę zarządzania energią, która
+// poza transakcją blokowałaby light sleep.
+class OneWireRmt {
+private:
+  gpio_num_t pin;
+  bool ready;
+  bool failed;
+  bool enabled;                      // kanały włączone (blokada PM trzymana)
+  rmt_channel_handle_t txChannel;
+  rmt_channel_handle_t rxChannel;
+  rmt_encoder_handle_t encoder;
+  QueueHandle_t rxQueue;
+  rmt_symbol_word_t txSymbols[ONEWIRE_RMT_MEM_SYMBOLS];
+  rmt_symbol_word_t rxSymbols[ONEWIRE_RMT_MEM_SYMBOLS];
+
+  // Stan wyszukiwania (algorytm Maxim AN187)
+  uint8_t searchRom[8];
+  int lastDiscrepancy;
+  bool lastDevice;
+
+  bool begin();
+  bool acquire();
+  bool transmit(size_t count);
+  size_t exchange(size_t count, uint32_t idleNs);
+  uint8_t readBits(uint8_t count);
+  void writeBits(uint8_t value, uint8_t count);
+
+  static bool IRAM_ATTR handleReceive(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t* data, void* arg);
+
+public:
+  OneWireRmt(uint8_t pin);
+
+  uint8_t reset();
+  void select(const uint8_t rom[8]);
+  void skip();
+  void write(uint8_t value, uint8_t power = 0);
+  void write_bytes(const uint8_t* buf, uint16_t count, bool power = 0);
+  uint8_t read();
+  void read_bytes(uint8_t* buf, uint16_t count);
+  void write_bit(uint8_t value);
+  uint8_t read_bit();
+  void depower() {}
+  void idle();
+
+  void reset_search();
+  uint8_t search(uint8_t* newAddr, bool search_mode = true);
+
+  static uint8_t crc8(const uint8_t* addr, uint8_t len);
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "PowerManager.h"
+
+static const char* const POWER_STATE_NAMES[POWER_STATE_COUNT] = {
+  "sequencing", "apClients", "uart", "apIdle", "playing", "idle"
+};
+
+static const uint16_t POWER_STATE_CURRENT_MA[POWER_STATE_COUNT] = {
+  PM_CURRENT_SEQUENCING_MA, PM_CURRENT_AP_CLIENTS_MA, PM_CURRENT_UART_MA,
+  PM_CURRENT_AP_IDLE_MA, PM_CURRENT_PLAYING_MA, PM_CURRENT_IDLE_MA
+};
+
+bool PowerManager::pwmClockXtal = false;
+
+PowerManager::PowerManager() :
+  relayControllers(nullptr),
+  webServer(nullptr),
+  uartManager(nullptr),
+  buttonManager(nullptr),
+  logger(nullptr),
+  tickTimer(NULL),
+  residencyMux(portMUX_INITIALIZER_UNLOCKED),
+  pmEnabled(false),
+  lightSleepEnabled(false),
+  performanceLocked(false),
+  sleepLocked(false),
+#ifdef CONFIG_PM_ENABLE
+  cpuLock(NULL),
+  sleepLock(NULL),
+#endif
+  state(POWER_SEQUENCING),
+  stateSince(0),
+  transitions(0) {
+  memset(residencyUs, 0, sizeof(residencyUs));
+}
+
+// Musi być wywołane przed pierwszym ledcAttach() - źródło zegara jest wspólne
+// dla wszystkich timerów LEDC
+void PowerManager::selectPwmClock(ConsoleLogger* logger) {
+#if PM_PWM_XTAL_CLOCK
+  pwmClockXtal = ledcSetClockSource(LEDC_USE_XTAL_CLK);
+#endif
+  if (!pwmClockXtal) {
+    logger->addLog("POWER", "warning", "PWM taktowany z APB - częstotliwość zmienia się z DFS");
+  }
+}
+
+void PowerManager::init(RelayController* relayControllers, SubwooferWebServer* webServer, UartManager* uartManager, ButtonManager* buttonManager, ConsoleLogger* logger) {
+  this->relayControllers = relayControllers;
+  this->webServer = webServer;
+  this->uartManager = uartManager;
+  this->buttonManager = buttonManager;
+  this->logger = logger;
+
+#ifdef CONFIG_PM_ENABLE
+  esp_pm_config_t pmConfig = {};
+  pmConfig.max_freq_mhz = PM_MAX_FREQ_MHZ;
+  pmConfig.min_freq_mhz = PM_MIN_FREQ_MHZ;
+#ifdef CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  pmConfig.light_sleep_enable = true;
+#endif
+  if (esp_pm_configure(&pmConfig) == ESP_OK &&
+      esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "pm_perf", &cpuLock) == ESP_OK &&
+      esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "pm_nosleep", &sleepLock) == ESP_OK) {
+    pmEnabled = true;
+    lightSleepEnabled = pmConfig.light_sleep_enable;
+  } else {
+    logger->addLog("POWER", "warning", "Konfiguracja esp_pm nieudana - pełny zegar");
+  }
+#else
+  logger->addLog("POWER", "info", "Brak CONFIG_PM_ENABLE - tylko pomiar czasu stanów");
+#endif
+
+  // Przycisk wybudza z light sleep poziomem na GPIO (uzbrajany w stanie bezczynności)
+  if (lightSleepEnabled) {
+    esp_sleep_enable_gpio_wakeup();
+  }
+
+  // Okresowe wybudzenie - rozliczanie czasu stanów także podczas uśpienia pętli
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = &PowerManager::handleTick;
+  timerArgs.arg = this;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "pm_tick";
+  timerArgs.skip_unhandled_events = true;
+  if (esp_timer_create(&timerArgs, &tickTimer) == ESP_OK) {
+    esp_timer_start_periodic(tickTimer, PM_TICK_PERIOD_US);
+  }
+
+  // Start w stanie pełnej wydajności do pierwszego update()
+  stateSince = esp_timer_get_time();
+  applyLocks(POWER_SEQUENCING);
+}
+
+void PowerManager::handleTick(void* arg) {
+  PowerManager* self = (PowerManager*)arg;
+  self->accountResidency(esp_timer_get_time());
+}
+
+void PowerManager::accountResidency(int64_t now) {
+  portENTER_CRITICAL(&residencyMux);
+  residencyUs[state] += now - stateSince;
+  stateSince = now;
+  portEXIT_CRITICAL(&residencyMux);
+}
+
+void PowerManager::readResidency(int64_t* out) {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&residencyMux);
+  residencyUs[state] += now - stateSince;
+  stateSince = now;
+  memcpy(out, residencyUs, sizeof(residencyUs));
+  portEXIT_CRITICAL(&residencyMux);
+}
+
+PowerState PowerManager::evaluateState() {
+  bool sequencing = false;
+  bool playing = false;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    if (!relayControllers[z].isIdle()) sequencing = true;
+    if (relayControllers[z].isActive()) playing = true;
+  }
+
+  if (sequencing) return POWER_SEQUENCING;
+  if (webServer->isActive() && webServer->getConnectedClients() > 0) return POWER_AP_CLIENTS;
+  if (uartManager->isActive()) return POWER_UART;
+  if (webServer->isActive()) return POWER_AP_IDLE;
+  if (playing) return POWER_PLAYING;
+  return POWER_IDLE;
+}
+
+void PowerManager::update() {
+  PowerState newState = evaluateState();
+  if (newState == state) return;
+
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&residencyMux);
+  residencyUs[state] += now - stateSince;
+  stateSince = now;
+  state = newState;
+  portEXIT_CRITICAL(&residencyMux);
+
+  transitions++;
+  applyLocks(newState);
+}
+
+void PowerManager::applyLocks(PowerState newState) {
+  bool wantPerformance = newState == POWER_SEQUENCING || newState == POWER_AP_CLIENTS || newState == POWER_UART;
+  bool wantNoSleep = newState != POWER_IDLE;
+
+#ifdef CONFIG_PM_ENABLE
+  if (pmEnabled) {
+    if (wantPerformance && !performanceLocked) esp_pm_lock_acquire(cpuLock);
+    if (!wantPerformance && performanceLocked) esp_pm_lock_release(cpuLock);
+    if (wantNoSleep && !sleepLocked) esp_pm_lock_acquire(sleepLock);
+    if (!wantNoSleep && sleepLocked) esp_pm_lock_release(sleepLock);
+  }
+#endif
+  performanceLocked = wantPerformance;
+  sleepLocked = wantNoSleep;
+
+  // Wybudzenie przyciskiem potrzebne tylko wtedy, gdy light sleep jest dozwolony
+  if (lightSleepEnabled) {
+    buttonManager->setSleepWake(!wantNoSleep);
+  }
+}
+
+const char* PowerManager::getStateName(PowerState state) {
+  return POWER_STATE_NAMES[state];
+}
+
+uint16_t PowerManager::getStateCurrentMa(PowerState state, bool sleepEnabled) {
+  if (state == POWER_IDLE && sleepEnabled) {
+    // Light sleep między oknami próbkowania audio, szacunek
+    return AUDIO_IDLE_USE_MONITOR ? PM_CURRENT_IDLE_ADC_MA : PM_CURRENT_IDLE_POLL_MA;
+  }
+  return POWER_STATE_CURRENT_MA[state];
+}
+
+void PowerManager::addDiagnostics(JsonObject diag) {
+  int64_t residency[POWER_STATE_COUNT];
+  readResidency(residency);
+
+  int64_t totalUs = 0;
+  float chargeMas = 0;  // mA*s
+  for (int i = 0; i < POWER_STATE_COUNT; i++) {
+    totalUs += residency[i];
+    chargeMas += getStateCurrentMa((PowerState)i, lightSleepEnabled) * (residency[i] / 1000000.0f);
+  }
+
+  diag["pm"] = pmEnabled;
+  diag["lightSleep"] = lightSleepEnabled;
+  diag["idleSampling"] = AUDIO_IDLE_USE_MONITOR ? "adc_monitor_window" : "oneshot";
+  diag["currentEstimated"] = true;
+  diag["pwmClock"] = pwmClockXtal ? "xtal" : "apb";
+  diag["state"] = getStateName(state);
+  diag["perfLock"] = performanceLocked;
+  diag["transitions"] = transitions;
+  diag["avgMa"] = totalUs > 0 ? chargeMas / (totalUs / 1000000.0f) : 0;
+  diag["mAh"] = chargeMas / 3600.0f;
+
+  JsonObject residencyMs = diag.createNestedObject("residencyMs");
+  for (int i = 0; i < POWER_STATE_COUNT; i++) {
+    residencyMs[POWER_STATE_NAMES[i]] = (uint32_t)(residency[i] / 1000);
+  }
+}
+
+void PowerManager::printDiagnostics(Stream* out) {
+  int64_t residency[POWER_STATE_COUNT];
+  readResidency(residency);
+
+  int64_t totalUs = 0;
+  for (int i = 0; i < POWER_STATE_COUNT; i++) totalUs += residency[i];
+
+  out->println();
+  out->println("ZASILANIE:");
+  out->printf("  esp_pm:          %s, light sleep: %s%s\n", pmEnabled ? "tak" : "nie", lightSleepEnabled ? "tak" : "nie",
+              lightSleepEnabled ? " (w idle między oknami próbkowania audio)" : "");
+  out->printf("  zegar PWM:       %s\n", pwmClockXtal ? "XTAL" : "APB (zmienny z DFS)");
+  out->printf("  stan:            %s%s\n", getStateName(state), performanceLocked ? " (pełny zegar)" : "");
+  out->printf("  przejść:         %lu\n", (unsigned long)transitions);
+
+  float chargeMas = 0;
+  for (int i = 0; i < POWER_STATE_COUNT; i++) {
+    uint16_t currentMa = getStateCurrentMa((PowerState)i, lightSleepEnabled);
+    float seconds = residency[i] / 1000000.0f;
+    chargeMas += currentMa * seconds;
+    out->printf("    %-11s %8.1f s  %5.1f%%  ~%u mA\n", POWER_STATE_NAMES[i], seconds,
+                totalUs > 0 ? 100.0f * residency[i] / totalUs : 0.0f, currentMa);
+  }
+  if (totalUs > 0) {
+    out->printf("  średnio:         ~%.1f mA, zużyto ~%.2f mAh\n", chargeMas / (totalUs / 1000000.0f), chargeMas / 3600.0f);
+  }
+  out->println("  (prąd w stanach: szacunek, niezmierzony)");
+}
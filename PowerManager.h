@@ -0,0 +1,114 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include <esp_sleep.h>
+#include <freertos/FreeRTOS.h>
+#include <soc/soc_caps.h>
+#ifdef CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+#include "ConsoleLogger.h"
+#include "RelayController.h"
+#include "SubwooferWebServer.h"
+#include "UartManager.h"
+#include "ButtonManager.h"
+#include "SensorManager.h"
+
+// LEDC taktowany z XTAL (40 MHz) - zegar APB zmienia się z DFS i przesuwałby
+// częstotliwość PWM. Wybór źródła zegara LEDC od Arduino-ESP32 3.1.
+#if defined(ESP_ARDUINO_VERSION) && ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(3, 1, 0) && defined(SOC_LEDC_SUPPORT_XTAL_CLOCK)
+#define PM_PWM_XTAL_CLOCK 1
+#else
+#define PM_PWM_XTAL_CLOCK 0
+#endif
+
+#define PM_MAX_FREQ_MHZ 160
+#define PM_MIN_FREQ_MHZ 40           // XTAL - najniższa częstotliwość DFS
+#define PM_TICK_PERIOD_US 1000000    // okresowe wybudzenie i rozliczanie czasu stanów
+
+// Szacowany pobór prądu modułu w poszczególnych stanach [mA]. Wartości
+// szacunkowe (dane katalogowe ESP32-C3), niezmierzone na tym sprzęcie.
+#define PM_CURRENT_SEQUENCING_MA 28
+#define PM_CURRENT_PLAYING_MA 16
+#define PM_CURRENT_AP_CLIENTS_MA 95
+#define PM_CURRENT_AP_IDLE_MA 85
+#define PM_CURRENT_UART_MA 28
+#define PM_CURRENT_IDLE_MA 16        // bez esp_pm: pełny zegar, bez uśpienia
+// Bezczynność z light sleep (~0.15 mA układu) przerywanym oknem próbkowania
+// audio średnio co 20 ms (SensorManager, AUDIO_IDLE_POLL_US)
+#define PM_CURRENT_IDLE_ADC_MA 3     // okno monitora ADC 2 ms (ADC + DMA ~20 mA) - ~10% czasu
+#define PM_CURRENT_IDLE_POLL_MA 1    // pojedyncza próbka oneshot, wybudzenie ~0.3 ms
+
+enum PowerState {
+  POWER_SEQUENCING,    // przekaźniki w trakcie sekwencji - pełny zegar
+  POWER_AP_CLIENTS,    // AP z podłączonymi klientami - pełny zegar
+  POWER_UART,          // aktywna konsola UART - pełny zegar
+  POWER_AP_IDLE,       // AP bez klientów - zegarem zarządza sterownik WiFi
+  POWER_PLAYING,       // przekaźniki załączone - DFS, bez light sleep
+  POWER_IDLE,          // wszystko wyłączone - DFS + light sleep
+  POWER_STATE_COUNT
+};
+
+// Zarządzanie energią na esp_pm: dynamiczna zmiana częstotliwości (DFS)
+// i automatyczny light sleep. Blokady wydajności (CPU_FREQ_MAX +
+// NO_LIGHT_SLEEP) trzymane są tylko podczas sekwencji przekaźników, przy
+// klientach AP i aktywnym UART. Przy załączonych przekaźnikach trzymana jest
+// sama NO_LIGHT_SLEEP - w light sleep zatrzymuje się PWM wentylatora.
+// Źródła wybudzenia: przycisk (GPIO) i okresowy esp_timer.
+//
+// W bezczynności pętla czeka na audio. Próbkowanie wejścia odbywa się w
+// krótkich oknach z jednorazowego esp_timer - monitor ADC w trybie ciągłym
+// (AUDIO_IDLE_USE_MONITOR) trzyma blokadę esp_pm sterownika ADC tylko w
+// oknie, między oknami light sleep jest dozwolony. Poza bezczynnością ten
+// sam strumień ADC (BatteryGuard) trzyma ją stale - DFS nie schodzi do XTAL.
+// PWM (LED, wentylatory, ekonomizer cewek) taktowany jest z XTAL, żeby DFS nie
+// zmieniał jego częstotliwości (selectPwmClock() przed pierwszym ledcAttach()).
+//
+// Bez CONFIG_PM_ENABLE w sdkconfig blokady nie są tworzone, a moduł tylko
+// rozlicza czas w stanach i szacowany pobór prądu.
+class PowerManager {
+private:
+  RelayController* relayControllers;    // ZONE_COUNT stref
+  SubwooferWebServer* webServer;
+  UartManager* uartManager;
+  ButtonManager* buttonManager;
+  ConsoleLogger* logger;
+  esp_timer_handle_t tickTimer;
+  portMUX_TYPE residencyMux;
+  bool pmEnabled;
+  bool lightSleepEnabled;
+  bool performanceLocked;
+  bool sleepLocked;
+  static bool pwmClockXtal;
+#ifdef CONFIG_PM_ENABLE
+  esp_pm_lock_handle_t cpuLock;
+  esp_pm_lock_handle_t sleepLock;
+#endif
+
+  volatile PowerState state;
+  int64_t stateSince;                      // us, początek rozliczanego odcinka
+  int64_t residencyUs[POWER_STATE_COUNT];
+  uint32_t transitions;
+
+  static void handleTick(void* arg);
+  void accountResidency(int64_t now);
+  void readResidency(int64_t* out);
+  PowerState evaluateState();
+  void applyLocks(PowerState newState);
+
+public:
+  PowerManager();
+  static void selectPwmClock(ConsoleLogger* logger);
+  void init(RelayController* relayControllers, SubwooferWebServer* webServer, UartManager* uartManager, ButtonManager* buttonManager, ConsoleLogger* logger);
+  void update();
+  PowerState getState() { return state; }
+  static const char* getStateName(PowerState state);
+  static uint16_t getStateCurrentMa(PowerState state, bool sleepEnabled);
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
+};
+
+#endif
@@ -1,102 +1,395 @@
 #include "RelayController.h"
 
 RelayController::RelayController() : 
-  currentSequence(SEQUENCE_IDLE),
-  sequenceStartTime(0),
-  relaysActive(false) {
+  zone(0),
+  config(nullptr),
+  logger(nullptr),
+  sequencer(this),
+  sequenceTimer(NULL),
+  sequenceMux(portMUX_INITIALIZER_UNLOCKED),
+  resumeCount(0),
+  fastShutdownDone(false),
+  preArmCount(0),
+  preArmConfirmed(0),
+  totalGapSavedMs(0),
+  holdTimer(NULL),
+  brownout(false),
+  repullCount(0),
+  sessionSavedNj(0),
+  lastSessionSavedJ(0),
+  totalSavedJ(0) {
+  memset(outputPins, 0, sizeof(outputPins));
+  memset(onLevel, HIGH, sizeof(onLevel));
+  memset(holdPwm, 0, sizeof(holdPwm));
+  memset(energized, 0, sizeof(energized));
+  memset(holdDue, 0, sizeof(holdDue));
+  memset(holdStart, 0, sizeof(holdStart));
+  memset(holdSavedMw, 0, sizeof(holdSavedMw));
 }
 
-void RelayController::init(int zasilaniePin, int glosnikPin, ConfigManager* config, ConsoleLogger* logger) {
-  this->zasilaniePin = zasilaniePin;
-  this->glosnikPin = glosnikPin;
+// pins indeksowane RelayOutput, zone wybiera blok konfiguracji (delayRelaySwitch)
+void RelayController::init(const int* pins, int zone, ConfigManager* config, ConsoleLogger* logger) {
+  this->zone = zone;
   this->config = config;
   this->logger = logger;
+
+  // Stan spoczynkowy wyjścia to odwrotność poziomu z jego kroku startowego
+  for (uint8_t i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    outputPins[i] = pins[i];
+  }
+  for (uint8_t i = 0; i < RELAY_STEP_COUNT; i++) {
+    onLevel[RELAY_STARTUP_STEPS[i].output] = RELAY_STARTUP_STEPS[i].level;
+  }
+  for (uint8_t i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    if (config->getRelayHoldPct(i) < 100) {
+      holdPwm[i] = ledcAttach(outputPins[i], RELAY_HOLD_PWM_FREQ, RELAY_HOLD_PWM_BITS);
+      if (!holdPwm[i]) {
+        logger->addLog("RELAY", "warning", "Strefa %d, wyjście %u: brak kanału LEDC - bez ekonomizera", zone, i);
+      }
+    }
+    if (holdPwm[i]) {
+      writeDuty(i, 0);
+    } else {
+      pinMode(outputPins[i], OUTPUT);
+      digitalWrite(outputPins[i], !onLevel[i]);
+    }
+  }
+
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = &RelayController::handleTimer;
+  timerArgs.arg = this;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "relay_seq";
+  esp_timer_create(&timerArgs, &sequenceTimer);
+
+  timerArgs.callback = &RelayController::handleHoldTimer;
+  timerArgs.name = "relay_hold";
+  esp_timer_create(&timerArgs, &holdTimer);
+}
+
+unsigned long RelayController::getConfigDelayMs() {
+  return config->getDelayRelaySwitch(zone);
+}
+
+unsigned long RelayController::getPreArmMs() {
+  return config->getPreArmMs();
+}
+
+void RelayController::applyStep(uint8_t index, bool forward, int64_t now) {
+  writeOutput(RELAY_STARTUP_STEPS[index].output, forward, now);
+}
+
+void RelayController::scheduleAt(int64_t due, int64_t now) {
+  esp_timer_stop(sequenceTimer);
+  esp_timer_start_once(sequenceTimer, (uint64_t)(due - now));
+}
+
+void RelayController::cancelSchedule() {
+  esp_timer_stop(sequenceTimer);
+}
+
+// Wywoływane pod sequenceMux
+void RelayController::writeOutput(uint8_t output, bool on, int64_t now) {
+  energized[output] = on;
+  if (!holdPwm[output]) {
+    digitalWrite(outputPins[output], on ? onLevel[output] : !onLevel[output]);
+    return;
+  }
+
+  if (holdStart[output] != 0) endHold(output, now);
+  holdDue[output] = 0;
+  writeDuty(output, on ? 100 : 0);
+  if (on && !brownout && config->getRelayHoldPct(output) < 100) {
+    holdDue[output] = now + (int64_t)config->getRelayPullInMs(output) * 1000;
+    scheduleHold(now);
+  }
+}
+
+// pct to wysterowanie cewki - dla wyjścia aktywnego stanem niskim odwrócone
+void RelayController::writeDuty(uint8_t output, int pct) {
+  const uint32_t maxDuty = (1 << RELAY_HOLD_PWM_BITS) - 1;
+  uint32_t duty = maxDuty * pct / 100;
+  ledcWrite(outputPins[output], onLevel[output] == HIGH ? duty : maxDuty - duty);
+}
+
+void RelayController::scheduleHold(int64_t now) {
+  int64_t earliest = 0;
+  for (uint8_t i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    if (holdDue[i] != 0 && (earliest == 0 || holdDue[i] < earliest)) earliest = holdDue[i];
+  }
+  esp_timer_stop(holdTimer);
+  if (earliest != 0) {
+    esp_timer_start_once(holdTimer, (uint64_t)max(earliest - now, (int64_t)1));
+  }
+}
+
+// Rozliczenie czasu podtrzymania - oszczędność względem pełnego wysterowania
+void RelayController::endHold(uint8_t output, int64_t now) {
+  sessionSavedNj += (uint64_t)holdSavedMw[output] * (uint64_t)(now - holdStart[output]);
+  holdStart[output] = 0;
+}
+
+// Koniec pull-in - przejście na wypełnienie podtrzymania
+void RelayController::handleHoldTimer(void* arg) {
+  RelayController* self = (RelayController*)arg;
+  int64_t now = esp_timer_get_time();
+
+  portENTER_CRITICAL(&self->sequenceMux);
+  for (uint8_t i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    if (self->holdDue[i] == 0 || now < self->holdDue[i]) continue;
+    self->holdDue[i] = 0;
+    if (!self->energized[i] || self->brownout) continue;
+    int pct = self->config->getRelayHoldPct(i);
+    self->writeDuty(i, pct);
+    self->holdStart[i] = now;
+    self->holdSavedMw[i] = (uint16_t)((uint32_t)RELAY_COIL_MW * (10000 - pct * pct) / 10000);
+  }
+  self->scheduleHold(now);
+  portEXIT_CRITICAL(&self->sequenceMux);
+}
+
+// Spadek napięcia: cewki w podtrzymaniu wracają do pełnego wysterowania
+// (ponowne przyciągnięcie, gdyby kotwica odpadła), po powrocie napięcia
+// podtrzymanie włącza się znów po czasie pull-in. Wywoływane z esp_timer.
+void RelayController::setBrownout(bool low) {
+  portENTER_CRITICAL(&sequenceMux);
+  if (low != brownout) {
+    brownout = low;
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+      if (!holdPwm[i] || !energized[i]) continue;
+      if (low) {
+        if (holdStart[i] != 0) {
+          endHold(i, now);
+          writeDuty(i, 100);
+          repullCount++;
+        }
+        holdDue[i] = 0;
+      } else if (config->getRelayHoldPct(i) < 100) {
+        holdDue[i] = now + (int64_t)config->getRelayPullInMs(i) * 1000;
+      }
+    }
+    scheduleHold(now);
+  }
+  portEXIT_CRITICAL(&sequenceMux);
+}
+
+// Oszczędność bieżącej sesji razem z trwającym podtrzymaniem [J]
+float RelayController::getSessionSavedJ() {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&sequenceMux);
+  uint64_t savedNj = sessionSavedNj;
+  for (uint8_t i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    if (holdStart[i] != 0) savedNj += (uint64_t)holdSavedMw[i] * (uint64_t)(now - holdStart[i]);
+  }
+  portEXIT_CRITICAL(&sequenceMux);
+  return savedNj / 1e9f;
+}
+
+// Sesja kończy się powrotem wszystkich wyjść do stanu spoczynkowego
+void RelayController::closeSession(bool log) {
+  portENTER_CRITICAL(&sequenceMux);
+  uint64_t savedNj = sessionSavedNj;
+  sessionSavedNj = 0;
+  portEXIT_CRITICAL(&sequenceMux);
+
+  if (savedNj == 0) return;
+  lastSessionSavedJ = savedNj / 1e9f;
+  totalSavedJ += lastSessionSavedJ;
+  if (log) {
+    logger->addLog("RELAY", "info", "Ekonomizer strefy %d: oszczędzono %.0f J (%.2f Wh)", zone,
+                   lastSessionSavedJ, lastSessionSavedJ / 3600.0f);
+  }
+}
+
+// Wyprzedzające włączenie - kroki przed pierwszym STEP_CONFIRMED
+bool RelayController::preArm() {
+  portENTER_CRITICAL(&sequenceMux);
+  bool armed = sequencer.preArm(esp_timer_get_time());
+  portEXIT_CRITICAL(&sequenceMux);
+
+  if (armed) preArmCount++;
+  return armed;
 }
 
 void RelayController::startupSequence() {
-  if (currentSequence == SEQUENCE_IDLE) {
-    logger->addLog("STARTUP", "info", "Włączanie przetwornicy...");
+  portENTER_CRITICAL(&sequenceMux);
+  SequencerMode previous = sequencer.getMode();
+  uint8_t resumeFrom = sequencer.getPosition();
+  bool started = sequencer.start(esp_timer_get_time());
+  portEXIT_CRITICAL(&sequenceMux);
+  if (!started) return;
+
+  if (previous == SEQUENCER_PREARM) {
+    preArmConfirmed++;
+    totalGapSavedMs += sequencer.getLastGapSavedMs();
+    logger->addLog("STARTUP", "info", "Detekcja potwierdzona - dalsze kroki za %lu ms (zysk %lu ms)",
+                   sequencer.getLastRemainingMs(), (unsigned long)sequencer.getLastGapSavedMs());
+  } else if (previous == SEQUENCER_SHUTDOWN) {
+    resumeCount++;
+    logger->addLog("STARTUP", "info", "Wznowienie sekwencji uruchamiania od kroku %u/%u",
+                   resumeFrom, RELAY_STEP_COUNT);
+  } else {
+    unsigned long totalMs = 0;
+    for (uint8_t i = 1; i < RELAY_STEP_COUNT; i++) totalMs += sequencer.stepDelayMs(i);
+    logger->addLog("STARTUP", "info", "Włączanie przekaźników strefy %d (%u kroków, %lu ms)...", zone, RELAY_STEP_COUNT, totalMs);
     Serial.print("Startup: Włączanie przetwornicy, a po ");
-    Serial.print(config->getDelayRelaySwitch() / 1000);
+    Serial.print(config->getDelayRelaySwitch(zone) / 1000);
     Serial.println("s głośnika.");
-    digitalWrite(zasilaniePin, HIGH);
-    currentSequence = SEQUENCE_STARTUP_POWER;
-    sequenceStartTime = millis();
   }
 }
 
 void RelayController::shutdownSequence() {
-  if ((currentSequence == SEQUENCE_IDLE && relaysActive) || currentSequence == SEQUENCE_STARTUP_POWER) {
-    logger->addLog("SHUTDOWN", "info", "Rozpoczęcie sekwencji wyłączania...");
+  SequencerMode mode = sequencer.getMode();
+  uint8_t position = sequencer.getPosition();
+  if (mode == SEQUENCER_PREARM) {
+    logger->addLog("SHUTDOWN", "info", "Przerwanie pre-arm - cofanie %u kroków", position);
+    beginShutdown();
+  } else if (position > 0 && mode != SEQUENCER_SHUTDOWN) {
+    logger->addLog("SHUTDOWN", "info", "Rozpoczęcie sekwencji wyłączania strefy %d (od kroku %u/%u)...", zone, position, RELAY_STEP_COUNT);
     Serial.print("Shutdown: Wyłączanie głośnika, a po ");
-    Serial.print(config->getDelayRelaySwitch() / 1000);
+    Serial.print(config->getDelayRelaySwitch(zone) / 1000);
     Serial.println("s przetwornicy.");
-    
-    // Jeśli byliśmy w trakcie uruchamiania, wyłącz głośnik jeśli był włączony
-    if (relaysActive) {
-      digitalWrite(glosnikPin, LOW);
-    }
-    
-    currentSequence = SEQUENCE_SHUTDOWN_SPEAKER;
-    sequenceStartTime = millis();
+
+    beginShutdown();
+  }
+}
+
+// Wyłączenie z kontekstu timera (np. zanik napięcia) - bez logowania,
+// wpis do logu dodaje handleSequences()
+bool RelayController::fastShutdown() {
+  if (beginShutdown()) {
+    fastShutdownDone = true;
+    return true;
   }
+  return false;
+}
+
+// Cofa wykonane kroki od bieżącej pozycji - także przerwany start i pre-arm
+bool RelayController::beginShutdown() {
+  portENTER_CRITICAL(&sequenceMux);
+  bool started = sequencer.shutdown(esp_timer_get_time());
+  portEXIT_CRITICAL(&sequenceMux);
+  return started;
+}
+
+// Callback esp_timer - kolejny krok sekwencji w zaplanowanym momencie
+void RelayController::handleTimer(void* arg) {
+  RelayController* self = (RelayController*)arg;
+  int64_t now = esp_timer_get_time();
+
+  portENTER_CRITICAL(&self->sequenceMux);
+  self->sequencer.timerExpired(now);
+  portEXIT_CRITICAL(&self->sequenceMux);
 }
 
 void RelayController::handleSequences() {
-  if (currentSequence == SEQUENCE_IDLE) {
-    return;
+  if (fastShutdownDone) {
+    fastShutdownDone = false;
+    logger->addLog("SHUTDOWN", "warning", "Szybkie wyłączenie głośnika z kontekstu timera");
   }
-  
-  unsigned long currentTime = millis();
-  unsigned long elapsedTime = currentTime - sequenceStartTime;
-  
-  switch (currentSequence) {
-    case SEQUENCE_STARTUP_POWER:
-      if (elapsedTime >= config->getDelayRelaySwitch()) {
-        digitalWrite(glosnikPin, HIGH);
-        relaysActive = true;
-        logger->addLog("STARTUP", "success", "Sekwencja uruchomienia zakończona - system aktywny");
-        currentSequence = SEQUENCE_IDLE;
-      }
-      break;
-      
-    case SEQUENCE_SHUTDOWN_SPEAKER:
-      if (elapsedTime >= config->getDelayRelaySwitch()) {
-        digitalWrite(zasilaniePin, LOW);
-        relaysActive = false;
-        logger->addLog("SHUTDOWN", "success", "System wyłączony - przekaźniki nieaktywne");
-        currentSequence = SEQUENCE_IDLE;
-      }
-      break;
-      
-    default:
-      currentSequence = SEQUENCE_IDLE;
-      break;
-  }
-}
-
-String RelayController::getStatusText() {
-  switch (currentSequence) {
-    case SEQUENCE_STARTUP_POWER:
-      return "STARTING";
-    case SEQUENCE_SHUTDOWN_SPEAKER:
-      return "STOPPING";
-    case SEQUENCE_IDLE:
-      return relaysActive ? "ACTIVE" : "OFF";
-    default:
-      return "OFF";
-  }
-}
-
-String RelayController::getStatusClass() {
-  switch (currentSequence) {
-    case SEQUENCE_STARTUP_POWER:
-      return "value-info";
-    case SEQUENCE_SHUTDOWN_SPEAKER:
-      return "value-warning";
-    case SEQUENCE_IDLE:
-      return relaysActive ? "value-success" : "value-warning";
-    default:
-      return "value-warning";
+  portENTER_CRITICAL(&sequenceMux);
+  bool startupCompleted = sequencer.takeStartupCompleted();
+  bool shutdownCompleted = sequencer.takeShutdownCompleted();
+  bool preArmExpired = sequencer.takePreArmExpired();
+  portEXIT_CRITICAL(&sequenceMux);
+
+  if (startupCompleted) {
+    logger->addLog("STARTUP", "success", "Sekwencja uruchomienia zakończona - strefa %d aktywna", zone);
+  }
+  if (shutdownCompleted) {
+    logger->addLog("SHUTDOWN", "success", "Strefa %d wyłączona - przekaźniki nieaktywne", zone);
+    closeSession(true);
+  }
+  if (preArmExpired) {
+    logger->addLog("STARTUP", "info", "Brak potwierdzenia audio - przetwornica wyłączona");
+    closeSession(false);
+  }
+}
+
+// Teksty i klasy CSS statusu indeksowane trybem sekwencera
+static const char* const statusTexts[] = { "OFF", "STARTING", "STOPPING", "ARMING" };
+static const char* const statusClasses[] = { "value-warning", "value-info", "value-warning", "value-info" };
+
+const char* RelayController::getStatusText() {
+  SequencerMode mode = sequencer.getMode();
+  if (mode == SEQUENCER_IDLE && sequencer.isRelaysActive()) return "ACTIVE";
+  return statusTexts[mode];
+}
+
+const char* RelayController::getStatusClass() {
+  SequencerMode mode = sequencer.getMode();
+  if (mode == SEQUENCER_IDLE && sequencer.isRelaysActive()) return "value-success";
+  return statusClasses[mode];
+}
+
+void RelayController::addDiagnostics(JsonObject diag) {
+  uint8_t position = sequencer.getPosition();
+  diag["zone"] = zone;
+  diag["position"] = position;
+  diag["steps"] = RELAY_STEP_COUNT;
+  uint8_t levels[RELAY_OUTPUT_COUNT] = {};
+  for (uint8_t i = 0; i < RELAY_STEP_COUNT; i++) {
+    const RelayStep& step = RELAY_STARTUP_STEPS[i];
+    levels[step.output] = i < position ? step.level : !step.level;
+  }
+  JsonArray outputs = diag.createNestedArray("outputs");
+  for (uint8_t i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    outputs.add(levels[i]);
+  }
+  diag["switchCount"] = sequencer.getSwitchCount();
+  diag["resumes"] = resumeCount;
+  diag["lastJitterUs"] = sequencer.getLastJitterUs();
+  diag["maxJitterUs"] = sequencer.getMaxJitterUs();
+  diag["lastStartupGapUs"] = sequencer.getStartupGapUs();
+  diag["lastShutdownGapUs"] = sequencer.getShutdownGapUs();
+  diag["preArms"] = preArmCount;
+  diag["preArmConfirmed"] = preArmConfirmed;
+  diag["preArmFalse"] = sequencer.getPreArmFalse();
+  diag["lastGapSavedMs"] = sequencer.getLastGapSavedMs();
+  diag["avgGapSavedMs"] = preArmConfirmed > 0 ? (uint32_t)(totalGapSavedMs / preArmConfirmed) : 0;
+
+  JsonObject economizer = diag.createNestedObject("economizer");
+  JsonArray hold = economizer.createNestedArray("outputs");
+  for (uint8_t i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    JsonObject entry = hold.createNestedObject();
+    entry["pwm"] = holdPwm[i];
+    entry["pullInMs"] = config->getRelayPullInMs(i);
+    entry["holdPct"] = config->getRelayHoldPct(i);
+    entry["holding"] = holdStart[i] != 0;
+  }
+  economizer["brownout"] = (bool)brownout;
+  economizer["repulls"] = repullCount;
+  economizer["sessionSavedJ"] = getSessionSavedJ();
+  economizer["lastSessionSavedJ"] = lastSessionSavedJ;
+  economizer["totalSavedJ"] = totalSavedJ;
+}
+
+void RelayController::printDiagnostics(Stream* out) {
+  out->println();
+  out->println("PRZEKAŹNIKI:");
+  out->printf("  sekwencja:             krok %u/%u (%s), wznowień %lu\n", sequencer.getPosition(), RELAY_STEP_COUNT,
+              getStatusText(), (unsigned long)resumeCount);
+  out->printf("  przełączeń:            %lu\n", (unsigned long)sequencer.getSwitchCount());
+  out->printf("  jitter ostatni/max:    %ld / %ld us\n", (long)sequencer.getLastJitterUs(), (long)sequencer.getMaxJitterUs());
+  if (sequencer.getStartupGapUs() > 0) {
+    out->printf("  start (pierwszy->ost): %lld us\n", sequencer.getStartupGapUs());
+  }
+  if (sequencer.getShutdownGapUs() > 0) {
+    out->printf("  stop (pierwszy->ost):  %lld us\n", sequencer.getShutdownGapUs());
+  }
+  out->printf("  pre-arm:               %lu (potwierdzone %lu, fałszywe %lu)\n", (unsigned long)preArmCount,
+              (unsigned long)preArmConfirmed, (unsigned long)sequencer.getPreArmFalse());
+  if (preArmConfirmed > 0) {
+    out->printf("  skrócenie startu:      ostatnio %lu ms, średnio %lu ms\n", (unsigned long)sequencer.getLastGapSavedMs(),
+                (unsigned long)(totalGapSavedMs / preArmConfirmed));
+  }
+  for (uint8_t i = 0; i < RELAY_OUTPUT_COUNT; i++) {
+    out->printf("  ekonomizer wyjścia %u:  %s, pull-in %u ms, podtrzymanie %d%%%s\n", i,
+                holdPwm[i] ? "PWM" : "statyczny", config->getRelayPullInMs(i), config->getRelayHoldPct(i),
+                holdStart[i] != 0 ? " (aktywne)" : "");
   }
+  out->printf("  ponowne przyciągnięcia: %lu%s\n", (unsigned long)repullCount, brownout ? " (spadek napięcia)" : "");
+  out->printf("  oszczędność cewek:     sesja %.0f J, ostatnia %.0f J, razem %.2f Wh\n", getSessionSavedJ(),
+              lastSessionSavedJ, totalSavedJ / 3600.0f);
 }
@@ -2,40 +2,118 @@
 #define RELAY_CONTROLLER_H
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
 #include "ConfigManager.h"
 #include "ConsoleLogger.h"
+#include "RelaySequence.h"
+#include "RelaySequencer.h"
 
-// Stany sekwencji nieblokujących
-enum SequenceState {
-  SEQUENCE_IDLE,
-  SEQUENCE_STARTUP_POWER,
-  SEQUENCE_STARTUP_SPEAKER,
-  SEQUENCE_SHUTDOWN_SPEAKER,
-  SEQUENCE_SHUTDOWN_POWER
-};
+// Ekonomizer cewek: po czasie pull-in wyjście przechodzi na PWM podtrzymania.
+// 25 kHz - ten sam timer LEDC co wentylatory, bez pisku cewki.
+#ifndef RELAY_HOLD_PWM_FREQ
+#define RELAY_HOLD_PWM_FREQ 25000
+#endif
+#define RELAY_HOLD_PWM_BITS 8
+#ifndef RELAY_COIL_MW
+#define RELAY_COIL_MW 360           // moc cewki przy pełnym wysterowaniu (12 V, 30 mA)
+#endif
 
-class RelayController {
+// Sekwencer przekaźników sterowany tablicą kroków z RelaySequence.h.
+// Logika czasowa (kolejność kroków, opóźnienia, przerwanie i wznowienie)
+// jest w RelaySequencer - tu piny, esp_timer, logi i ekonomizer.
+//
+// Kroki wykonywane są w callbacku jednorazowego esp_timer, więc odstępy nie
+// zależą od czasu trwania loop(). handleSequences() jedynie loguje zakończone
+// sekwencje.
+//
+// preArm() wykonuje kroki przed pierwszym STEP_CONFIRMED (przetwornica), gdy
+// obwiednia audio zaczyna rosnąć. Potwierdzona detekcja (startupSequence())
+// kończy sekwencję, a brak potwierdzenia w czasie preArmMs ją cofa.
+//
+// Ekonomizer: wyjście z holdPct < 100 podpinane jest do LEDC. Po załączeniu
+// cewka dostaje pełne napięcie przez pullInMs, potem wypełnienie holdPct
+// (prąd cewki z diodą gasikową ~ wypełnienie, pobór ~ wypełnienie^2).
+// setBrownout() z BatteryGuard przy spadku napięcia wraca do pełnego
+// wysterowania, a po powrocie napięcia ponownie odlicza pull-in. Bez wolnego
+// kanału LEDC wyjście pracuje statycznie jak dotąd.
+class RelayController : public RelaySequencerOutput {
 private:
-  int zasilaniePin;
-  int glosnikPin;
+  int outputPins[RELAY_OUTPUT_COUNT];
+  int zone;
   ConfigManager* config;
   ConsoleLogger* logger;
-  SequenceState currentSequence;
-  unsigned long sequenceStartTime;
-  bool relaysActive;
+  RelaySequencer sequencer;     // czas w us z esp_timer_get_time()
+  esp_timer_handle_t sequenceTimer;
+  portMUX_TYPE sequenceMux;
+  uint32_t resumeCount;
+  volatile bool fastShutdownDone;
+
+  // Wstępne włączenie przetwornicy
+  uint32_t preArmCount;
+  uint32_t preArmConfirmed;
+  uint64_t totalGapSavedMs;
+
+  // Ekonomizer cewek
+  uint8_t onLevel[RELAY_OUTPUT_COUNT];    // poziom załączenia z kroku startowego
+  bool holdPwm[RELAY_OUTPUT_COUNT];       // wyjście podpięte do LEDC
+  bool energized[RELAY_OUTPUT_COUNT];
+  int64_t holdDue[RELAY_OUTPUT_COUNT];    // us, 0 = brak oczekującego podtrzymania
+  int64_t holdStart[RELAY_OUTPUT_COUNT];  // us, 0 = pełne wysterowanie
+  uint16_t holdSavedMw[RELAY_OUTPUT_COUNT];
+  esp_timer_handle_t holdTimer;
+  volatile bool brownout;
+  volatile uint32_t repullCount;
+  uint64_t sessionSavedNj;                // mW * us, bieżąca sesja
+  float lastSessionSavedJ;
+  float totalSavedJ;
+
+  static void handleTimer(void* arg);
+  bool beginShutdown();
+
+  // RelaySequencerOutput - wywoływane pod sequenceMux
+  void applyStep(uint8_t index, bool forward, int64_t now) override;
+  void scheduleAt(int64_t due, int64_t now) override;
+  void cancelSchedule() override;
+  unsigned long getConfigDelayMs() override;
+  unsigned long getPreArmMs() override;
+
+  static void handleHoldTimer(void* arg);
+  void writeOutput(uint8_t output, bool on, int64_t now);
+  void writeDuty(uint8_t output, int pct);
+  void scheduleHold(int64_t now);
+  void endHold(uint8_t output, int64_t now);
+  void closeSession(bool log);
 
 public:
   RelayController();
-  void init(int zasilaniePin, int glosnikPin, ConfigManager* config, ConsoleLogger* logger);
+  void init(const int* pins, int zone, ConfigManager* config, ConsoleLogger* logger);
+  bool preArm();
   void startupSequence();
   void shutdownSequence();
+  bool fastShutdown();
   void handleSequences();
-  bool isActive() { return relaysActive || currentSequence == SEQUENCE_STARTUP_POWER; }
-  bool isIdle() { return currentSequence == SEQUENCE_IDLE; }
-  bool isStarting() { return currentSequence == SEQUENCE_STARTUP_POWER; }
-  bool isStopping() { return currentSequence == SEQUENCE_SHUTDOWN_SPEAKER; }
-  String getStatusText();
-  String getStatusClass();
+  void setBrownout(bool low);
+  float getSessionSavedJ();
+  bool isActive() { return sequencer.isRelaysActive() || sequencer.getMode() == SEQUENCER_STARTUP; }
+  bool isIdle() { return sequencer.getMode() == SEQUENCER_IDLE; }
+  bool isPreArmed() { return sequencer.getMode() == SEQUENCER_PREARM; }
+  bool canStart() {
+    SequencerMode mode = sequencer.getMode();
+    return mode == SEQUENCER_PREARM || mode == SEQUENCER_SHUTDOWN || (mode == SEQUENCER_IDLE && !sequencer.isRelaysActive());
+  }
+  bool isStarting() { return sequencer.getMode() == SEQUENCER_STARTUP; }
+  bool isStopping() { return sequencer.getMode() == SEQUENCER_SHUTDOWN; }
+  uint8_t getPosition() { return sequencer.getPosition(); }
+  int getZone() { return zone; }
+  const char* getStatusText();
+  const char* getStatusClass();
+
+  int32_t getLastJitterUs() { return sequencer.getLastJitterUs(); }
+  int32_t getMaxJitterUs() { return sequencer.getMaxJitterUs(); }
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
 };
 
 #endif
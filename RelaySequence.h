@@ -0,0 +1,88 @@
+#ifndef RELAY_SEQUENCE_H
+#define RELAY_SEQUENCE_H
+
+#include <Arduino.h>
+
+// Wyjścia sterowane przez sekwencer - indeksy w tablicy pinów RelayController::init()
+enum RelayOutput : uint8_t {
+  RELAY_OUT_POWER,      // przetwornica
+  RELAY_OUT_SPEAKER,    // głośnik
+  RELAY_OUTPUT_COUNT
+};
+
+enum RelayStepCondition : uint8_t {
+  STEP_ALWAYS,          // wykonywany także w pre-arm
+  STEP_CONFIRMED        // wymaga potwierdzonej detekcji - tu zatrzymuje się pre-arm
+};
+
+#define RELAY_DELAY_CONFIG 0xFFFF        // opóźnienie = delayRelaySwitch z konfiguracji
+#define RELAY_STEP_MAX_DELAY_MS 10000
+
+// Krok sekwencji: po delayMs od poprzedniego kroku ustaw wyjście na level.
+struct RelayStep {
+  uint8_t output;
+  uint8_t level;
+  uint16_t delayMs;
+  uint8_t condition;
+};
+
+// Sekwencja uruchamiania. Wyłączanie to ta sama tablica od końca z odwróconymi
+// poziomami - krok j cofany jest po opóźnieniu kroku j+1, więc odstępy przy
+// wyłączaniu są lustrzanym odbiciem startu. Przerwanie w połowie cofa tylko
+// wykonane kroki, ponowny start wznawia od bieżącej pozycji.
+static constexpr RelayStep RELAY_STARTUP_STEPS[] = {
+  { RELAY_OUT_POWER,   HIGH, 0,                  STEP_ALWAYS },
+  { RELAY_OUT_SPEAKER, HIGH, RELAY_DELAY_CONFIG, STEP_CONFIRMED },
+};
+
+static constexpr uint8_t RELAY_STEP_COUNT = sizeof(RELAY_STARTUP_STEPS) / sizeof(RELAY_STARTUP_STEPS[0]);
+
+// Walidacja tablicy w czasie kompilacji
+constexpr bool relayStepsValid(const RelayStep* steps, uint8_t count) {
+  if (count == 0 || steps[0].delayMs != 0) return false;  // pierwszy krok od razu
+  for (uint8_t i = 0; i < count; i++) {
+    if (steps[i].output >= RELAY_OUTPUT_COUNT) return false;
+    if (steps[i].level != HIGH && steps[i].level != LOW) return false;
+    if (steps[i].delayMs != RELAY_DELAY_CONFIG && steps[i].delayMs > RELAY_STEP_MAX_DELAY_MS) return false;
+  }
+  return true;
+}
+
+// Każde wyjście przełączane dokładnie raz - odwrócenie przywraca stan spoczynkowy
+constexpr bool relayOutputsSwitchedOnce(const RelayStep* steps, uint8_t count) {
+  for (uint8_t output = 0; output < RELAY_OUTPUT_COUNT; output++) {
+    uint8_t uses = 0;
+    for (uint8_t i = 0; i < count; i++) {
+      if (steps[i].output == output) uses++;
+    }
+    if (uses != 1) return false;
+  }
+  return true;
+}
+
+// Kroki wymagające potwierdzenia muszą tworzyć ciągły koniec tablicy
+constexpr uint8_t relayPreArmStop(const RelayStep* steps, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (steps[i].condition == STEP_CONFIRMED) return i;
+  }
+  return count;
+}
+
+constexpr bool relayConfirmedSuffix(const RelayStep* steps, uint8_t count) {
+  for (uint8_t i = relayPreArmStop(steps, count); i < count; i++) {
+    if (steps[i].condition != STEP_CONFIRMED) return false;
+  }
+  return true;
+}
+
+static constexpr uint8_t RELAY_PREARM_STOP = relayPreArmStop(RELAY_STARTUP_STEPS, RELAY_STEP_COUNT);
+
+static_assert(relayStepsValid(RELAY_STARTUP_STEPS, RELAY_STEP_COUNT),
+              "Sekwencja: pierwszy krok bez opóźnienia, wyjścia i opóźnienia w zakresie");
+static_assert(relayOutputsSwitchedOnce(RELAY_STARTUP_STEPS, RELAY_STEP_COUNT),
+              "Sekwencja: każde wyjście przełączane dokładnie raz");
+static_assert(relayConfirmedSuffix(RELAY_STARTUP_STEPS, RELAY_STEP_COUNT),
+              "Sekwencja: kroki STEP_CONFIRMED muszą być na końcu tablicy");
+static_assert(RELAY_PREARM_STOP > 0, "Sekwencja: pre-arm musi włączyć co najmniej jedno wyjście");
+
+#endif
@@ -0,0 +1,158 @@
+#include "RelaySequencer.h"
+#include <string.h>
+#include <stdlib.h>
+
+RelaySequencer::RelaySequencer(RelaySequencerOutput* output, const RelayStep* steps, uint8_t stepCount) :
+  output(output),
+  steps(steps),
+  stepCount(stepCount),
+  preArmStop(relayPreArmStop(steps, stepCount)),
+  mode(SEQUENCER_IDLE),
+  position(0),
+  relaysActive(false),
+  lastUndoTime(0),
+  preArmStartTime(0),
+  scheduledSwitchTime(0),
+  switchScheduled(false),
+  startupBeginTime(0),
+  startupEndTime(0),
+  shutdownBeginTime(0),
+  shutdownEndTime(0),
+  lastJitterUs(0),
+  maxJitterUs(0),
+  switchCount(0),
+  lastGapSavedMs(0),
+  lastRemainingMs(0),
+  preArmFalse(0),
+  startupCompleted(false),
+  shutdownCompleted(false),
+  preArmExpired(false) {
+  memset(stepTime, 0, sizeof(stepTime));
+}
+
+unsigned long RelaySequencer::stepDelayMs(uint8_t index) {
+  if (index >= stepCount) return 0;
+  uint16_t delayMs = steps[index].delayMs;
+  return delayMs == RELAY_DELAY_CONFIG ? output->getConfigDelayMs() : delayMs;
+}
+
+void RelaySequencer::scheduleAt(int64_t due, int64_t now) {
+  scheduledSwitchTime = due;
+  switchScheduled = true;
+  output->scheduleAt(due, now);
+}
+
+void RelaySequencer::recordSwitch(int64_t now) {
+  lastJitterUs = (int32_t)(now - scheduledSwitchTime);
+  if (abs(lastJitterUs) > abs(maxJitterUs)) maxJitterUs = lastJitterUs;
+  switchCount++;
+}
+
+// Wykonuje wszystkie należne kroki w bieżącym kierunku i planuje następny
+void RelaySequencer::advance(int64_t now) {
+  while (true) {
+    if (mode == SEQUENCER_STARTUP || mode == SEQUENCER_PREARM) {
+      if (mode == SEQUENCER_PREARM && position >= preArmStop) {
+        scheduleAt(preArmStartTime + (int64_t)output->getPreArmMs() * 1000, now);
+        return;
+      }
+      if (position >= stepCount) {
+        relaysActive = true;
+        startupEndTime = now;
+        startupCompleted = true;
+        mode = SEQUENCER_IDLE;
+        return;
+      }
+
+      int64_t due = position == 0 ? now : stepTime[position - 1] + (int64_t)stepDelayMs(position) * 1000;
+      if (due > now) {
+        scheduleAt(due, now);
+        return;
+      }
+      output->applyStep(position, true, now);
+      if (position == 0) startupBeginTime = now;
+      stepTime[position] = now;
+      position++;
+    } else if (mode == SEQUENCER_SHUTDOWN) {
+      if (position == 0) {
+        shutdownEndTime = now;
+        if (relaysActive) {
+          relaysActive = false;
+          shutdownCompleted = true;
+        }
+        mode = SEQUENCER_IDLE;
+        return;
+      }
+
+      // Krok j cofany po opóźnieniu kroku j+1 - lustro sekwencji startowej
+      int64_t due = lastUndoTime == 0 ? now : lastUndoTime + (int64_t)stepDelayMs(position) * 1000;
+      if (due > now) {
+        scheduleAt(due, now);
+        return;
+      }
+      if (lastUndoTime == 0) shutdownBeginTime = now;
+      position--;
+      output->applyStep(position, false, now);
+      lastUndoTime = now;
+    } else {
+      return;
+    }
+  }
+}
+
+// Wyprzedzające włączenie - kroki przed pierwszym STEP_CONFIRMED
+bool RelaySequencer::preArm(int64_t now) {
+  if (output->getPreArmMs() == 0 || mode != SEQUENCER_IDLE || position != 0) return false;
+  mode = SEQUENCER_PREARM;
+  preArmStartTime = now;
+  advance(now);
+  return true;
+}
+
+// Start od zera, potwierdzenie pre-arm albo wznowienie przerwanego wyłączania
+bool RelaySequencer::start(int64_t now) {
+  if (!(mode == SEQUENCER_PREARM || mode == SEQUENCER_SHUTDOWN || (mode == SEQUENCER_IDLE && position == 0))) {
+    return false;
+  }
+  lastRemainingMs = 0;
+  if (mode == SEQUENCER_PREARM && position > 0 && position < stepCount) {
+    // Wyjścia pre-arm już pracują - reszta po pozostałej części opóźnienia
+    int64_t armedMs = (now - stepTime[position - 1]) / 1000;
+    unsigned long delayMs = stepDelayMs(position);
+    lastGapSavedMs = (uint32_t)(armedMs < (int64_t)delayMs ? armedMs : (int64_t)delayMs);
+    lastRemainingMs = delayMs - lastGapSavedMs;
+  }
+  output->cancelSchedule();
+  switchScheduled = false;
+  mode = SEQUENCER_STARTUP;
+  advance(now);
+  return true;
+}
+
+// Cofa wykonane kroki od bieżącej pozycji - także przerwany start i pre-arm
+bool RelaySequencer::shutdown(int64_t now) {
+  if (position == 0 || mode == SEQUENCER_SHUTDOWN) return false;
+  output->cancelSchedule();
+  switchScheduled = false;
+  mode = SEQUENCER_SHUTDOWN;
+  lastUndoTime = 0;
+  advance(now);
+  return true;
+}
+
+// Jednorazowy timer - kolejny krok sekwencji w zaplanowanym momencie
+void RelaySequencer::timerExpired(int64_t now) {
+  // Callback mógł czekać na mux, gdy loop() zmienił kierunek - liczy się tylko bieżący termin
+  if (!switchScheduled || now < scheduledSwitchTime) return;
+  switchScheduled = false;
+  if (mode == SEQUENCER_PREARM && position >= preArmStop) {
+    // Brak potwierdzenia detekcji - wyjścia pre-arm wracają do stanu spoczynkowego
+    preArmFalse++;
+    preArmExpired = true;
+    mode = SEQUENCER_SHUTDOWN;
+    lastUndoTime = 0;
+  } else {
+    recordSwitch(now);
+  }
+  advance(now);
+}
@@ -0,0 +1,107 @@
+#ifndef RELAY_SEQUENCER_H
+#define RELAY_SEQUENCER_H
+
+#include <stdint.h>
+#include "RelaySequence.h"
+
+#define RELAY_SEQUENCER_MAX_STEPS 8
+
+static_assert(RELAY_STEP_COUNT <= RELAY_SEQUENCER_MAX_STEPS, "Sekwencja: zbyt wiele kroków");
+
+// Kierunek pracy sekwencera
+enum SequencerMode {
+  SEQUENCER_IDLE,
+  SEQUENCER_STARTUP,        // kroki tablicy w przód
+  SEQUENCER_SHUTDOWN,       // te same kroki od końca, z odwróconymi poziomami
+  SEQUENCER_PREARM          // kroki przed pierwszym STEP_CONFIRMED, czeka na potwierdzenie audio
+};
+
+// Wyjście sekwencera: wykonanie kroku, jednorazowy timer i opóźnienia z
+// konfiguracji. RelayController steruje pinami i esp_timer, testy na PC
+// zapisują wywołania.
+class RelaySequencerOutput {
+public:
+  virtual void applyStep(uint8_t index, bool forward, int64_t now) = 0;
+  virtual void scheduleAt(int64_t due, int64_t now) = 0;
+  virtual void cancelSchedule() = 0;
+  virtual unsigned long getConfigDelayMs() = 0;   // dla kroków RELAY_DELAY_CONFIG
+  virtual unsigned long getPreArmMs() = 0;
+};
+
+// Logika czasowa sekwencji przekaźników, bez zależności od sprzętu - czas
+// [us] podawany jest w każdym wywołaniu. position to liczba wykonanych
+// kroków startowych - start przesuwa ją w przód, wyłączanie w tył, więc
+// przerwanie i wznowienie w dowolnym momencie to tylko zmiana kierunku.
+// Krok j wykonywany jest nie wcześniej niż jego opóźnienie po kroku j-1,
+// dlatego wznowienie startu przy pracującej przetwornicy nie czeka ponownie
+// na upłynięte już opóźnienie. Przy wyłączaniu krok j cofany jest po
+// opóźnieniu kroku j+1.
+//
+// Wywołujący zapewnia wyłączność (RelayController - sequenceMux).
+class RelaySequencer {
+private:
+  RelaySequencerOutput* output;
+  const RelayStep* steps;
+  uint8_t stepCount;
+  uint8_t preArmStop;
+
+  volatile SequencerMode mode;
+  volatile uint8_t position;
+  volatile bool relaysActive;
+
+  int64_t stepTime[RELAY_SEQUENCER_MAX_STEPS];   // ostatnie wykonanie kroku j w przód
+  int64_t lastUndoTime;                          // 0 = pierwszy krok wyłączania od razu
+  int64_t preArmStartTime;
+  int64_t scheduledSwitchTime;
+  bool switchScheduled;
+  int64_t startupBeginTime;
+  int64_t startupEndTime;
+  int64_t shutdownBeginTime;
+  int64_t shutdownEndTime;
+  int32_t lastJitterUs;
+  int32_t maxJitterUs;
+  uint32_t switchCount;
+  uint32_t lastGapSavedMs;     // o tyle wcześniej wykonał się pierwszy krok STEP_CONFIRMED
+  unsigned long lastRemainingMs;
+  uint32_t preArmFalse;
+  bool startupCompleted;
+  bool shutdownCompleted;
+  bool preArmExpired;
+
+  void advance(int64_t now);
+  void scheduleAt(int64_t due, int64_t now);
+  void recordSwitch(int64_t now);
+
+public:
+  RelaySequencer(RelaySequencerOutput* output, const RelayStep* steps = RELAY_STARTUP_STEPS,
+                 uint8_t stepCount = RELAY_STEP_COUNT);
+
+  bool preArm(int64_t now);
+  bool start(int64_t now);
+  bool shutdown(int64_t now);
+  void timerExpired(int64_t now);
+  unsigned long stepDelayMs(uint8_t index);
+
+  // Zdarzenia z kontekstu timera, odbierane jednorazowo przez loop()
+  bool takeStartupCompleted() { bool done = startupCompleted; startupCompleted = false; return done; }
+  bool takeShutdownCompleted() { bool done = shutdownCompleted; shutdownCompleted = false; return done; }
+  bool takePreArmExpired() { bool expired = preArmExpired; preArmExpired = false; return expired; }
+
+  SequencerMode getMode() { return mode; }
+  uint8_t getPosition() { return position; }
+  uint8_t getStepCount() { return stepCount; }
+  bool isRelaysActive() { return relaysActive; }
+  bool isScheduled() { return switchScheduled; }
+  int64_t getScheduledTime() { return scheduledSwitchTime; }
+  int64_t getStepTime(uint8_t index) { return stepTime[index]; }
+  int64_t getStartupGapUs() { return startupEndTime > startupBeginTime ? startupEndTime - startupBeginTime : 0; }
+  int64_t getShutdownGapUs() { return shutdownEndTime > shutdownBeginTime ? shutdownEndTime - shutdownBeginTime : 0; }
+  int32_t getLastJitterUs() { return lastJitterUs; }
+  int32_t getMaxJitterUs() { return maxJitterUs; }
+  uint32_t getSwitchCount() { return switchCount; }
+  uint32_t getLastGapSavedMs() { return lastGapSavedMs; }
+  unsigned long getLastRemainingMs() { return lastRemainingMs; }
+  uint32_t getPreArmFalse() { return preArmFalse; }
+};
+
+#endif
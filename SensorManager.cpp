@@ -1,38 +1,703 @@
 #include "SensorManager.h"
+#include <esp_adc/adc_cali.h>
+#include <esp_adc/adc_cali_scheme.h>
+#include <esp_adc/adc_oneshot.h>
+#include <esp_random.h>
 
-SensorManager::SensorManager() : filteredValue(0.0), alpha(0.1) {
+static inline uint16_t median3(uint16_t a, uint16_t b, uint16_t c) {
+  if (a > b) { uint16_t t = a; a = b; b = t; }
+  if (b > c) b = c;
+  return a > b ? a : b;
 }
 
-void SensorManager::init(DallasTemperature* sensors, int audioPin, int batteryPin) {
-  this->sensors = sensors;
-  this->audioPin = audioPin;
+SensorManager::SensorManager() :
+  alpha(0.1),
+  audioTime(0),
+  floorGainDb(-1.0),
+  floorGain(1.0),
+  batteryMillivolts(0),
+  batteryFilter(0),
+  batteryTime(0),
+  batteryCalibrated(false),
+  adcMutex(NULL),
+  wakeTask(NULL),
+  idlePollTimer(NULL),
+  idleArmed(false),
+  onsetDetected(false),
+  onsetTime(0),
+  lastAudioWake(0),
+  audioWakeCount(0),
+  lastWakeLatencyUs(0),
+  maxWakeLatencyUs(0),
+  idleTimeUs(0),
+  idleWindows(0)
+#if AUDIO_IDLE_USE_MONITOR
+  , adcStream(NULL),
+  idleMonitor(NULL),
+  idleBurstTimer(NULL),
+  streamRunning(false),
+  streamAudioChannel(0),
+  streamBatteryChannel(0),
+  streamAudioRaw(0),
+  streamBatteryIndex(0),
+  batteryMonitor(NULL),
+  batteryAlertRaw(0),
+  batteryAlertEnabled(false),
+  batteryAlertFired(false),
+  batteryAlertTask(NULL)
+#endif
+{
+  memset(channels, 0, sizeof(channels));
+  memset(batteryLut, 0, sizeof(batteryLut));
+#if AUDIO_IDLE_USE_MONITOR
+  memset((void*)streamBatteryRaw, 0, sizeof(streamBatteryRaw));
+#endif
+}
+
+void SensorManager::init(const ZonePins* zonePins, int batteryPin) {
   this->batteryPin = batteryPin;
+  adcMutex = xSemaphoreCreateMutex();
+
+  buildBatteryLut();
+
+  // Startowa estymata składowej stałej wejść audio
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    channels[z].pin = zonePins[z].audio;
+    uint16_t raw = 0;
+    readAdc(channels[z].pin, portMAX_DELAY, &raw);
+    channels[z].bias = raw * AUDIO_ADC_VREF / 4095.0f;
+#if AUDIO_IDLE_USE_MONITOR
+    if (z == 0) streamAudioRaw = raw;
+#endif
+  }
+
+#if AUDIO_IDLE_USE_MONITOR
+  if (!initAdcStream()) adcStream = NULL;
+#endif
+
+  // Zadanie pętli budzone przez monitor audio (i przycisk)
+  wakeTask = xTaskGetCurrentTaskHandle();
+
+  esp_timer_create_args_t pollArgs = {};
+  pollArgs.callback = &SensorManager::handleIdlePoll;
+  pollArgs.arg = this;
+  pollArgs.dispatch_method = ESP_TIMER_TASK;
+  pollArgs.name = "audio_idle";
+  esp_timer_create(&pollArgs, &idlePollTimer);
+
+#if AUDIO_IDLE_USE_MONITOR
+  pollArgs.callback = &SensorManager::handleIdleBurstEnd;
+  pollArgs.name = "audio_burst";
+  esp_timer_create(&pollArgs, &idleBurstTimer);
+#endif
 }
 
-bool SensorManager::readAudio(float threshold, ConsoleLogger* logger, bool uartActive) {
-  float voltage = (analogRead(audioPin) / 4095.0) - 1;
-  filteredValue = alpha * voltage + (1.0 - alpha) * filteredValue;
+// Próbka -> filtr górnoprzepustowy (odjęcie wolno śledzonej składowej stałej)
+// -> prostowanie -> obwiednia. Próg bezwzględny albo poziom szumu + N dB.
+// Wszystkie strefy próbkowane w jednym przebiegu. Zwraca true, gdy obwiednia
+// którejkolwiek strefy przekracza jej próg.
+bool SensorManager::readAudio(ConfigManager* config, ConsoleLogger* logger, bool uartActive) {
+  audioTime = millis();
+  bool detected = false;
 
-  if (voltage > fabs(threshold)) {
-    if (uartActive) {
-      Serial.print(voltage, 3);
-      Serial.println("  <--- Wykryto sygnał audio");
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    AudioChannel& channel = channels[z];
+    uint16_t raw;
+    if (!readAdc(channel.pin, portMAX_DELAY, &raw)) continue;
+    float sample = raw * AUDIO_ADC_VREF / 4095.0f;
+    if (processAudio(config, z, sample)) detected = true;
+
+    if (channel.level > channel.trigger) {
+      if (uartActive) {
+        Serial.print(channel.level, 3);
+        Serial.printf("  <--- Wykryto sygnał audio (strefa %d)\n", z);
+      }
+      logger->addLog("AUDIO", "info", "Wykryto sygnał audio: %.3fV (strefa %d)", channel.level, z);
     }
-    logger->addLog("AUDIO", "info", "Wykryto sygnał audio: " + String(voltage, 3) + "V");
   }
 
   delay(1);
-  return (filteredValue >= fabs(threshold));
+  return detected;
 }
 
-bool SensorManager::readBattery(float threshold) {
-  float adc = analogRead(batteryPin);
-  float napiecie = ((adc) / 4095.0) * 3.3 * (47 + 12) / 12;
-  
-  if (napiecie >= threshold) {
+bool SensorManager::readAdc(int pin, TickType_t wait, uint16_t* raw) {
+#if AUDIO_IDLE_USE_MONITOR
+  // Strumień ciągły trzyma ADC1 - próbka z ostatniej ramki DMA zamiast oneshot
+  if (streamRunning && pin == channels[0].pin) {
+    *raw = streamAudioRaw;
     return true;
+  }
+#endif
+  if (adcMutex == NULL || xSemaphoreTake(adcMutex, wait) != pdTRUE) return false;
+  *raw = analogRead(pin);
+  xSemaphoreGive(adcMutex);
+  return true;
+}
+
+// Filtr jednej próbki strefy, bez ADC i logowania. true = obwiednia >= próg.
+bool SensorManager::processAudio(ConfigManager* config, int zone, float sample) {
+  AudioChannel& channel = channels[zone];
+  channel.bias += AUDIO_DC_ALPHA * (sample - channel.bias);
+  channel.level = fabs(sample - channel.bias);
+  channel.envelope = alpha * channel.level + (1.0 - alpha) * channel.envelope;
+
+  // Przy sygnale statystyka stoi - minimum podokien szłoby za obwiednią
+  // muzyki i próg rósłby ponad jej poziom. Wznowienie dopiero po
+  // AUDIO_FLOOR_HOLDOFF_MS ciszy, więc doliny między uderzeniami basu też
+  // się nie liczą.
+  if (channel.envelope >= channel.trigger && channel.trigger > 0) {
+    if (channel.signalTime != 0) channel.floorFrozenMs += audioTime - channel.signalTime;
+    channel.signalTime = audioTime;
+    channel.floorWindowStart = 0;
+  } else if (channel.signalTime == 0 || audioTime - channel.signalTime >= AUDIO_FLOOR_HOLDOFF_MS) {
+    channel.signalTime = 0;
+    updateNoiseFloor(channel, audioTime);
+  }
+  channel.trigger = computeTrigger(config, channel, zone);
+  return channel.envelope >= channel.trigger;
+}
+
+// Statystyka minimum: minimum obwiedni w podoknach, poziom szumu to
+// najmniejsze z ostatnich AUDIO_FLOOR_WINDOWS podokien. Krótkie pauzy w muzyce
+// nie obniżają go gwałtownie, a wzrost szumu tła jest widoczny po 16 s.
+void SensorManager::updateNoiseFloor(AudioChannel& channel, unsigned long now) {
+  if (channel.floorWindowStart == 0) {
+    channel.floorWindowStart = now;
+    channel.floorWindowMin = channel.envelope;
+  }
+  if (channel.envelope < channel.floorWindowMin) channel.floorWindowMin = channel.envelope;
+  if (now - channel.floorWindowStart < AUDIO_FLOOR_WINDOW_MS) return;
+
+  channel.floorMins[channel.floorIndex] = channel.floorWindowMin;
+  channel.floorIndex = (channel.floorIndex + 1) % AUDIO_FLOOR_WINDOWS;
+  if (channel.floorCount < AUDIO_FLOOR_WINDOWS) channel.floorCount++;
+  channel.floorWindowStart = now;
+  channel.floorWindowMin = channel.envelope;
+
+  float minimum = channel.floorMins[0];
+  for (int i = 1; i < channel.floorCount; i++) {
+    if (channel.floorMins[i] < minimum) minimum = channel.floorMins[i];
+  }
+  channel.noiseFloor = minimum * AUDIO_FLOOR_BIAS_COMP;
+  channel.noiseFloorValid = true;
+}
+
+// Do zebrania pierwszego podokna tryb szum + dB używa progu bezwzględnego
+float SensorManager::computeTrigger(ConfigManager* config, AudioChannel& channel, int zone) {
+  if (config->getAudioMode() != AUDIO_MODE_FLOOR || !channel.noiseFloorValid) {
+    return fabs(config->getAudioThreshold(zone));
+  }
+  if (config->getAudioFloorDb() != floorGainDb) {
+    floorGainDb = config->getAudioFloorDb();
+    floorGain = powf(10.0f, floorGainDb / 20.0f);
+  }
+  return max(channel.noiseFloor * floorGain, AUDIO_FLOOR_MIN_TRIGGER);
+}
+
+// Wypełnia węzły tablicy konwersji z kalibracji eFuse (krzywa ESP32-C3).
+// Bez kalibracji używana jest liniowa zależność 0..3.3 V.
+void SensorManager::buildBatteryLut() {
+  adc_cali_handle_t cali = NULL;
+
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+  adc_unit_t unit;
+  adc_channel_t channel;
+  if (adc_oneshot_io_to_channel(batteryPin, &unit, &channel) == ESP_OK) {
+    adc_cali_curve_fitting_config_t caliConfig = {};
+    caliConfig.unit_id = unit;
+    caliConfig.chan = channel;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0)
+    caliConfig.atten = ADC_ATTEN_DB_12;  // domyślne tłumienie analogRead()
+#else
+    caliConfig.atten = ADC_ATTEN_DB_11;
+#endif
+    caliConfig.bitwidth = ADC_BITWIDTH_12;
+    if (adc_cali_create_scheme_curve_fitting(&caliConfig, &cali) != ESP_OK) {
+      cali = NULL;
+    }
+  }
+#endif
+
+  batteryCalibrated = (cali != NULL);
+  for (int i = 0; i < BATT_LUT_POINTS; i++) {
+    int raw = min(i << BATT_LUT_SHIFT, BATT_ADC_MAX);
+    int pinMv;
+    if (cali == NULL || adc_cali_raw_to_voltage(cali, raw, &pinMv) != ESP_OK) {
+      pinMv = (int)((uint32_t)raw * 3300 / BATT_ADC_MAX);
+    }
+    batteryLut[i] = (uint16_t)((uint32_t)pinMv * (BATT_DIVIDER_TOP + BATT_DIVIDER_BOTTOM) / BATT_DIVIDER_BOTTOM);
+  }
+
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+  if (cali != NULL) adc_cali_delete_scheme_curve_fitting(cali);
+#endif
+}
+
+// Nadpróbkowanie: mediana z każdej trójki odrzuca pojedyncze szpilki,
+// a średnia median daje wynik zdecymowany. Zero to nieudana konwersja
+// (akumulator 0 V nie zasiliłby sterownika) - cały pomiar jest odrzucany.
+bool SensorManager::sampleBatteryRaw(uint16_t* raw) {
+#if AUDIO_IDLE_USE_MONITOR
+  if (streamRunning) return readStreamBattery(raw);
+#endif
+  if (adcMutex == NULL || xSemaphoreTake(adcMutex, portMAX_DELAY) != pdTRUE) return false;
+  uint32_t sum = 0;
+  bool valid = true;
+  for (int i = 0; i < BATT_OVERSAMPLE / 3 && valid; i++) {
+    uint16_t a = analogRead(batteryPin);
+    uint16_t b = analogRead(batteryPin);
+    uint16_t c = analogRead(batteryPin);
+    valid = a != 0 && b != 0 && c != 0;
+    sum += median3(a, b, c);
+  }
+  xSemaphoreGive(adcMutex);
+  if (!valid) return false;
+  *raw = (uint16_t)(sum / (BATT_OVERSAMPLE / 3));
+  return true;
+}
+
+void SensorManager::storeBatteryMillivolts(uint16_t millivolts) {
+  batteryMillivolts = millivolts;
+  if (batteryFilter == 0) {
+    batteryFilter = (uint32_t)millivolts << BATT_FILTER_SHIFT;
   } else {
-    // W wersji produkcyjnej zmień na false
+    batteryFilter = batteryFilter - (batteryFilter >> BATT_FILTER_SHIFT) + millivolts;
+  }
+  batteryTime = millis();
+}
+
+uint16_t SensorManager::rawToMillivolts(uint16_t raw) {
+  raw = min(raw, (uint16_t)BATT_ADC_MAX);
+  uint16_t index = raw >> BATT_LUT_SHIFT;
+  uint16_t offset = raw & ((1 << BATT_LUT_SHIFT) - 1);
+  uint16_t low = batteryLut[index];
+  uint16_t high = batteryLut[index + 1];
+  return low + (uint16_t)(((uint32_t)(high - low) * offset) >> BATT_LUT_SHIFT);
+}
+
+// Odwrotność tablicy konwersji - próg monitora akumulatora w kodach ADC
+uint16_t SensorManager::millivoltsToRaw(uint16_t millivolts) {
+  for (int i = 0; i < BATT_LUT_POINTS - 1; i++) {
+    uint16_t low = batteryLut[i];
+    uint16_t high = batteryLut[i + 1];
+    if (millivolts > high) continue;
+    uint32_t code = (uint32_t)i << BATT_LUT_SHIFT;
+    if (millivolts > low) code += ((uint32_t)(millivolts - low) << BATT_LUT_SHIFT) / (high - low);
+    return (uint16_t)min(code, (uint32_t)BATT_ADC_MAX);
+  }
+  return BATT_ADC_MAX;
+}
+
+// Odczyt z pętli, gdy BatteryGuard nie ma szybkiego monitora. false = brak próbki.
+bool SensorManager::readBattery() {
+  uint16_t raw;
+  if (!sampleBatteryRaw(&raw)) return false;
+  storeBatteryMillivolts(rawToMillivolts(raw));
+  return true;
+}
+
+// Szybki odczyt dla BatteryGuard - mediana z 3 próbek i tablica konwersji.
+// Przy pracującym strumieniu próbki z ramek DMA, bez niego oneshot. Nie czeka
+// na ADC: gdy pętla właśnie mierzy audio albo konwersja się nie udała, zwraca
+// false (brak próbki, nie zanik napięcia).
+bool SensorManager::readBatteryMillivoltsFast(uint16_t* millivolts) {
+  uint16_t raw;
+#if AUDIO_IDLE_USE_MONITOR
+  if (streamRunning) {
+    if (!readStreamBattery(&raw)) return false;
+    *millivolts = rawToMillivolts(raw);
+    storeBatteryMillivolts(*millivolts);
     return true;
   }
+#endif
+  if (adcMutex == NULL || xSemaphoreTake(adcMutex, 0) != pdTRUE) return false;
+  uint16_t a = analogRead(batteryPin);
+  uint16_t b = analogRead(batteryPin);
+  uint16_t c = analogRead(batteryPin);
+  xSemaphoreGive(adcMutex);
+  if (a == 0 || b == 0 || c == 0) return false;
+  raw = median3(a, b, c);
+
+  *millivolts = rawToMillivolts(raw);
+  storeBatteryMillivolts(*millivolts);
+  return true;
+}
+
+#if AUDIO_IDLE_USE_MONITOR
+// Sterownik ADC w trybie ciągłym, wzorzec: wejście audio strefy 0 i akumulator.
+// Ramki odbierane w callbacku, bez adc_continuous_read() - pula nadpisywana.
+bool SensorManager::initAdcStream() {
+  adc_unit_t audioUnit, batteryUnit;
+  adc_channel_t audioChannel, batteryChannel;
+  if (adc_oneshot_io_to_channel(channels[0].pin, &audioUnit, &audioChannel) != ESP_OK ||
+      adc_oneshot_io_to_channel(batteryPin, &batteryUnit, &batteryChannel) != ESP_OK ||
+      audioUnit != ADC_UNIT_1 || batteryUnit != ADC_UNIT_1) {
+    return false;
+  }
+  streamAudioChannel = audioChannel;
+  streamBatteryChannel = batteryChannel;
+
+  adc_continuous_handle_cfg_t handleConfig = {};
+  handleConfig.max_store_buf_size = 2 * ADC_STREAM_FRAME_BYTES;
+  handleConfig.conv_frame_size = ADC_STREAM_FRAME_BYTES;
+  handleConfig.flags.flush_pool = 1;
+  if (adc_continuous_new_handle(&handleConfig, &adcStream) != ESP_OK) return false;
+
+  adc_digi_pattern_config_t pattern[2] = {};
+  pattern[0].atten = ADC_ATTEN_DB_12;
+  pattern[0].channel = audioChannel;
+  pattern[0].unit = ADC_UNIT_1;
+  pattern[0].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  pattern[1] = pattern[0];
+  pattern[1].channel = batteryChannel;   // to samo tłumienie co tablica konwersji
+
+  adc_continuous_config_t adcConfig = {};
+  adcConfig.pattern_num = 2;
+  adcConfig.adc_pattern = pattern;
+  adcConfig.sample_freq_hz = AUDIO_IDLE_SAMPLE_HZ;
+  adcConfig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  adcConfig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+
+  adc_continuous_evt_cbs_t callbacks = {};
+  callbacks.on_conv_done = &SensorManager::handleStreamFrame;
+  if (adc_continuous_config(adcStream, &adcConfig) != ESP_OK ||
+      adc_continuous_register_event_callbacks(adcStream, &callbacks, this) != ESP_OK) {
+    adc_continuous_deinit(adcStream);
+    return false;
+  }
+  return true;
+}
+
+// Ramka DMA - zapamiętuje ostatnie próbki obu kanałów wzorca
+bool IRAM_ATTR SensorManager::handleStreamFrame(adc_continuous_handle_t handle, const adc_continuous_evt_data_t* data, void* arg) {
+  SensorManager* self = (SensorManager*)arg;
+  const adc_digi_output_data_t* results = (const adc_digi_output_data_t*)data->conv_frame_buffer;
+  uint32_t count = data->size / sizeof(adc_digi_output_data_t);
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t value = results[i].type2.data;
+    if (results[i].type2.channel == self->streamAudioChannel) {
+      self->streamAudioRaw = value;
+    } else if (results[i].type2.channel == self->streamBatteryChannel) {
+      self->streamBatteryRaw[self->streamBatteryIndex] = value;
+      self->streamBatteryIndex = (self->streamBatteryIndex + 1) % 3;
+    }
+  }
+  return false;
+}
+
+// Zdarzenie przychodzi z każdą konwersją poniżej progu - zadanie budzone raz,
+// do ponownego włączenia alarmu
+bool IRAM_ATTR SensorManager::handleBatteryMonitor(adc_monitor_handle_t monitor, const adc_monitor_evt_data_t* data, void* arg) {
+  SensorManager* self = (SensorManager*)arg;
+  if (self->batteryAlertFired) return false;
+  self->batteryAlertFired = true;
+
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(self->batteryAlertTask, &woken);
+  return woken == pdTRUE;
+}
+
+bool SensorManager::readStreamBattery(uint16_t* raw) {
+  uint16_t a = streamBatteryRaw[0];
+  uint16_t b = streamBatteryRaw[1];
+  uint16_t c = streamBatteryRaw[2];
+  if (a == 0 || b == 0 || c == 0) return false;
+  *raw = median3(a, b, c);
+  return true;
+}
+
+// Monitor progu dolnego na kanale akumulatora. Tworzony ponownie tylko po
+// zmianie progu; ADC zatrzymany, alarm wyłączony (wywołujący trzyma adcMutex).
+bool SensorManager::configureBatteryMonitor(uint16_t thresholdRaw) {
+  if (batteryMonitor != NULL && thresholdRaw == batteryAlertRaw) return true;
+  if (batteryMonitor != NULL) {
+    adc_del_continuous_monitor(batteryMonitor);
+    batteryMonitor = NULL;
+  }
+
+  adc_monitor_config_t monitorConfig = {};
+  monitorConfig.adc_unit = ADC_UNIT_1;
+  monitorConfig.channel = (adc_channel_t)streamBatteryChannel;
+  monitorConfig.h_threshold = -1;  // tylko próg dolny
+  monitorConfig.l_threshold = thresholdRaw;
+  if (adc_new_continuous_monitor(adcStream, &monitorConfig, &batteryMonitor) != ESP_OK) {
+    batteryMonitor = NULL;
+    return false;
+  }
+
+  adc_monitor_evt_cbs_t callbacks = {};
+  callbacks.on_below_low_thresh = &SensorManager::handleBatteryMonitor;
+  adc_continuous_monitor_register_event_callbacks(batteryMonitor, &callbacks, this);
+  batteryAlertRaw = thresholdRaw;
+  return true;
+}
+
+bool SensorManager::enableBatteryAlert(bool enabled) {
+  if (batteryMonitor == NULL) return !enabled;
+  if (enabled == batteryAlertEnabled) return true;
+  esp_err_t err = enabled ? adc_continuous_monitor_enable(batteryMonitor) : adc_continuous_monitor_disable(batteryMonitor);
+  if (err != ESP_OK) return false;
+  batteryAlertEnabled = enabled;
+  batteryAlertFired = false;
+  return true;
+}
+#endif
+
+// Strumień ADC poza bezczynnością: audio i akumulator z ramek DMA, monitor
+// budzi zadanie task przy spadku napięcia poniżej thresholdMv.
+// false = brak monitora (BatteryGuard próbkuje wtedy timerem).
+bool SensorManager::startBatteryMonitor(uint16_t thresholdMv, TaskHandle_t task) {
+#if AUDIO_IDLE_USE_MONITOR
+  if (adcStream == NULL || task == NULL) return false;
+  xSemaphoreTake(adcMutex, portMAX_DELAY);
+  batteryAlertTask = task;
+  streamRunning = configureBatteryMonitor(millivoltsToRaw(thresholdMv)) && enableBatteryAlert(true) &&
+                  adc_continuous_start(adcStream) == ESP_OK;
+  if (!streamRunning) enableBatteryAlert(false);
+  bool started = streamRunning;
+  xSemaphoreGive(adcMutex);
+  return started;
+#else
+  return false;
+#endif
+}
+
+// Zatrzymanie przed bezczynnością - okna monitora audio używają tego samego ADC
+void SensorManager::stopBatteryMonitor() {
+#if AUDIO_IDLE_USE_MONITOR
+  xSemaphoreTake(adcMutex, portMAX_DELAY);
+  if (streamRunning) {
+    adc_continuous_stop(adcStream);
+    streamRunning = false;
+  }
+  enableBatteryAlert(false);
+  xSemaphoreGive(adcMutex);
+#endif
+}
+
+// Włączenie alarmu albo zmiana progu. Monitor zmieniany jest tylko przy
+// zatrzymanym ADC - przerwa w próbkach to restart sterownika. Po
+// stopBatteryMonitor() nic nie robi, alarm włączy następny start.
+void SensorManager::setBatteryAlert(uint16_t thresholdMv, bool enabled) {
+#if AUDIO_IDLE_USE_MONITOR
+  xSemaphoreTake(adcMutex, portMAX_DELAY);
+  uint16_t thresholdRaw = millivoltsToRaw(thresholdMv);
+  if (streamRunning && (enabled != batteryAlertEnabled || (enabled && thresholdRaw != batteryAlertRaw))) {
+    adc_continuous_stop(adcStream);
+    enableBatteryAlert(false);
+    if (enabled && configureBatteryMonitor(thresholdRaw)) enableBatteryAlert(true);
+    streamRunning = adc_continuous_start(adcStream) == ESP_OK;
+  }
+  xSemaphoreGive(adcMutex);
+#endif
+}
+
+void SensorManager::fillSnapshot(SensorSnapshot& snapshot) {
+  snapshot.batteryVoltage = getBatteryVoltage();
+  snapshot.batteryTime = batteryTime;
+  snapshot.audioTime = audioTime;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    ZoneSnapshot& zone = snapshot.zones[z];
+    zone.audioEnvelope = channels[z].envelope;
+    zone.audioFloor = channels[z].noiseFloor;
+    zone.audioTrigger = channels[z].trigger;
+  }
+}
+
+// Próg wybudzenia w kodach ADC: składowa stała + próg obwiedni. Monitor
+// porównuje pojedyncze próbki, więc szczyt sygnału budzi wcześniej niż obwiednia.
+uint16_t SensorManager::audioWakeRaw(const AudioChannel& channel, float trigger) {
+  float raw = (channel.bias + trigger) * 4095.0f / AUDIO_ADC_VREF;
+  uint16_t code = (uint16_t)constrain(raw, 0.0f, 4095.0f);
+  return code - code % AUDIO_WAKE_RAW_STEP;
+}
+
+// Przygotowanie monitora progu audio na strumieniu ADC. Wywoływane w setup()
+// i przed uśpieniem - monitor tworzony jest ponownie tylko po zmianie progu
+// o co najmniej AUDIO_WAKE_RAW_STEP kodów.
+void SensorManager::prepareIdleWake(ConfigManager* config) {
+#if AUDIO_IDLE_USE_MONITOR
+  if (streamRunning) return;   // monitor zmieniany tylko przy zatrzymanym ADC
+#endif
+  bool changed = false;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    uint16_t thresholdRaw = audioWakeRaw(channels[z], computeTrigger(config, channels[z], z));
+    if (thresholdRaw != channels[z].wakeRaw) changed = true;
+    channels[z].wakeRaw = thresholdRaw;
+  }
+  if (!changed) return;
+
+#if AUDIO_IDLE_USE_MONITOR
+  if (adcStream == NULL) return;
+
+  if (idleMonitor != NULL) {
+    adc_del_continuous_monitor(idleMonitor);
+    idleMonitor = NULL;
+  }
+
+  adc_monitor_config_t monitorConfig = {};
+  monitorConfig.adc_unit = ADC_UNIT_1;
+  monitorConfig.channel = (adc_channel_t)streamAudioChannel;
+  monitorConfig.h_threshold = channels[0].wakeRaw;
+  monitorConfig.l_threshold = -1;  // tylko próg górny
+  if (adc_new_continuous_monitor(adcStream, &monitorConfig, &idleMonitor) != ESP_OK) {
+    idleMonitor = NULL;
+    return;
+  }
+
+  adc_monitor_evt_cbs_t callbacks = {};
+  callbacks.on_over_high_thresh = &SensorManager::handleAudioMonitor;
+  adc_continuous_monitor_register_event_callbacks(idleMonitor, &callbacks, this);
+#endif
+}
+
+void SensorManager::signalOnset() {
+  onsetTime = esp_timer_get_time();
+  onsetDetected = true;
+}
+
+#if AUDIO_IDLE_USE_MONITOR
+bool IRAM_ATTR SensorManager::handleAudioMonitor(adc_monitor_handle_t monitor, const adc_monitor_evt_data_t* data, void* arg) {
+  SensorManager* self = (SensorManager*)arg;
+  if (self->onsetDetected) return false;
+  self->onsetTime = esp_timer_get_time();
+  self->onsetDetected = true;
+
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(self->wakeTask, &woken);
+  return woken == pdTRUE;
+}
+
+// Koniec okna monitora - zatrzymanie ADC zwalnia blokadę esp_pm sterownika
+void SensorManager::handleIdleBurstEnd(void* arg) {
+  SensorManager* self = (SensorManager*)arg;
+  adc_continuous_stop(self->adcStream);
+  xSemaphoreGive(self->adcMutex);
+  self->scheduleIdlePoll();
+}
+#endif
+
+// Następne okno po AUDIO_IDLE_POLL_US + losowy dodatek. Stały okres
+// trafiałby przy basie o okresie równym jego wielokrotności stale w tę samą
+// fazę (np. dolinę) i sygnał nie budziłby pętli.
+void SensorManager::scheduleIdlePoll() {
+  if (!idleArmed || onsetDetected) return;
+  esp_timer_start_once(idlePollTimer, AUDIO_IDLE_POLL_US + esp_random() % AUDIO_IDLE_POLL_JITTER_US);
+}
+
+// Okno próbkowania w bezczynności: monitor ADC przez AUDIO_IDLE_BURST_US,
+// a bez monitora pojedyncza próbka każdego wejścia (komparator programowy).
+// Wywołania z zadania esp_timer - adcMutex trzymany przez całe okno, także
+// między tym callbackiem a handleIdleBurstEnd().
+void SensorManager::handleIdlePoll(void* arg) {
+  SensorManager* self = (SensorManager*)arg;
+  if (!self->idleArmed || self->onsetDetected) return;
+  if (xSemaphoreTake(self->adcMutex, 0) != pdTRUE) {
+    self->scheduleIdlePoll();
+    return;
+  }
+  if (!self->idleArmed) {
+    xSemaphoreGive(self->adcMutex);
+    return;
+  }
+  self->idleWindows++;
+
+#if AUDIO_IDLE_USE_MONITOR
+  if (self->idleMonitor != NULL) {
+    if (adc_continuous_start(self->adcStream) == ESP_OK) {
+      esp_timer_start_once(self->idleBurstTimer, AUDIO_IDLE_BURST_US);
+      return;
+    }
+    xSemaphoreGive(self->adcMutex);
+    self->scheduleIdlePoll();
+    return;
+  }
+#endif
+
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    if (analogRead(self->channels[z].pin) >= self->channels[z].wakeRaw) {
+      self->signalOnset();
+      xSemaphoreGive(self->adcMutex);
+      xTaskNotifyGive(self->wakeTask);
+      return;
+    }
+  }
+  xSemaphoreGive(self->adcMutex);
+  self->scheduleIdlePoll();
+}
+
+bool SensorManager::armIdleWake() {
+  onsetDetected = false;
+#if AUDIO_IDLE_USE_MONITOR
+  if (streamRunning) return false;   // BatteryGuard nie zatrzymał strumienia
+  if (idleMonitor != NULL && adc_continuous_monitor_enable(idleMonitor) != ESP_OK) return false;
+#endif
+  idleArmed = true;
+  if (esp_timer_start_once(idlePollTimer, AUDIO_IDLE_POLL_US) == ESP_OK) return true;
+  idleArmed = false;
+#if AUDIO_IDLE_USE_MONITOR
+  if (idleMonitor != NULL) adc_continuous_monitor_disable(idleMonitor);
+#endif
+  return false;
+}
+
+// Okno w toku kończy się samo - mutex zwalniany jest dopiero po zatrzymaniu ADC
+void SensorManager::disarmIdleWake() {
+  idleArmed = false;
+  esp_timer_stop(idlePollTimer);
+  xSemaphoreTake(adcMutex, portMAX_DELAY);
+#if AUDIO_IDLE_USE_MONITOR
+  if (idleMonitor != NULL) adc_continuous_monitor_disable(idleMonitor);
+#endif
+  xSemaphoreGive(adcMutex);
+}
+
+// Usypia pętlę do przekroczenia progu audio, zdarzenia przycisku lub timeoutu.
+// W tym czasie CPU jest bezczynne poza oknami próbkowania (automatyczny
+// light sleep między oknami, jeśli włączony).
+// Zwraca true, gdy wybudził sygnał audio.
+bool SensorManager::idleUntilAudio(ConfigManager* config, uint32_t timeoutMs) {
+  prepareIdleWake(config);
+
+  int64_t idleStart = esp_timer_get_time();
+  if (!armIdleWake()) {
+    delay(10);
+    return false;
+  }
+
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+  disarmIdleWake();
+
+  int64_t wakeTime = esp_timer_get_time();
+  idleTimeUs += wakeTime - idleStart;
+  if (!onsetDetected) return false;
+
+  // Opóźnienie od przekroczenia progu do wznowienia pętli
+  lastWakeLatencyUs = (uint32_t)(wakeTime - onsetTime);
+  if (lastWakeLatencyUs > maxWakeLatencyUs) maxWakeLatencyUs = lastWakeLatencyUs;
+  audioWakeCount++;
+  lastAudioWake = millis();
+  return true;
+}
+
+void SensorManager::addDiagnostics(JsonObject diag) {
+  JsonArray zones = diag.createNestedArray("zones");
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    JsonObject zone = zones.createNestedObject();
+    zone["bias"] = channels[z].bias;
+    zone["envelope"] = channels[z].envelope;
+    zone["noiseFloor"] = channels[z].noiseFloor;
+    zone["floorValid"] = channels[z].noiseFloorValid;
+    zone["floorFrozen"] = channels[z].signalTime != 0;
+    zone["floorFrozenMs"] = channels[z].floorFrozenMs;
+    zone["trigger"] = channels[z].trigger;
+    zone["wakeRaw"] = channels[z].wakeRaw;
+  }
+  diag["idleMonitor"] = AUDIO_IDLE_USE_MONITOR ? "adc_monitor" : "esp_timer";
+  diag["idleWindows"] = idleWindows;
+  diag["adcStream"] = isAdcStreamRunning();
+  diag["audioWakes"] = audioWakeCount;
+  diag["lastWakeLatencyUs"] = lastWakeLatencyUs;
+  diag["maxWakeLatencyUs"] = maxWakeLatencyUs;
+  diag["idleTimeMs"] = (uint32_t)(idleTimeUs / 1000);
 }
@@ -2,23 +2,191 @@
 #define SENSOR_MANAGER_H
 
 #include <Arduino.h>
-#include <DallasTemperature.h>
+#include <ArduinoJson.h>
+#include <esp_idf_version.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <soc/soc_caps.h>
 #include "ConsoleLogger.h"
+#include "ConfigManager.h"
+#include "SensorSnapshot.h"
+#include "Zones.h"
+
+// Monitor progowy ADC (tryb ciągły) - ESP32-C3 z ESP-IDF >= 5.2. Przy kilku
+// strefach wybudzenie obsługuje komparator programowy na wszystkich wejściach.
+#if defined(SOC_ADC_MONITOR_SUPPORTED) && SOC_ADC_MONITOR_SUPPORTED && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0) && ZONE_COUNT == 1
+#define AUDIO_IDLE_USE_MONITOR 1
+#include <esp_adc/adc_continuous.h>
+#include <esp_adc/adc_monitor.h>
+#else
+#define AUDIO_IDLE_USE_MONITOR 0
+#endif
+
+// Wspólny strumień ADC w trybie ciągłym (wzorzec: wejście audio, akumulator).
+// Poza bezczynnością pracuje stale - pomiary z ramek DMA, monitor progu
+// dolnego na kanale akumulatora budzi BatteryGuard.
+#define BATT_USE_MONITOR AUDIO_IDLE_USE_MONITOR
+#define ADC_STREAM_FRAME_BYTES 160  // 40 konwersji - ramka co 2 ms przy AUDIO_IDLE_SAMPLE_HZ
+
+// Pomiar napięcia akumulatora
+#define BATT_ADC_MAX 4095
+#define BATT_DIVIDER_TOP 47        // kOhm
+#define BATT_DIVIDER_BOTTOM 12     // kOhm
+#define BATT_OVERSAMPLE 15         // próbek na pomiar, wielokrotność 3 (mediana z trójek)
+#define BATT_LUT_SHIFT 5           // węzły tablicy konwersji co 32 kody ADC
+#define BATT_LUT_POINTS ((BATT_ADC_MAX + 1) / (1 << BATT_LUT_SHIFT) + 1)
+#define BATT_FILTER_SHIFT 5        // filtr napięcia do wyświetlania, ~32 próbki BatteryGuard
+
+// Tor audio: usuwanie składowej stałej i śledzenie poziomu szumu
+#define AUDIO_ADC_VREF 3.3f              // V dla pełnej skali ADC
+#define AUDIO_DC_ALPHA 0.002f            // estymator biasu, ~5 s przy ~100 próbkach/s
+#define AUDIO_FLOOR_WINDOW_MS 2000       // podokno statystyki minimum
+#define AUDIO_FLOOR_WINDOWS 8            // podokien w historii (16 s)
+#define AUDIO_FLOOR_BIAS_COMP 1.5f       // minimum obwiedni zaniża średni szum
+#define AUDIO_FLOOR_MIN_TRIGGER 0.02f    // V, dolna granica progu w trybie szum + dB
+#define AUDIO_FLOOR_HOLDOFF_MS 2000      // statystyka wznawiana po tylu ms obwiedni poniżej progu
+#define AUDIO_WAKE_RAW_STEP 16           // kwantyzacja progu monitora (mniej rekonfiguracji)
+
+// Tryb bezczynności audio
+#define AUDIO_IDLE_TIMEOUT_MS 1000   // maks. czas uśpienia pętli bez zdarzeń
+#define AUDIO_WAKE_HOLD_MS 3000      // po wybudzeniu audio pętla pracuje normalnie
+#define AUDIO_IDLE_POLL_US 15000     // min. odstęp okien próbkowania - między nimi light sleep
+#define AUDIO_IDLE_POLL_JITTER_US 10000  // losowy dodatek - okno nie trafia stale w tę samą fazę basu
+#define AUDIO_IDLE_BURST_US 2000     // okno monitora ADC (blokada esp_pm sterownika ADC tylko w oknie)
+#define AUDIO_IDLE_SAMPLE_HZ 20000   // częstotliwość ADC w trybie ciągłym (cały wzorzec)
+
+// Tor audio jednej strefy: składowa stała, obwiednia i poziom szumu
+// (statystyka minimum obwiedni)
+struct AudioChannel {
+  int pin;
+  float envelope;
+  float bias;
+  float level;
+  float trigger;
+  float noiseFloor;
+  bool noiseFloorValid;
+  float floorWindowMin;
+  float floorMins[AUDIO_FLOOR_WINDOWS];
+  int floorCount;
+  int floorIndex;
+  unsigned long floorWindowStart;  // 0 = podokno do rozpoczęcia
+  unsigned long signalTime;        // ms, ostatnia obwiednia na progu lub wyżej
+  uint32_t floorFrozenMs;          // łączny czas wstrzymania statystyki
+  uint16_t wakeRaw;
+};
 
 class SensorManager {
 private:
-  DallasTemperature* sensors;
-  int audioPin;
   int batteryPin;
-  float filteredValue;
   float alpha;  // Współczynnik wygładzania
+  unsigned long audioTime;
+
+  AudioChannel channels[ZONE_COUNT];
+  float floorGainDb;
+  float floorGain;
+  void updateNoiseFloor(AudioChannel& channel, unsigned long now);
+  float computeTrigger(ConfigManager* config, AudioChannel& channel, int zone);
+
+  volatile uint16_t batteryMillivolts;   // ostatnia próbka
+  volatile uint32_t batteryFilter;       // mV << BATT_FILTER_SHIFT, 0 = brak próbki
+  volatile unsigned long batteryTime;
+  bool batteryCalibrated;
+
+  // Jeden przetwornik ADC1 dla audio i akumulatora. Jednoczesne analogRead()
+  // z pętli i zadania esp_timer kończy się błędem blokady sterownika oneshot
+  // i zerem zamiast pomiaru, dlatego każdy odczyt bierze ten mutex. Ten sam
+  // mutex chroni start i zatrzymanie strumienia ciągłego.
+  SemaphoreHandle_t adcMutex;
+  bool readAdc(int pin, TickType_t wait, uint16_t* raw);
+  void storeBatteryMillivolts(uint16_t millivolts);
+
+  // Węzły raw ADC -> mV akumulatora, liczone raz przy starcie; między
+  // węzłami interpolacja liniowa na liczbach całkowitych
+  uint16_t batteryLut[BATT_LUT_POINTS];
+  void buildBatteryLut();
+  uint16_t rawToMillivolts(uint16_t raw);
+  uint16_t millivoltsToRaw(uint16_t millivolts);
+  bool sampleBatteryRaw(uint16_t* raw);
+
+  // Tryb bezczynności - pętla śpi do przekroczenia progu audio. Próbkowanie
+  // w krótkich oknach z jednorazowego esp_timer, między oknami nic nie
+  // trzyma blokady esp_pm i automatyczny light sleep może wejść.
+  TaskHandle_t wakeTask;
+  esp_timer_handle_t idlePollTimer;
+  volatile bool idleArmed;
+  volatile bool onsetDetected;
+  volatile int64_t onsetTime;
+  unsigned long lastAudioWake;
+  uint32_t audioWakeCount;
+  uint32_t lastWakeLatencyUs;
+  uint32_t maxWakeLatencyUs;
+  uint64_t idleTimeUs;
+  uint32_t idleWindows;
+#if AUDIO_IDLE_USE_MONITOR
+  adc_continuous_handle_t adcStream;
+  adc_monitor_handle_t idleMonitor;
+  esp_timer_handle_t idleBurstTimer;
+  static bool IRAM_ATTR handleAudioMonitor(adc_monitor_handle_t monitor, const adc_monitor_evt_data_t* data, void* arg);
+  static void handleIdleBurstEnd(void* arg);
+
+  // Strumień poza bezczynnością: ostatnie próbki z ramek DMA (oneshot
+  // odrzucałby odczyty, gdy sterownik ciągły trzyma ADC1) i alarm akumulatora
+  bool streamRunning;
+  uint8_t streamAudioChannel;
+  uint8_t streamBatteryChannel;
+  volatile uint16_t streamAudioRaw;
+  volatile uint16_t streamBatteryRaw[3];   // mediana z trzech ostatnich
+  volatile uint8_t streamBatteryIndex;
+  adc_monitor_handle_t batteryMonitor;
+  uint16_t batteryAlertRaw;
+  bool batteryAlertEnabled;
+  volatile bool batteryAlertFired;
+  TaskHandle_t batteryAlertTask;
+  bool initAdcStream();
+  bool configureBatteryMonitor(uint16_t thresholdRaw);
+  bool enableBatteryAlert(bool enabled);
+  bool readStreamBattery(uint16_t* raw);
+  static bool IRAM_ATTR handleStreamFrame(adc_continuous_handle_t handle, const adc_continuous_evt_data_t* data, void* arg);
+  static bool IRAM_ATTR handleBatteryMonitor(adc_monitor_handle_t monitor, const adc_monitor_evt_data_t* data, void* arg);
+#endif
+  static void handleIdlePoll(void* arg);
+  void scheduleIdlePoll();
+  void signalOnset();
+  uint16_t audioWakeRaw(const AudioChannel& channel, float trigger);
+  bool armIdleWake();
+  void disarmIdleWake();
 
 public:
   SensorManager();
-  void init(DallasTemperature* sensors, int audioPin, int batteryPin);
-  bool readAudio(float threshold, ConsoleLogger* logger, bool uartActive);
-  bool readBattery(float threshold);
-  float getFilteredAudio() { return filteredValue; }
+  void init(const ZonePins* zonePins, int batteryPin);
+  bool readAudio(ConfigManager* config, ConsoleLogger* logger, bool uartActive);
+  bool processAudio(ConfigManager* config, int zone, float sample);
+  bool readBattery();
+  bool readBatteryMillivoltsFast(uint16_t* millivolts);
+  bool startBatteryMonitor(uint16_t thresholdMv, TaskHandle_t task);
+  void stopBatteryMonitor();
+  void setBatteryAlert(uint16_t thresholdMv, bool enabled);
+#if AUDIO_IDLE_USE_MONITOR
+  bool isAdcStreamRunning() { return streamRunning; }
+#else
+  bool isAdcStreamRunning() { return false; }
+#endif
+  float getFilteredAudio(int zone = 0) { return channels[zone].envelope; }
+  float getAudioBias(int zone = 0) { return channels[zone].bias; }
+  float getNoiseFloor(int zone = 0) { return channels[zone].noiseFloor; }
+  float getAudioTrigger(int zone = 0) { return channels[zone].trigger; }
+  float getBatteryVoltage() { return (batteryFilter >> BATT_FILTER_SHIFT) / 1000.0f; }
+  uint16_t getBatteryMillivolts() { return batteryMillivolts; }
+  bool isBatteryCalibrated() { return batteryCalibrated; }
+  void fillSnapshot(SensorSnapshot& snapshot);
+
+  void prepareIdleWake(ConfigManager* config);
+  bool isIdleAllowed() { return millis() - lastAudioWake >= AUDIO_WAKE_HOLD_MS; }
+  bool idleUntilAudio(ConfigManager* config, uint32_t timeoutMs);
+  TaskHandle_t getWakeTask() { return wakeTask; }
+  void addDiagnostics(JsonObject diag);
 };
 
 #endif
@@ -0,0 +1,90 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "Zones.h"
+
+#define TEMP_MAX_SENSORS 8
+
+// Odczyt jednego czujnika temperatury
+struct TempSensorSnapshot {
+  float celsius;                   // C, DEVICE_DISCONNECTED_C = brak odczytu
+  unsigned long readTime;          // ms, 0 = brak odczytu
+};
+
+// Stan jednej strefy
+struct ZoneSnapshot {
+  float audioEnvelope;             // V, obwiednia po usunięciu składowej stałej
+  float audioFloor;                // V, śledzony poziom szumu
+  float audioTrigger;              // V, bieżący próg detekcji
+  float temperature;               // C
+  bool temperatureValid;
+  bool relaysActive;
+  bool relaysIdle;
+  bool relaysPreArmed;             // przetwornica włączona z wyprzedzeniem
+  long timeRemaining;              // s do wyłączenia, -1 gdy przekaźniki nieaktywne
+  long timeToLimit;                // s do tempMax wg modelu cieplnego, -1 = brak prognozy
+  float fanDuty;                   // 0..1
+  float fanRpm;                    // obr/min, -1 = brak tachometru
+};
+
+// Stan czujników i przekaźników publikowany raz na iterację pętli.
+// Konsumenci (HTTP, UART, logger) czytają go bez dostępu do sprzętu.
+struct SensorSnapshot {
+  unsigned long timestamp;         // ms, moment publikacji
+  float batteryVoltage;            // V
+  unsigned long batteryTime;       // ms
+  unsigned long audioTime;         // ms
+  unsigned long temperatureTime;   // ms, 0 = brak odczytu
+  ZoneSnapshot zones[ZONE_COUNT];
+  uint8_t tempSensorCount;
+  TempSensorSnapshot tempSensors[TEMP_MAX_SENSORS];
+};
+
+// Podwójny bufor z licznikiem sekwencji (seqlock). Licznik jest nieparzysty
+// w trakcie zapisu; pisarz (pętla sterowania) zapisuje zawsze kopię inną niż
+// ostatnio opublikowana. Czytelnik kopiuje ostatnią opublikowaną i ponawia
+// odczyt, gdy w międzyczasie pisarz zaczął zapisywać właśnie ją - czyli
+// najwcześniej przy drugiej publikacji. Czytelnik, który przerwał zapis (inne
+// zadanie albo drugi rdzeń), czyta poprzednią kopię i nie czeka na pisarza.
+class SnapshotBuffer {
+private:
+  SensorSnapshot buffers[2];
+  std::atomic<uint32_t> sequence;    // 2 * publikacje, +1 w trakcie zapisu
+
+public:
+  SnapshotBuffer() : sequence(0) {
+    memset(buffers, 0, sizeof(buffers));
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      buffers[0].zones[z].timeRemaining = -1;
+      buffers[1].zones[z].timeRemaining = -1;
+      buffers[0].zones[z].timeToLimit = -1;
+      buffers[1].zones[z].timeToLimit = -1;
+    }
+  }
+
+  void publish(const SensorSnapshot& snapshot) {
+    uint32_t published = sequence.load(std::memory_order_relaxed);
+    sequence.store(published + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    buffers[((published >> 1) + 1) & 1] = snapshot;
+    sequence.store(published + 2, std::memory_order_release);
+  }
+
+  void read(SensorSnapshot& out) const {
+    uint32_t before;
+    uint32_t after;
+    do {
+      before = sequence.load(std::memory_order_acquire);
+      out = buffers[(before >> 1) & 1];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence.load(std::memory_order_relaxed);
+      // Zapis do odczytanej kopii zaczyna się przy liczniku (before & ~1) + 3
+    } while (after - (before & ~1u) >= 3);
+  }
+
+  uint32_t getSequence() const { return sequence.load(std::memory_order_acquire) >> 1; }
+};
+
+#endif
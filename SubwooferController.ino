@@ -4,11 +4,8 @@
  */
 
 #include <EEPROM.h>
-#include <OneWire.h>
-#include <DallasTemperature.h>
 #include <math.h>
 #include <WiFi.h>
-#include <WebServer.h>
 #include <ArduinoJson.h>
 
 #include "ConsoleLogger.h"
@@ -17,6 +14,19 @@
 #include "RelayController.h"
 #include "SubwooferWebServer.h"
 #include "UartManager.h"
+#include "Benchmark.h"
+#include "HeapMonitor.h"
+#include "ButtonManager.h"
+#include "SensorSnapshot.h"
+#include "BatteryGuard.h"
+#include "PowerManager.h"
+#include "AudioGate.h"
+#include "HoldTimeLearner.h"
+#include "TemperatureManager.h"
+#include "ThermalModel.h"
+#include "FanController.h"
+#include "WifiManager.h"
+#include "Zones.h"
 
 // Piny
 #define WENTYLATOR_PIN 0  // GPIO0
@@ -28,35 +38,83 @@
 #define PRZYCISK_PIN 4    // GPIO4
 #define ONE_WIRE_BUS 2    // GPIO2
 
-// Czujnik temperatury
-OneWire oneWire(ONE_WIRE_BUS);
-DallasTemperature sensors(&oneWire);
+// Strefy: wejście audio, przetwornica, głośnik, wentylator. Piny stref 1..2
+// zależą od płytki - podaj je flagą kompilacji, np.
+// -DZONE_COUNT=2 -DZONE1_PINS="{ 5, 6, 7, 21 }". Czujnik DS18B20 strefy
+// przypisywany jest po adresie ROM (komenda tempsensor), nie po kolejności.
+// Tachometry wentylatorów stref, -1 = brak (wypełnienie prosto z krzywej)
+#ifndef ZONE0_TACH_PIN
+#define ZONE0_TACH_PIN -1
+#endif
+#ifndef ZONE1_TACH_PIN
+#define ZONE1_TACH_PIN -1
+#endif
+#ifndef ZONE2_TACH_PIN
+#define ZONE2_TACH_PIN -1
+#endif
+
+static const int zoneTachPins[ZONE_MAX] = { ZONE0_TACH_PIN, ZONE1_TACH_PIN, ZONE2_TACH_PIN };
+
+#if ZONE_COUNT > 1 && !defined(ZONE1_PINS)
+#error "Zdefiniuj ZONE1_PINS dla ZONE_COUNT > 1"
+#endif
+#if ZONE_COUNT > 2 && !defined(ZONE2_PINS)
+#error "Zdefiniuj ZONE2_PINS dla ZONE_COUNT > 2"
+#endif
+
+static const ZonePins zonePins[ZONE_COUNT] = {
+  { AUDIO_SIG, ZASILANIE_PIN, GLOSNIK_PIN, WENTYLATOR_PIN },
+#if ZONE_COUNT > 1
+  ZONE1_PINS,
+#endif
+#if ZONE_COUNT > 2
+  ZONE2_PINS,
+#endif
+};
+
+// Czujnik temperatury - sterownik magistrali wybiera ONEWIRE_USE_RMT (OneWireBus.h)
+OneWireBus oneWire(ONE_WIRE_BUS);
 
 // Instancje klas
 ConsoleLogger logger;
 ConfigManager configManager;
 SensorManager sensorManager;
-RelayController relayController;
+RelayController relayControllers[ZONE_COUNT];
+WifiManager wifiManager;
 SubwooferWebServer webServer;
 UartManager uartManager;
+BenchmarkRunner benchmark;
+HeapMonitor heapMonitor;
+ButtonManager buttonManager;
+SnapshotBuffer sensorSnapshot;
+BatteryGuard batteryGuard;
+PowerManager powerManager;
+AudioGate audioGates[ZONE_COUNT];
+HoldTimeLearner holdTimeLearner;
+TemperatureManager temperatureManager;
+ThermalModel thermalModels[ZONE_COUNT];
+FanController fanControllers[ZONE_COUNT];
 
 // Zmienne globalne
-unsigned long lastAudioDetected = 0;
-bool przyciskTrzymany = false;
-unsigned long przyciskStart = 0;
+unsigned long lastAudioDetected[ZONE_COUNT] = {};
+bool chlodzenieAwaryjne[ZONE_COUNT] = {};   // strefa czeka na spadek do tempSave
 
 void setup() {
   // Konfiguracja pinów
   pinMode(LED_PIN, OUTPUT);
-  pinMode(WENTYLATOR_PIN, OUTPUT);
-  pinMode(GLOSNIK_PIN, OUTPUT);
-  pinMode(ZASILANIE_PIN, OUTPUT);
   pinMode(BATT_SIG, INPUT);
-  pinMode(AUDIO_SIG, INPUT);
-  pinMode(PRZYCISK_PIN, INPUT_PULLUP);
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    pinMode(zonePins[z].fan, OUTPUT);
+    pinMode(zonePins[z].speaker, OUTPUT);
+    pinMode(zonePins[z].power, OUTPUT);
+    pinMode(zonePins[z].audio, INPUT);
+
+    digitalWrite(zonePins[z].power, LOW);
+    digitalWrite(zonePins[z].speaker, LOW);
+  }
 
-  digitalWrite(ZASILANIE_PIN, LOW);
-  digitalWrite(GLOSNIK_PIN, LOW);
+  // Monitor sterty - rejestruje zadanie loop() do przypisywania alokacji
+  heapMonitor.init();
 
   // Inicjalizacja UART
   Serial.begin(115200);
@@ -67,21 +125,71 @@ void setup() {
   logger.addLog("SYSTEM", "info", "Inicjalizacja systemu...");
 
   // Inicjalizacja czujników
-  sensors.begin();
-  delay(500);
-  sensors.requestTemperatures();
-  sensorManager.init(&sensors, AUDIO_SIG, BATT_SIG);
+  sensorManager.init(zonePins, BATT_SIG);
 
   // Inicjalizacja EEPROM
-  EEPROM.begin(64);
+  EEPROM.begin(EEPROM_SIZE);
   configManager.init(&EEPROM, &logger);
   configManager.loadSettings();
 
+  // Czujniki temperatury po konfiguracji - role wg przypisanych adresów ROM
+  temperatureManager.init(&oneWire, &configManager, &logger);
+  sensorManager.prepareIdleWake(&configManager);
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    audioGates[z].init(&configManager);
+  }
+  holdTimeLearner.init(&configManager, &logger, &EEPROM);
+
+  // Przycisk - przerwanie GPIO + timery antydrgań/długiego przytrzymania
+  buttonManager.init(PRZYCISK_PIN);
+  buttonManager.setWakeTask(sensorManager.getWakeTask());
+
+  // Zegar LEDC niezależny od DFS - przed pierwszym ledcAttach()
+  PowerManager::selectPwmClock(&logger);
+
+  // Wentylatory stref - PWM, krzywa i opcjonalny tachometr. Przed
+  // przekaźnikami, żeby ekonomizer cewek nie zajął ich kanałów LEDC.
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    fanControllers[z].init(zonePins[z].fan, zoneTachPins[z], z, &configManager, &logger);
+  }
+
   // Inicjalizacja kontrolera przekaźników
-  relayController.init(ZASILANIE_PIN, GLOSNIK_PIN, &configManager, &logger);
+  // Piny w kolejności RelayOutput - kroki sekwencji w RelaySequence.h
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    const int relayPins[RELAY_OUTPUT_COUNT] = { zonePins[z].power, zonePins[z].speaker };
+    relayControllers[z].init(relayPins, z, &configManager, &logger);
+  }
 
-  // Inicjalizacja serwera WWW - przekazujemy pin baterii
-  webServer.init(&configManager, &logger, &relayController, &sensorManager, BATT_SIG);
+  // Ochrona przed rozładowaniem akumulatora (próbkowanie co 2 ms w esp_timer)
+  batteryGuard.init(&sensorManager, relayControllers, &configManager, &logger);
+
+  // Access Point sterowany zdarzeniami WiFi, serwer WWW czyta dane ze snapshotu
+  wifiManager.init(&logger);
+  webServer.init(&configManager, &logger, &wifiManager, relayControllers, &sensorManager, &heapMonitor, &batteryGuard, &sensorSnapshot);
+
+  // Benchmark ścieżek krytycznych (komenda UART: BENCH)
+  benchmark.init(&logger, &configManager, &sensorManager, &webServer, &uartManager);
+  uartManager.setBenchmark(&benchmark);
+  uartManager.setHeapMonitor(&heapMonitor);
+  uartManager.setRelayControllers(relayControllers);
+  uartManager.setSnapshot(&sensorSnapshot);
+  uartManager.setBatteryGuard(&batteryGuard);
+
+  // DFS + light sleep; blokady wydajności tylko przy sekwencji, klientach AP i UART
+  powerManager.init(relayControllers, &webServer, &uartManager, &buttonManager, &logger);
+  webServer.setPowerManager(&powerManager);
+  uartManager.setPowerManager(&powerManager);
+  webServer.setAudioGates(audioGates);
+  uartManager.setAudioGates(audioGates);
+  webServer.setHoldTimeLearner(&holdTimeLearner);
+  uartManager.setHoldTimeLearner(&holdTimeLearner);
+  webServer.setTemperatureManager(&temperatureManager);
+  uartManager.setTemperatureManager(&temperatureManager);
+  webServer.setThermalModels(thermalModels);
+  uartManager.setThermalModels(thermalModels);
+  webServer.setFanControllers(fanControllers);
+  uartManager.setFanControllers(fanControllers);
+  uartManager.setWifiManager(&wifiManager);
 
   delay(500);
 
@@ -89,10 +197,10 @@ void setup() {
   Serial.println("\n\n\n\n");
   Serial.println("ESP32C3 sterownik Subwoofera - pomiar audio, napiecia akumulatora, temperatury, przekaźników.");
   Serial.print("Nazwa sieci: ");
-  Serial.print(webServer.getNazwaWifi());
+  Serial.print(wifiManager.getNazwaWifi());
   Serial.print("\t");
   Serial.print("Hasło: ");
-  Serial.print(webServer.getHasloWifi());
+  Serial.print(wifiManager.getHasloWifi());
   Serial.print("\t");
   Serial.print("AP IP address: ");
   Serial.println(WiFi.softAPIP());
@@ -101,149 +209,269 @@ void setup() {
   
   logger.addLog("SYSTEM", "success", "System gotowy do pracy");
 
-  // Inicjalizacja PWM dla wentylatora
+  // PWM diody LED
   ledcAttach(LED_PIN, 5000, 8);
   ledcWrite(LED_PIN, 200);
 }
 
-void loop() {
-  // Obsługa sekwencji przekaźników
-  relayController.handleSequences();
-  
-  // Obsługa serwera WWW
-  webServer.handleClient();
-  
-  // Obsługa UART
-  uartManager.checkTimeout();
-  if (uartManager.isActive()) {
-    uartManager.parseCommands(&configManager);
+// Publikacja stanu czujników i przekaźników dla serwera WWW i UART
+void publishSnapshot() {
+  SensorSnapshot snapshot;
+  sensorManager.fillSnapshot(snapshot);
+  temperatureManager.fillSnapshot(snapshot);
+  snapshot.timestamp = millis();
+
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    ZoneSnapshot& zone = snapshot.zones[z];
+    zone.relaysActive = relayControllers[z].isActive();
+    zone.relaysIdle = relayControllers[z].isIdle();
+    zone.relaysPreArmed = relayControllers[z].isPreArmed();
+    zone.timeRemaining = -1;
+    zone.timeToLimit = thermalModels[z].getTimeToLimit();
+    zone.fanDuty = fanControllers[z].getDuty();
+    zone.fanRpm = fanControllers[z].hasTach() ? fanControllers[z].getRpm() : -1;
+
+    if (zone.relaysActive) {
+      unsigned long elapsedTime = (snapshot.timestamp - lastAudioDetected[z]) / 1000;  // w sekundach
+      long timeRemaining = (long)holdTimeLearner.getHoldSeconds() - (long)elapsedTime;
+      zone.timeRemaining = max(0L, timeRemaining);
+    }
   }
 
-  // Odczyt czujników
-  bool napiecieOk = sensorManager.readBattery(configManager.getProgNapiecia());
-  bool audioDetected = sensorManager.readAudio(configManager.getAudioThreshold(), &logger, uartManager.isActive());
+  sensorSnapshot.publish(snapshot);
+}
 
-  unsigned long currentTime = millis();
+// Temperatura strefy: wentylator, ostrzeżenia i chłodzenie awaryjne.
+// Chłodzenie nie blokuje pętli - pozostałe strefy pracują dalej, a strefa
+// nie wystartuje, dopóki temperatura nie spadnie do tempSave. Model cieplny
+// podkręca wentylator z wyprzedzeniem i decyduje, czy wyłączenie jest
+// nieuniknione. Brak odczytu to osobny stan awarii czujnika: pełny
+// wentylator, bez blokady strefy (chłodzenia nie da się wtedy zakończyć).
+void handleZoneTemperature(int z) {
+  static bool awariaCzujnika[ZONE_COUNT] = {};
+  static bool ponadLimitem[ZONE_COUNT] = {};
+  float temp = temperatureManager.getZoneTemperature(z);
+  float tempMax = configManager.getTempMax(z);
+
+  if (temp == DEVICE_DISCONNECTED_C) {
+    fanControllers[z].setDemand(1.0f, true);
+    ponadLimitem[z] = false;
+    if (chlodzenieAwaryjne[z]) {
+      chlodzenieAwaryjne[z] = false;
+      logger.addLog("TEMPERATURE", "warning", "Chłodzenie strefy %d przerwane - brak odczytu czujnika", z);
+    }
+    if (!awariaCzujnika[z]) {
+      if (uartManager.isActive()) Serial.println("Błąd odczytu temp.");
+      logger.addLog("TEMPERATURE", "error", "Błąd odczytu czujnika temperatury strefy %d - pełny wentylator", z);
+      awariaCzujnika[z] = true;
+    }
+    return;
+  }
+  if (awariaCzujnika[z]) {
+    logger.addLog("TEMPERATURE", "success", "Czujnik strefy %d znów odpowiada: %.1f°C", z, temp);
+    awariaCzujnika[z] = false;
+  }
 
-  // Logika sterowania
-  if (napiecieOk) {
-    if (audioDetected) {
-      lastAudioDetected = currentTime;
-      if (!relayController.isActive() && relayController.isIdle()) {
-        relayController.startupSequence();
-      }
+  thermalModels[z].update(temp, tempMax, relayControllers[z].isActive(), fanControllers[z].getDuty());
+
+  if (chlodzenieAwaryjne[z]) {
+    fanControllers[z].setDemand(1.0f, true);
+    if (temp < configManager.getTempSave(z)) {
+      chlodzenieAwaryjne[z] = false;
+      logger.addLog("TEMPERATURE", "success", "Chłodzenie strefy %d zakończone - temp: %.1f°C", z, temp);
     }
+    return;
+  }
+
+  // Sterowanie wentylatorem - krzywa, podniesiona, gdy model przewiduje
+  // osiągnięcie tempMax przed THERMAL_HORIZON_S. Także przy wyłączonym
+  // wzmacniaczu, żeby wentylator zwalniał razem ze stygnącym radiatorem.
+  fanControllers[z].setDemand(thermalModels[z].requiredFan(temp, tempMax, fanControllers[z].curve(temp)));
+
+  if (!relayControllers[z].isActive()) return;
+
+  if (uartManager.isActive()) {
+    Serial.printf("Temp[%d]: ", z);
+    Serial.println(temp);
+  }
 
-    if (relayController.isActive() && relayController.isIdle() && 
-        (currentTime - lastAudioDetected >= configManager.getCzasPoSyg() * 1000UL)) {
-      if (uartManager.isActive()) Serial.println("Brak aktywności – wyłączanie.");
-      logger.addLog("TIMEOUT", "info", "Brak aktywności przez " + String(configManager.getCzasPoSyg()) + "s");
-      relayController.shutdownSequence();
-      Serial.println();
-      uartManager.showCommands();
+  // Ostrzeżenia temperaturowe
+  if (temp >= configManager.getTempPrzegrzania(z) && temp < tempMax) {
+    logger.addLog("TEMPERATURE", "warning", "Temperatura ostrzegawcza strefy %d: %.1f°C", z, temp);
+  }
+
+  // Temperatura krytyczna - tempMax zawsze wyłącza, chyba że ustawiono
+  // zapas overshoot, a model przewiduje spadek przy pełnym wentylatorze
+  ThermalVerdict ocena = thermalModels[z].evaluate(temp, tempMax, configManager.getTempOvershoot());
+  if (ocena == THERMAL_SHUTDOWN) {
+    if (uartManager.isActive()) Serial.println("Temp krytyczna – chłodzenie");
+    logger.addLog("TEMPERATURE", "error", "Temperatura krytyczna strefy %d: %.1f°C (ustalona %.1f°C) - wymuszenie chłodzenia",
+                  z, temp, thermalModels[z].steadyState(1.0f));
+    relayControllers[z].shutdownSequence();
+    chlodzenieAwaryjne[z] = true;
+    fanControllers[z].setDemand(1.0f, true);
+  } else if (ocena == THERMAL_RIDE) {
+    if (!ponadLimitem[z]) {
+      logger.addLog("TEMPERATURE", "warning", "Strefa %d powyżej tempMax: %.1f°C - pełny wentylator, prognoza spadku", z, temp);
     }
+    fanControllers[z].setDemand(1.0f, true);
+  }
+  ponadLimitem[z] = ocena == THERMAL_RIDE;
+}
 
-    if (relayController.isActive()) {
-      // Obsługa temperatury
-      sensors.requestTemperatures();
-      float temp = sensors.getTempCByIndex(0);
+// Logika sterowania strefy przy poprawnym napięciu
+void handleZone(int z, bool audioDetected, bool preArmZadanie, unsigned long currentTime, unsigned long czasPodtrzymania) {
+  RelayController& relays = relayControllers[z];
 
-      if (temp != DEVICE_DISCONNECTED_C) {
-        if (uartManager.isActive()) {
-          Serial.print("Temp: ");
-          Serial.println(temp);
-        }
+  // Narastający sygnał - przetwornica z wyprzedzeniem, głośnik dopiero po potwierdzeniu
+  if (preArmZadanie && !audioDetected && !chlodzenieAwaryjne[z]) {
+    relays.preArm();
+  }
 
-        // Sterowanie wentylatorem
-        int pwm = constrain(map(temp, configManager.getTempMin(), configManager.getTempMax(), 0, 255), 0, 255);
-        ledcWrite(WENTYLATOR_PIN, pwm);
+  if (audioDetected) {
+    lastAudioDetected[z] = currentTime;
+    if (relays.canStart() && !chlodzenieAwaryjne[z]) {
+      relays.startupSequence();
+    }
+  }
 
-        // Ostrzeżenia temperaturowe
-        if (temp >= configManager.getTempPrzegrzania() && temp < configManager.getTempMax()) {
-          logger.addLog("TEMPERATURE", "warning", "Temperatura ostrzegawcza: " + String(temp, 1) + "°C");
-        }
+  if (relays.isActive() && relays.isIdle() &&
+      (currentTime - lastAudioDetected[z] >= czasPodtrzymania * 1000UL)) {
+    if (uartManager.isActive()) Serial.println("Brak aktywności – wyłączanie.");
+    logger.addLog("TIMEOUT", "info", "Brak aktywności w strefie %d przez %lus", z, czasPodtrzymania);
+    relays.shutdownSequence();
+    Serial.println();
+    uartManager.showCommands();
+  }
+}
 
-        // Temperatura krytyczna
-        if (temp >= configManager.getTempMax()) {
-          if (uartManager.isActive()) Serial.println("Temp krytyczna – chłodzenie");
-          logger.addLog("TEMPERATURE", "error", "Temperatura krytyczna: " + String(temp, 1) + "°C - wymuszenie chłodzenia");
-          relayController.shutdownSequence();
-          
-          // Chłodzenie awaryjne
-          while (temp >= configManager.getTempSave()) {
-            sensors.requestTemperatures();
-            temp = sensors.getTempCByIndex(0);
-            ledcWrite(WENTYLATOR_PIN, 255);
-            delay(200);
-          }
-          logger.addLog("TEMPERATURE", "success", "Chłodzenie zakończone - temp: " + String(temp, 1) + "°C");
-        }
-      } else if (uartManager.isActive()) {
-        static int i = 0;
-        if (i == 0) {
-          Serial.println("Błąd odczytu temp.");
-          logger.addLog("TEMPERATURE", "error", "Błąd odczytu czujnika temperatury");
-          i = 1;
+void loop() {
+  heapMonitor.beginLoop();
+
+  // Obsługa zdarzeń przycisku (wykrywane w przerwaniu i timerach esp_timer)
+  ButtonEvent zdarzenie;
+  while (buttonManager.getEvent(zdarzenie)) {
+    if (zdarzenie.type == BUTTON_LONG_PRESS) {
+      // Długie przytrzymanie (4 sekundy)
+      Serial.println("Przycisk przytrzymany 4s – ponowne uruchomienie UART i WiFi");
+      logger.addLog("BUTTON", "info", "Przycisk przytrzymany 4s - restart serwisów");
+
+      // Restart obsługi UART
+      uartManager.activate();
+      logger.addLog("UART", "success", "UART ponownie aktywowany");
+
+      // Restart obsługi WiFi
+      webServer.activate();
+      logger.addLog("WIFI", "success", "WiFi AP ponownie aktywowany");
+    } else {
+      // Krótkie naciśnięcie (poniżej 1 sekundy) = kliknięcie
+      Serial.println("Przycisk kliknięty - uruchamiam sekwencję");
+      logger.addLog("BUTTON", "info", "Przycisk kliknięty - uruchomienie sekwencji");
+
+      // Uruchomienie sekwencji we wszystkich strefach - restart timera podtrzymania
+      for (int z = 0; z < ZONE_COUNT; z++) {
+        lastAudioDetected[z] = millis();
+        if (relayControllers[z].canStart() && !chlodzenieAwaryjne[z]) {
+          relayControllers[z].startupSequence();
         }
       }
     }
-  } else {
-    // Zbyt niskie napięcie
-    if (relayController.isActive()) {
-      if (uartManager.isActive()) Serial.println("Zbyt niskie napięcie – wyłączam.");
-      relayController.shutdownSequence();
+  }
+  
+  // Logowanie sekwencji przekaźników (przełączenia wykonuje esp_timer)
+  {
+    HeapScope heapScope(HEAP_SYS_RELAYS);
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      relayControllers[z].handleSequences();
+    }
+  }
+  
+  // Obsługa serwera WWW - tylko przy podłączonych klientach AP
+  wifiManager.update();
+  webServer.handleClient();
+  
+  // Obsługa UART
+  {
+    HeapScope heapScope(HEAP_SYS_UART);
+    uartManager.checkTimeout();
+    if (uartManager.isActive()) {
+      uartManager.parseCommands(&configManager);
     }
   }
 
-  // Obsługa krótkiego i długiego naciśnięcia przycisku
-  bool przyciskAktualny = (digitalRead(PRZYCISK_PIN) == LOW);
-  unsigned long teraz = millis();
-
-  // Obsługa wciśnięcia przycisku
-  if (przyciskAktualny && !przyciskTrzymany) {
-    // Początek naciśnięcia przycisku
-    przyciskStart = teraz;
-    przyciskTrzymany = true;
-  } 
-  // Obsługa długiego przytrzymania (4 sekundy)
-  else if (przyciskAktualny && przyciskTrzymany && (teraz - przyciskStart >= 4000)) {
-    Serial.println("Przycisk przytrzymany 4s – ponowne uruchomienie UART i WiFi");
-    logger.addLog("BUTTON", "info", "Przycisk przytrzymany 4s - restart serwisów");
-
-    // Restart obsługi UART
-    uartManager.activate();
-    logger.addLog("UART", "success", "UART ponownie aktywowany");
-
-    // Restart obsługi WiFi
-    webServer.activate();
-    logger.addLog("WIFI", "success", "WiFi AP ponownie aktywowany");
-
-    for (int i = 0; i < 10; i++) {
-      analogRead(AUDIO_SIG);
-      delay(20);
+  // Odczyt czujników - wszystkie strefy w jednym przebiegu
+  bool napiecieOk;
+  bool audioDetected[ZONE_COUNT];
+  bool preArmZadanie[ZONE_COUNT];
+  bool nowaTemperatura;
+  bool anyActive = false;
+  {
+    HeapScope heapScope(HEAP_SYS_SENSORS);
+    batteryGuard.handleEvents();
+    napiecieOk = batteryGuard.isBatteryOk();
+    sensorManager.readAudio(&configManager, &logger, uartManager.isActive());
+
+    // Czas podtrzymania uczony jest ze wspólnych przerw - sygnał w dowolnej strefie
+    bool anyOpen = false;
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      bool active = relayControllers[z].isActive();
+      audioDetected[z] = audioGates[z].update(sensorManager.getFilteredAudio(z), sensorManager.getAudioTrigger(z), active);
+      preArmZadanie[z] = audioGates[z].takePreArmRequest();
+      if (audioDetected[z]) anyOpen = true;
+      if (active) anyActive = true;
     }
+    holdTimeLearner.update(anyOpen, anyActive);
+    nowaTemperatura = temperatureManager.update();
+  }
 
-    // Reset stanu przycisku po wykonaniu akcji
-    przyciskTrzymany = false;
-  } 
-  // Obsługa zwolnienia przycisku (krótkie naciśnięcie)
-  else if (!przyciskAktualny && przyciskTrzymany) {
-    // Przycisk został zwolniony
-    if (teraz - przyciskStart < 1000) {  // Krótsze niż 1 sekunda = kliknięcie
-      Serial.println("Przycisk kliknięty - uruchamiam sekwencję");
-      logger.addLog("BUTTON", "info", "Przycisk kliknięty - uruchomienie sekwencji");
-      
-      // Uruchomienie sekwencji - restart timera podtrzymania
-      lastAudioDetected = teraz;
-      
-      // Uruchomienie sekwencji jeśli system jest nieaktywny
-      if (!relayController.isActive() && relayController.isIdle()) {
-        relayController.startupSequence();
+  unsigned long currentTime = millis();
+  unsigned long czasPodtrzymania = holdTimeLearner.getHoldSeconds();  // stały albo wyuczony
+
+  // Logika sterowania
+  if (napiecieOk) {
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      handleZone(z, audioDetected[z], preArmZadanie[z], currentTime, czasPodtrzymania);
+    }
+  } else {
+    // Zbyt niskie napięcie
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      if (relayControllers[z].isActive()) {
+        if (uartManager.isActive()) Serial.println("Zbyt niskie napięcie – wyłączam.");
+        relayControllers[z].shutdownSequence();
       }
     }
-    // Reset stanu przycisku
-    przyciskTrzymany = false;
   }
-  
-  delay(10);
+
+  // Nowy cykl pomiaru albo jego brak dłużej niż TEMP_MAX_AGE_MS (magistrala
+  // bez czujników) - strefa bez ważnego odczytu przechodzi w stan awarii
+  static unsigned long ostatniaKontrolaTemp = 0;
+  if (nowaTemperatura || currentTime - ostatniaKontrolaTemp >= TEMP_MAX_AGE_MS) {
+    ostatniaKontrolaTemp = currentTime;
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      handleZoneTemperature(z);
+    }
+  }
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    fanControllers[z].update();
+  }
+
+  publishSnapshot();
+  powerManager.update();
+
+  heapMonitor.endLoop();
+
+  // Bezczynność: przekaźniki wszystkich stref wyłączone, brak chłodzenia,
+  // AP i UART nieaktywne - pętla śpi do przekroczenia progu audio przez
+  // monitor ADC albo zdarzenia przycisku
+  bool allIdle = true;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    if (relayControllers[z].isActive() || !relayControllers[z].isIdle() || chlodzenieAwaryjne[z]) allIdle = false;
+  }
+  if (allIdle && !webServer.isActive() && !uartManager.isActive() && sensorManager.isIdleAllowed()) {
+    batteryGuard.suspend();
+    sensorManager.idleUntilAudio(&configManager, AUDIO_IDLE_TIMEOUT_MS);
+    batteryGuard.resume();
+  } else {
+    delay(10);
+  }
 }
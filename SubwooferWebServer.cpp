@@ -1,177 +1,159 @@
 #include "SubwooferWebServer.h"
 #include <ArduinoJson.h>
 #include <DNSServer.h>
+#include "PowerManager.h"
+#include "AudioGate.h"
+#include "HoldTimeLearner.h"
+#include "TemperatureManager.h"
+#include "ThermalModel.h"
+#include "FanController.h"
+
+// Adres panelu podawany sondom - domyślny IP softAP. Sondy nie podążają za
+// przekierowaniem, a ścieżka względna nie wskazuje hosta (captive.apple.com itd.)
+#define PORTAL_URL "http://192.168.4.1/"
+
+// Odpowiedzi na sondy łączności - stałe we flashu, bez budowania panelu.
+// Android, Windows i Firefox otwierają portal po 302 bez treści. iOS/macOS
+// oczekuje strony "Success" - każda inna otwiera arkusz, który przez
+// odświeżenie przechodzi dopiero do panelu.
+static const char PROBE_APPLE_HTML[] PROGMEM = "<meta http-equiv=refresh content=0;url=" PORTAL_URL ">";
 
 // Deklaracje zewnętrznych zmiennych
-extern unsigned long lastAudioDetected;
-extern DallasTemperature sensors;
-
-// Serwer DNS (globalnie w pliku)
-DNSServer dnsServer;
+extern unsigned long lastAudioDetected[ZONE_COUNT];
 
 SubwooferWebServer::SubwooferWebServer()
   : server(80),
-    active(true),
-    startTime(0),
-    connectedClients(0),
-    batteryPin(0) {
-}
-
-void SubwooferWebServer::init(ConfigManager* config, ConsoleLogger* logger, RelayController* relayController, SensorManager* sensorManager, int batteryPin) {
+    powerManager(nullptr),
+    audioGates(nullptr),
+    holdTimeLearner(nullptr),
+    temperatureManager(nullptr),
+    thermalModels(nullptr),
+    fanControllers(nullptr),
+    portalRedirects(0),
+    notFoundRejected(0),
+    rootPages(0),
+    restartAt(0) {
+  memset(probeCount, 0, sizeof(probeCount));
+}
+
+// Trasy rejestrowane raz - kolejne włączenia AP (activate()) tylko
+// uruchamiają WifiManager, serwer i DNS nasłuchują cały czas
+void SubwooferWebServer::init(ConfigManager* config, ConsoleLogger* logger, WifiManager* wifi, RelayController* relayControllers, SensorManager* sensorManager, HeapMonitor* heapMonitor, BatteryGuard* batteryGuard, SnapshotBuffer* snapshot) {
   this->config = config;
   this->logger = logger;
-  this->relayController = relayController;
+  this->wifi = wifi;
+  this->relayControllers = relayControllers;
   this->sensorManager = sensorManager;
-  this->batteryPin = batteryPin;  // Zapisz pin baterii
+  this->heapMonitor = heapMonitor;
+  this->batteryGuard = batteryGuard;
+  this->snapshot = snapshot;
 
-  WiFi.softAP(nazwaWifi, hasloWifi);
-  startTime = millis();
+  wifi->start();
 
   // Uruchomienie DNS przekierowującego wszystko na IP ESP32
   dnsServer.start(53, "*", WiFi.softAPIP());
 
   setupRoutes();
-  server.begin();
-
-  logger->addLog("WEB SERVER", "success", "Serwer HTTP uruchomiony");
+  if (server.begin()) {
+    logger->addLog("WEB SERVER", "success", "Serwer HTTP uruchomiony");
+  } else {
+    logger->addLog("WEB SERVER", "error", "Nie można otworzyć portu HTTP");
+  }
 }
 
 void SubwooferWebServer::activate() {
-  WiFi.softAP(nazwaWifi, hasloWifi);
-  startTime = millis();
-  active = true;
-
-  // Ponowne uruchomienie DNS po aktywacji AP
-  dnsServer.start(53, "*", WiFi.softAPIP());
-
-  setupRoutes();
-  server.begin();
+  wifi->start();
   Serial.print("Ponownie aktywowano AP. IP: ");
   Serial.println(WiFi.softAPIP());
 }
 
+// Bez klientów AP nie ma kto wysłać zapytania HTTP ani DNS - otwarte
+// połączenia są jeszcze obsługiwane, aż wygasną. Jedno wywołanie nie czeka
+// na sieć (HttpServer), więc czas pętli nie zależy od łącza klienta.
 void SubwooferWebServer::handleClient() {
-  if (!active) return;
+  // Restart po /restart - sekunda na wysłanie strony z informacją
+  if (restartAt != 0 && millis() - restartAt >= 1000) ESP.restart();
+
+  if (!wifi->hasStations() && !server.hasConnections()) return;
+  HeapScope heapScope(HEAP_SYS_WEB);
 
   server.handleClient();
   dnsServer.processNextRequest();  // Obsługa zapytań DNS
-
-  connectedClients = WiFi.softAPgetStationNum();
-
-  if (connectedClients == 0 && millis() - startTime > WIFI_TIMEOUT) {
-    Serial.println("Web server timeout – brak klientów, wyłączam AP.");
-    logger->addLog("WIFI", "warning", "Timeout - wyłączanie Access Point");
-    server.stop();
-    WiFi.softAPdisconnect(true);
-    active = false;
-  }
 }
-/* przed dns a dokładniej przed dodaniem przekierowan HTTP
 void SubwooferWebServer::setupRoutes() {
-  server.on("/", HTTP_GET, [this]() {
+  // Trasy z true budują dużą treść - tylko dla jednego połączenia naraz
+  server.on("/", [this]() {
     handleRoot();
-  });
-  server.on("/set", HTTP_GET, [this]() {
+  }, true);
+  server.on("/set", [this]() {
     handleSet();
   });
-  server.on("/trigger", HTTP_GET, [this]() {
+  server.on("/trigger", [this]() {
     handleTrigger();
   });
-  server.on("/force-shutdown", HTTP_GET, [this]() {
+  server.on("/force-shutdown", [this]() {
     handleForceShutdown();
   });
-  server.on("/fastdata", HTTP_GET, [this]() {
+  server.on("/fastdata", [this]() {
     handleFastData();
   });
-  server.on("/data", HTTP_GET, [this]() {
+  server.on("/data", [this]() {
     handleData();
   });
-  server.on("/logs", HTTP_GET, [this]() {
+  server.on("/logs", [this]() {
     handleLogs();
-  });
-  server.on("/help", HTTP_GET, [this]() {
+  }, true);
+  server.on("/help", [this]() {
     handleHelp();
   });
-  server.on("/factory", HTTP_GET, [this]() {
+  server.on("/diag", [this]() {
+    handleDiag();
+  }, true);
+  server.on("/factory", [this]() {
     handleFactory();
   });
-  server.on("/restart", HTTP_GET, [this]() {
-    handleRestart();
-  });
-}
-*/
-void SubwooferWebServer::setupRoutes() {
-  server.on("/", HTTP_GET, [this]() {
-    handleRoot();
-  });
-  server.on("/set", HTTP_GET, [this]() {
-    handleSet();
-  });
-  server.on("/trigger", HTTP_GET, [this]() {
-    handleTrigger();
-  });
-  server.on("/force-shutdown", HTTP_GET, [this]() {
-    handleForceShutdown();
-  });
-  server.on("/fastdata", HTTP_GET, [this]() {
-    handleFastData();
-  });
-  server.on("/data", HTTP_GET, [this]() {
-    handleData();
-  });
-  server.on("/logs", HTTP_GET, [this]() {
-    handleLogs();
-  });
-  server.on("/help", HTTP_GET, [this]() {
-    handleHelp();
-  });
-  server.on("/factory", HTTP_GET, [this]() {
-    handleFactory();
-  });
-  server.on("/restart", HTTP_GET, [this]() {
+  server.on("/restart", [this]() {
     handleRestart();
   });
 
   // Przekierowanie dla nieznanych ścieżek
   server.onNotFound([this]() {
-    server.sendHeader("Location", "/", true);
-    server.send(302, "text/plain", "");
-  });
-
-  server.on("/generate_204", HTTP_GET, [this]() {
-    server.sendHeader("Location", "/", true);
-    server.send(302, "text/plain", "");
-  });
-
-  server.on("/hotspot-detect.html", HTTP_GET, [this]() {
-    server.sendHeader("Location", "/", true);
-    server.send(302, "text/plain", "");
+    handleNotFound();
   });
 
-  server.on("/connecttest.txt", HTTP_GET, [this]() {
-    server.sendHeader("Location", "/", true);
-    server.send(302, "text/plain", "");
-  });
-
-  server.on("/captive-portal", HTTP_GET, [this]() {
-    server.sendHeader("Location", "/", true);
+  // Sondy łączności systemów - krótkie odpowiedzi zamiast panelu
+  server.on("/generate_204", [this]() { handleProbe(PROBE_ANDROID); });
+  server.on("/gen_204", [this]() { handleProbe(PROBE_ANDROID); });
+  server.on("/hotspot-detect.html", [this]() { handleProbe(PROBE_APPLE); });
+  server.on("/library/test/success.html", [this]() { handleProbe(PROBE_APPLE); });
+  server.on("/connecttest.txt", [this]() { handleProbe(PROBE_WINDOWS); });
+  server.on("/ncsi.txt", [this]() { handleProbe(PROBE_WINDOWS); });
+  server.on("/canonical.html", [this]() { handleProbe(PROBE_FIREFOX); });
+  server.on("/success.txt", [this]() { handleProbe(PROBE_FIREFOX); });
+
+  server.on("/captive-portal", [this]() {
+    server.sendHeader("Location", "/");
     server.send(302, "text/plain", "");
   });
 }
 
 
 // Nowe metody dla lepszego zarządzania statusem przekaźników
-String SubwooferWebServer::getRelayStatusText() {
-  if (!relayController->isActive()) {
+const char* SubwooferWebServer::getRelayStatusText(const ZoneSnapshot& zone) {
+  if (zone.relaysPreArmed) {
+    return "ARMING";
+  }
+
+  if (!zone.relaysActive) {
     // Sprawdź czy system jest w trakcie wyłączania
-    if (!relayController->isIdle()) {
+    if (!zone.relaysIdle) {
       return "STOPPING";
     }
     return "OFF";
   }
 
   // System jest aktywny - sprawdź czy w trakcie sekwencji
-  if (!relayController->isIdle()) {
+  if (!zone.relaysIdle) {
     return "STARTING";
   }
 
@@ -179,15 +161,19 @@ String SubwooferWebServer::getRelayStatusText() {
   return "ACTIVE";
 }
 
-String SubwooferWebServer::getRelayStatusClass() {
-  if (!relayController->isActive()) {
-    if (!relayController->isIdle()) {
+const char* SubwooferWebServer::getRelayStatusClass(const ZoneSnapshot& zone) {
+  if (zone.relaysPreArmed) {
+    return "value-info";  // Przetwornica włączona z wyprzedzeniem
+  }
+
+  if (!zone.relaysActive) {
+    if (!zone.relaysIdle) {
       return "value-warning";  // Żółty podczas wyłączania
     }
     return "value-inactive";  // Szary gdy wyłączony
   }
 
-  if (!relayController->isIdle()) {
+  if (!zone.relaysIdle) {
     return "value-warning";  // Żółty podczas uruchamiania
   }
 
@@ -195,6 +181,35 @@ String SubwooferWebServer::getRelayStatusClass() {
 }
 
 void SubwooferWebServer::handleRoot() {
+  rootPages++;
+  server.send(200, "text/html", buildRootPage());
+}
+
+void SubwooferWebServer::handleProbe(PortalProbe probe) {
+  probeCount[probe]++;
+  if (probe == PROBE_APPLE) {
+    server.send_P(200, "text/html", PROBE_APPLE_HTML);
+    return;
+  }
+  server.sendHeader("Location", PORTAL_URL);
+  server.send(302);
+}
+
+// Nawigacja przeglądarki (np. arkusz portalu po przekierowaniu Windows)
+// trafia do panelu, zapytania aplikacji w tle dostają pusty 404 - inaczej
+// klient HTTP podążyłby za 302 i pobrał cały panel
+void SubwooferWebServer::handleNotFound() {
+  if (server.header("Accept").indexOf("text/html") >= 0) {
+    portalRedirects++;
+    server.sendHeader("Location", PORTAL_URL);
+    server.send(302);
+  } else {
+    notFoundRejected++;
+    server.send(404);
+  }
+}
+
+String SubwooferWebServer::buildRootPage() {
   String html = R"rawliteral(
 <!DOCTYPE html><html lang='pl'><head>
   <meta charset='UTF-8'>
@@ -355,13 +370,13 @@ void SubwooferWebServer::handleRoot() {
       display: block; font-size: 0.85rem; 
       color: #bbb; margin-bottom: 5px; font-weight: 500;
     }
-    .form-group input {
+    .form-group input, .form-group select {
       width: 100%; padding: 12px; 
       background: #1a1a1a; border: 1px solid #444; 
       border-radius: 8px; color: #fff; font-size: 1rem;
       transition: border-color 0.2s, box-shadow 0.2s;
     }
-    .form-group input:focus {
+    .form-group input:focus, .form-group select:focus {
       outline: none; border-color: #00d4ff;
       box-shadow: 0 0 0 2px rgba(0,212,255,0.2);
     }
@@ -714,13 +729,13 @@ body.light-theme .log-message {
   color: #4b5563;
 }
 
-body.light-theme .form-group input {
+body.light-theme .form-group input, body.light-theme .form-group select {
   background: #ffffff;
   border: 2px solid #d1d5db;
   color: #374151;
 }
 
-body.light-theme .form-group input:focus {
+body.light-theme .form-group input:focus, body.light-theme .form-group select:focus {
   border-color: #3b82f6;
   box-shadow: 0 0 0 3px rgba(59, 130, 246, 0.1);
 }
@@ -982,6 +997,7 @@ body.light-theme .toast-notification.danger {
         <div class='status-icon'>🌡️</div>
         <div class='status-label'>Temperature</div>
         <div class='status-value value-info' id='temp'>--°C</div>
+        <div class='status-label' id='tempLimit'></div>
       </div>
       <div class='status-card'>
         <div class='status-icon'>🔋</div>
@@ -1000,6 +1016,8 @@ body.light-theme .toast-notification.danger {
       </div>
     </div>
 
+    <div class='status-grid' id='zoneGrid' style='display: none;'></div>
+
     <div class='timer-bar' id='timerBar'>
       <div class='timer-content'>
         <div class='timer-icon'>⏱️</div>
@@ -1042,6 +1060,30 @@ body.light-theme .toast-notification.danger {
               <input name='czas' type='number' value=')rawliteral"
                 + String(config->getCzasPoSyg()) + R"rawliteral(' min='5' max='600'>
             </div>
+            <div class='form-group'>
+              <label>Hold mode</label>
+              <select name='holdmode'>
+                <option value='0')rawliteral"
+                + String(config->getHoldMode() == HOLD_MODE_FIXED ? " selected" : "") + R"rawliteral(>Fixed hold time</option>
+                <option value='1')rawliteral"
+                + String(config->getHoldMode() == HOLD_MODE_ADAPTIVE ? " selected" : "") + R"rawliteral(>Learned from gaps</option>
+              </select>
+            </div>
+            <div class='form-group'>
+              <label>Gaps covered [%]</label>
+              <input name='holdpct' type='number' value=')rawliteral"
+                + String(config->getHoldPercentile()) + R"rawliteral(' min='50' max='99'>
+            </div>
+            <div class='form-group'>
+              <label>Learned hold min [s]</label>
+              <input name='holdmin' type='number' value=')rawliteral"
+                + String(config->getHoldMinS()) + R"rawliteral(' min='5' max='600'>
+            </div>
+            <div class='form-group'>
+              <label>Learned hold max [s]</label>
+              <input name='holdmax' type='number' value=')rawliteral"
+                + String(config->getHoldMaxS()) + R"rawliteral(' min='5' max='600'>
+            </div>
             <div class='form-group'>
               <label>Min voltage [V]</label>
               <input name='napiecie' type='number' step='0.1' value=')rawliteral"
@@ -1052,6 +1094,35 @@ body.light-theme .toast-notification.danger {
               <input name='audio' type='number' step='0.001' value=')rawliteral"
                 + String(config->getAudioThreshold(), 3) + R"rawliteral(' min='0.1' max='3'>
             </div>
+            <div class='form-group'>
+              <label>Audio mode</label>
+              <select name='audiomode'>
+                <option value='0')rawliteral"
+                + String(config->getAudioMode() == AUDIO_MODE_ABSOLUTE ? " selected" : "") + R"rawliteral(>Absolute threshold</option>
+                <option value='1')rawliteral"
+                + String(config->getAudioMode() == AUDIO_MODE_FLOOR ? " selected" : "") + R"rawliteral(>Noise floor + dB</option>
+              </select>
+            </div>
+            <div class='form-group'>
+              <label>Above noise floor [dB]</label>
+              <input name='audiodb' type='number' step='0.5' value=')rawliteral"
+                + String(config->getAudioFloorDb(), 1) + R"rawliteral(' min='3' max='40'>
+            </div>
+            <div class='form-group'>
+              <label>Audio hysteresis [dB]</label>
+              <input name='audiohyst' type='number' step='0.5' value=')rawliteral"
+                + String(config->getAudioHystDb(), 1) + R"rawliteral(' min='0' max='20'>
+            </div>
+            <div class='form-group'>
+              <label>Audio confirm [ms]</label>
+              <input name='audioconfirm' type='number' value=')rawliteral"
+                + String(config->getAudioConfirmMs()) + R"rawliteral(' min='0' max='2000'>
+            </div>
+            <div class='form-group'>
+              <label>Restart lockout [ms]</label>
+              <input name='lockout' type='number' value=')rawliteral"
+                + String(config->getAudioLockoutMs()) + R"rawliteral(' min='0' max='60000'>
+            </div>
             <div class='form-group'>
               <label>Fan start [°C]</label>
               <input name='tmin' type='number' step='0.1' value=')rawliteral"
@@ -1077,6 +1148,11 @@ body.light-theme .toast-notification.danger {
               <input name='delayrelay' type='number' value=')rawliteral"
                 + String(config->getDelayRelaySwitch()) + R"rawliteral(' min='100' max='10000'>
             </div>
+            <div class='form-group'>
+              <label>Converter pre-arm [ms]</label>
+              <input name='prearm' type='number' value=')rawliteral"
+                + String(config->getPreArmMs()) + R"rawliteral(' min='0' max='10000'>
+            </div>
           </div>
         </form>
         <div style='margin-top: 20px; display: grid; grid-template-columns: 1fr 2fr; gap: 10px;'>
@@ -1105,7 +1181,7 @@ body.light-theme .toast-notification.danger {
 
 <script>
 let currentHoldTime = )rawliteral"
-                + String(config->getCzasPoSyg()) + R"rawliteral(;
+                + String(holdTimeLearner ? holdTimeLearner->getHoldSeconds() : config->getCzasPoSyg()) + R"rawliteral(;
 let holdTimer = null;
 let holdProgress = 0;
 let holdInterval = null;
@@ -1333,6 +1409,10 @@ async function updateReadings() {
     fastDataCache.relayStatus = data.relayStatus;
   }
   
+  if (data.zones && data.zones.length > 1) {
+    updates.push(() => updateZones(data.zones));
+  }
+
   // Wykonaj wszystkie aktualizacje DOM jednocześnie
   if (updates.length > 0) {
     requestAnimationFrame(() => {
@@ -1479,10 +1559,40 @@ function updateTimerDisplay(timeRemaining) {
   }
 }
 
+// Karty stref - tylko gdy kontroler obsługuje więcej niż jedną strefę
+function updateZones(zones) {
+  const grid = document.getElementById('zoneGrid');
+  if (grid.childElementCount !== zones.length) {
+    grid.innerHTML = zones.map((z, i) =>
+      `<div class='status-card'><div class='status-label'>Zone ${i}</div>` +
+      `<div class='status-value' id='zoneStatus${i}'>--</div>` +
+      `<div class='status-label'><span id='zoneAudio${i}'>--</span>V · <span id='zoneTemp${i}'>--</span>°C</div></div>`).join('');
+    grid.style.display = '';
+  }
+  zones.forEach((z, i) => {
+    const status = document.getElementById('zoneStatus' + i);
+    status.textContent = z.status;
+    status.className = 'status-value ' + z.cls;
+    document.getElementById('zoneAudio' + i).textContent = z.audio;
+  });
+}
+
 async function updateTemperature() {
   const data = await optimizedFetch('/data', 'tempData', 2000); // Cache na 2s
   if (!data) return;
   
+  if (data.temps) {
+    data.temps.forEach((t, i) => {
+      const zoneTemp = document.getElementById('zoneTemp' + i);
+      if (zoneTemp) zoneTemp.textContent = t;
+    });
+  }
+
+  // Prognoza modelu cieplnego - widoczna tylko, gdy tempMax jest w zasięgu
+  const limitElement = document.getElementById('tempLimit');
+  const ttl = data.ttl ? data.ttl[0] : -1;
+  limitElement.textContent = ttl >= 0 ? 'limit in ' + Math.ceil(ttl / 60) + ' min' : '';
+
   const tempElement = document.getElementById('temp');
   const newText = data.temp + '°C';
   
@@ -2015,11 +2125,13 @@ function saveConfig() {
 </body></html>
 )rawliteral";
 
-  server.send(200, "text/html", html);
+  return html;
 }
 
 void SubwooferWebServer::handleSet() {
   bool changed = false;
+  // Parametry strefy (audio, temperatury, delayrelay) dotyczą strefy z argumentu zone
+  int zone = server.hasArg("zone") ? constrain(server.arg("zone").toInt(), 0, ZONE_COUNT - 1) : 0;
   if (server.hasArg("czas") && server.arg("czas") != "") {
     config->setCzasPoSyg(server.arg("czas").toInt());
     changed = true;
@@ -2029,27 +2141,57 @@ void SubwooferWebServer::handleSet() {
     changed = true;
   }
   if (server.hasArg("audio") && server.arg("audio") != "") {
-    config->setAudioThreshold(server.arg("audio").toFloat());
+    config->setAudioThreshold(server.arg("audio").toFloat(), zone);
     changed = true;
   }
+  if (server.hasArg("audiomode") && server.arg("audiomode") != "") {
+    config->setAudioMode(server.arg("audiomode").toInt() == AUDIO_MODE_FLOOR ? AUDIO_MODE_FLOOR : AUDIO_MODE_ABSOLUTE);
+  }
+  if (server.hasArg("audiodb") && server.arg("audiodb") != "") {
+    config->setAudioFloorDb(constrain(server.arg("audiodb").toFloat(), 3.0f, 40.0f));
+  }
+  if (server.hasArg("audiohyst") && server.arg("audiohyst") != "") {
+    config->setAudioHystDb(constrain(server.arg("audiohyst").toFloat(), 0.0f, 20.0f));
+  }
+  if (server.hasArg("audioconfirm") && server.arg("audioconfirm") != "") {
+    config->setAudioConfirmMs(constrain(server.arg("audioconfirm").toInt(), 0, 2000));
+  }
+  if (server.hasArg("lockout") && server.arg("lockout") != "") {
+    config->setAudioLockoutMs(constrain(server.arg("lockout").toInt(), 0, 60000));
+  }
+  if (server.hasArg("prearm") && server.arg("prearm") != "") {
+    config->setPreArmMs(constrain(server.arg("prearm").toInt(), 0, 10000));
+  }
+  if (server.hasArg("holdmode") && server.arg("holdmode") != "") {
+    config->setHoldMode(server.arg("holdmode").toInt() == HOLD_MODE_ADAPTIVE ? HOLD_MODE_ADAPTIVE : HOLD_MODE_FIXED);
+  }
+  if (server.hasArg("holdpct") && server.arg("holdpct") != "") {
+    config->setHoldPercentile(constrain(server.arg("holdpct").toInt(), 50, 99));
+  }
+  if (server.hasArg("holdmin") && server.arg("holdmin") != "") {
+    config->setHoldMinS(constrain(server.arg("holdmin").toInt(), 5, 600));
+  }
+  if (server.hasArg("holdmax") && server.arg("holdmax") != "") {
+    config->setHoldMaxS(constrain(server.arg("holdmax").toInt(), (long)config->getHoldMinS(), 600L));
+  }
   if (server.hasArg("tmin") && server.arg("tmin") != "") {
-    config->setTempMin(server.arg("tmin").toFloat());
+    config->setTempMin(server.arg("tmin").toFloat(), zone);
     changed = true;
   }
   if (server.hasArg("tprzegrz") && server.arg("tprzegrz") != "") {
-    config->setTempPrzegrzania(server.arg("tprzegrz").toFloat());
+    config->setTempPrzegrzania(server.arg("tprzegrz").toFloat(), zone);
     changed = true;
   }
   if (server.hasArg("tmax") && server.arg("tmax") != "") {
-    config->setTempMax(server.arg("tmax").toFloat());
+    config->setTempMax(server.arg("tmax").toFloat(), zone);
     changed = true;
   }
   if (server.hasArg("savetemp") && server.arg("savetemp") != "") {
-    config->setTempSave(server.arg("savetemp").toFloat());
+    config->setTempSave(server.arg("savetemp").toFloat(), zone);
     changed = true;
   }
   if (server.hasArg("delayrelay") && server.arg("delayrelay") != "") {
-    config->setDelayRelaySwitch(server.arg("delayrelay").toInt());
+    config->setDelayRelaySwitch(server.arg("delayrelay").toInt(), zone);
     changed = true;
   }
 
@@ -2063,20 +2205,32 @@ void SubwooferWebServer::handleSet() {
 }
 
 void SubwooferWebServer::handleTrigger() {
-  lastAudioDetected = millis();
+  bool started = false;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    lastAudioDetected[z] = millis();
+    if (relayControllers[z].canStart()) {
+      relayControllers[z].startupSequence();
+      started = true;
+    }
+  }
 
-  if (!relayController->isActive() && relayController->isIdle()) {
-    relayController->startupSequence();
-  } else {
+  if (!started) {
     logger->addLog("TRIGGER RELAYS", "info", "Przekaźniki już aktywne - przedłużono czas");
   }
   server.send(200, "text/plain", "OK");
 }
 
 void SubwooferWebServer::handleForceShutdown() {
-  if (relayController->isActive()) {
+  bool anyActive = false;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    if (relayControllers[z].isActive()) anyActive = true;
+  }
+
+  if (anyActive) {
     logger->addLog("FORCE SHUTDOWN", "warning", "Wymuszone wyłączenie przez interfejs web");
-    relayController->shutdownSequence();
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      if (relayControllers[z].isActive()) relayControllers[z].shutdownSequence();
+    }
   } else {
     logger->addLog("FORCE SHUTDOWN", "info", "Próba wymuszonego wyłączenia - system już nieaktywny");
   }
@@ -2084,47 +2238,162 @@ void SubwooferWebServer::handleForceShutdown() {
 }
 
 void SubwooferWebServer::handleFastData() {
-  float adc = analogRead(batteryPin);  // Używamy zapisanego pinu baterii
-  float napiecie = ((adc) / 4095.0) * 3.3 * (47 + 12) / 12;
+  static char json[FASTDATA_JSON_SIZE];
+  size_t length = buildFastDataJson(json, sizeof(json));
+  server.send(200, "application/json", json, length);
+}
+
+size_t SubwooferWebServer::buildFastDataJson(char* buffer, size_t size) {
+  SensorSnapshot state;
+  snapshot->read(state);
+
+  // Wartości formatowane do buforów na stosie - bez alokacji String
+  char battStr[8];
+  char audioStr[ZONE_COUNT][10];
+  snprintf(battStr, sizeof(battStr), "%.2f", state.batteryVoltage);
+
+  // Pola główne opisują pierwszą strefę, która nie jest wyłączona (albo strefę 0),
+  // czas do wyłączenia - najdłuższy ze stref
+  int summary = -1;
+  bool anyActive = false;
+  long timeRemaining = -1;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    const ZoneSnapshot& zone = state.zones[z];
+    snprintf(audioStr[z], sizeof(audioStr[z]), "%.3f", zone.audioEnvelope);
+    bool busy = zone.relaysActive || !zone.relaysIdle || zone.relaysPreArmed;
+    if (busy && summary < 0) summary = z;
+    if (zone.relaysActive) anyActive = true;
+    if (zone.timeRemaining > timeRemaining) timeRemaining = zone.timeRemaining;
+  }
+  if (summary < 0) summary = 0;
 
-  DynamicJsonDocument doc(400);
-  doc["batt"] = String(napiecie, 2);
-  doc["audio"] = String(sensorManager->getFilteredAudio(), 3);
-  doc["relays"] = relayController->isActive();
-  doc["relayStatus"] = getRelayStatusText();
-  doc["relayStatusClass"] = getRelayStatusClass();
+  StaticJsonDocument<FASTDATA_DOC_SIZE> doc;
+  doc["batt"] = battStr;
+  doc["audio"] = audioStr[summary];
+  doc["relays"] = anyActive;
+  doc["relayStatus"] = getRelayStatusText(state.zones[summary]);
+  doc["relayStatusClass"] = getRelayStatusClass(state.zones[summary]);
 
   // Dodaj informację o czasie pozostałym do wyłączenia
-  if (relayController->isActive()) {
-    unsigned long currentTime = millis();
-    unsigned long elapsedTime = (currentTime - lastAudioDetected) / 1000;  // w sekundach
-    long timeRemaining = (long)config->getCzasPoSyg() - (long)elapsedTime;
-    doc["timeRemaining"] = max(0L, timeRemaining);
+  if (timeRemaining >= 0) {
+    doc["timeRemaining"] = timeRemaining;
   }
 
-  String json;
-  serializeJson(doc, json);
-  server.send(200, "application/json", json);
+  JsonArray zones = doc.createNestedArray("zones");
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    const ZoneSnapshot& zone = state.zones[z];
+    JsonObject entry = zones.createNestedObject();
+    entry["audio"] = audioStr[z];
+    entry["status"] = getRelayStatusText(zone);
+    entry["cls"] = getRelayStatusClass(zone);
+    if (zone.timeRemaining >= 0) entry["tr"] = zone.timeRemaining;
+  }
+
+  return serializeJson(doc, buffer, size);
 }
 
 void SubwooferWebServer::handleData() {
-  sensors.requestTemperatures();
-  float temp = sensors.getTempCByIndex(0);
+  SensorSnapshot state;
+  snapshot->read(state);
 
-  DynamicJsonDocument doc(100);
-  doc["temp"] = String(temp, 1);
+  char tempStr[ZONE_COUNT][8];
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    const ZoneSnapshot& zone = state.zones[z];
+    snprintf(tempStr[z], sizeof(tempStr[z]), "%.1f", zone.temperatureValid ? zone.temperature : (float)DEVICE_DISCONNECTED_C);
+  }
 
-  String json;
-  serializeJson(doc, json);
-  server.send(200, "application/json", json);
+  StaticJsonDocument<64 + ZONE_COUNT * 96 + TEMP_MAX_SENSORS * 48> doc;
+  doc["temp"] = tempStr[0];
+  JsonArray temps = doc.createNestedArray("temps");
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    temps.add(tempStr[z]);
+  }
+
+  // Prognoza czasu do tempMax [s] z modelu cieplnego, -1 = nie zostanie osiągnięta
+  JsonArray ttl = doc.createNestedArray("ttl");
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    ttl.add(state.zones[z].timeToLimit);
+  }
+
+  // Wentylatory: wypełnienie [%] i obroty (tylko z tachometrem)
+  JsonArray fans = doc.createNestedArray("fans");
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    const ZoneSnapshot& zone = state.zones[z];
+    JsonObject entry = fans.createNestedObject();
+    entry["duty"] = (int)lroundf(zone.fanDuty * 100);
+    if (zone.fanRpm >= 0) entry["rpm"] = (int)lroundf(zone.fanRpm);
+  }
+
+  // Wszystkie czujniki na magistrali, z wiekiem odczytu
+  char sensorStr[TEMP_MAX_SENSORS][8];
+  JsonArray sensors = doc.createNestedArray("sensors");
+  for (uint8_t i = 0; i < state.tempSensorCount; i++) {
+    const TempSensorSnapshot& sensor = state.tempSensors[i];
+    snprintf(sensorStr[i], sizeof(sensorStr[i]), "%.1f", sensor.celsius);
+    JsonObject entry = sensors.createNestedObject();
+    entry["t"] = sensorStr[i];
+    if (sensor.readTime != 0) entry["age"] = state.timestamp - sensor.readTime;
+  }
+
+  char json[64 + ZONE_COUNT * 56 + TEMP_MAX_SENSORS * 32];
+  size_t length = serializeJson(doc, json, sizeof(json));
+  server.send(200, "application/json", json, length);
 }
 
 void SubwooferWebServer::handleLogs() {
   server.send(200, "application/json", logger->getLogsAsJson());
 }
 
+void SubwooferWebServer::handleDiag() {
+  DynamicJsonDocument doc(3072 + (ZONE_COUNT - 1) * 1024 + ZONE_COUNT * 896 + TEMP_MAX_SENSORS * 160);
+  heapMonitor->addDiagnostics(doc.createNestedObject("heap"));
+  JsonArray relays = doc.createNestedArray("relays");
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    relayControllers[z].addDiagnostics(relays.createNestedObject());
+  }
+  batteryGuard->addDiagnostics(doc.createNestedObject("battery"));
+  wifi->addDiagnostics(doc.createNestedObject("wifi"));
+  server.addDiagnostics(doc.createNestedObject("http"));
+
+  JsonObject portal = doc.createNestedObject("portal");
+  static const char* const probeNames[PROBE_KIND_COUNT] = { "android", "apple", "windows", "firefox" };
+  JsonObject probes = portal.createNestedObject("probes");
+  for (int i = 0; i < PROBE_KIND_COUNT; i++) {
+    probes[probeNames[i]] = probeCount[i];
+  }
+  portal["redirects"] = portalRedirects;
+  portal["rejected"] = notFoundRejected;
+  portal["rootPages"] = rootPages;
+  sensorManager->addDiagnostics(doc.createNestedObject("audio"));
+  if (audioGates) {
+    JsonArray gates = doc.createNestedArray("gate");
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      audioGates[z].addDiagnostics(gates.createNestedObject());
+    }
+  }
+  if (holdTimeLearner) holdTimeLearner->addDiagnostics(doc.createNestedObject("hold"));
+  if (temperatureManager) temperatureManager->addDiagnostics(doc.createNestedObject("temperature"));
+  if (fanControllers) {
+    JsonArray fans = doc.createNestedArray("fans");
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      fanControllers[z].addDiagnostics(fans.createNestedObject());
+    }
+  }
+  if (thermalModels) {
+    JsonArray thermal = doc.createNestedArray("thermal");
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      thermalModels[z].addDiagnostics(thermal.createNestedObject());
+    }
+  }
+  if (powerManager) powerManager->addDiagnostics(doc.createNestedObject("power"));
+
+  String json;
+  serializeJson(doc, json);
+  server.send(200, "application/json", json);
+}
+
 void SubwooferWebServer::handleHelp() {
-  String html = R"rawliteral(
+  static const char html[] PROGMEM = R"rawliteral(
 <!DOCTYPE html><html><head>
   <meta charset='UTF-8'>
   <meta name='viewport' content='width=device-width, initial-scale=1.0'>
@@ -2174,7 +2443,7 @@ void SubwooferWebServer::handleHelp() {
         <li><strong>Temperature</strong> – Current amplifier temperature</li>
         <li><strong>Battery</strong> – Current battery voltage</li>
         <li><strong>Audio</strong> – Audio signal level detection</li>
-        <li><strong>Relays</strong> – Power relay status (STARTING/ACTIVE/STOPPING/OFF)</li>
+        <li><strong>Relays</strong> – Power relay status (ARMING/STARTING/ACTIVE/STOPPING/OFF)</li>
         <li><strong>Shutdown Timer</strong> – Countdown to automatic shutdown (only when relays are active)</li>
       </ul>
     </div>
@@ -2194,13 +2463,22 @@ void SubwooferWebServer::handleHelp() {
       <h3>⚙️ Configuration Parameters</h3>
       <ul>
         <li><code>Hold time</code> – Time (seconds) to keep power ON after audio signal disappears</li>
+        <li><code>Hold mode</code> – Fixed hold time, or a hold learned from the silence gaps between tracks</li>
+        <li><code>Gaps covered</code> – Percentile of learned gaps the hold must bridge, within the min/max bounds</li>
         <li><code>Min voltage</code> – Minimum battery voltage threshold for operation</li>
         <li><code>Audio threshold</code> – Audio signal detection sensitivity</li>
+        <li><code>Audio mode</code> – Absolute threshold, or trigger at the tracked noise floor plus a margin</li>
+        <li><code>Above noise floor</code> – Margin in dB used by the noise floor mode</li>
+        <li><code>Audio hysteresis</code> – How far (dB) the signal must fall below the trigger before it counts as silence</li>
+        <li><code>Audio confirm</code> – Signal must stay above the trigger this long before relays start</li>
+        <li><code>Restart lockout</code> – After shutdown, audio is ignored for this long</li>
         <li><code>Fan start</code> – Temperature to start cooling fan</li>
         <li><code>Warning temp</code> – Temperature for overheat warning</li>
         <li><code>Critical temp</code> – Temperature triggering emergency shutdown</li>
         <li><code>Cool stop</code> – Temperature to stop post-shutdown cooling</li>
         <li><code>Relay delay</code> – Delay between power-on and amplifier enable</li>
+        <li><code>Converter pre-arm</code> – Power the converter early on a rising signal; dropped after this time if audio is not confirmed (0 = off)</li>
+        <li><code>zone</code> – On multi-zone builds, <code>/set?zone=N</code> applies the audio threshold, temperatures and relay delay to zone N</li>
       </ul>
     </div>
 
@@ -2246,7 +2524,7 @@ void SubwooferWebServer::handleHelp() {
   </div>
 </body></html>
 )rawliteral";
-  server.send(200, "text/html", html);
+  server.send_P(200, "text/html", html);
 }
 
 void SubwooferWebServer::handleFactory() {
@@ -2258,7 +2536,7 @@ void SubwooferWebServer::handleFactory() {
 
 void SubwooferWebServer::handleRestart() {
   logger->addLog("RESTART", "warning", "Restart zainicjowany przez interfejs web");
-  server.send(200, "text/html", R"rawliteral(
+  static const char html[] PROGMEM = R"rawliteral(
 <!DOCTYPE html><html><head>
   <meta charset='UTF-8'>
   <meta name='viewport' content='width=device-width, initial-scale=1.0'>
@@ -2292,7 +2570,7 @@ void SubwooferWebServer::handleRestart() {
     <p>You will be redirected automatically in 5 seconds.</p>
   </div>
 </body></html>
-)rawliteral");
-  delay(1000);
-  ESP.restart();
+)rawliteral";
+  server.send_P(200, "text/html", html);
+  restartAt = max(millis(), 1UL);
 }
@@ -2,7 +2,6 @@
 #define SUBWOOFER_WEB_SERVER_H
 
 #include <Arduino.h>
-#include <WebServer.h>
 #include <WiFi.h>
 #include <DNSServer.h>  // DNS
 
@@ -10,46 +9,91 @@
 #include "ConsoleLogger.h"
 #include "RelayController.h"
 #include "SensorManager.h"
+#include "HeapMonitor.h"
+#include "SensorSnapshot.h"
+#include "BatteryGuard.h"
+#include "WifiManager.h"
+#include "HttpServer.h"
+
+class PowerManager;
+class AudioGate;
+class HoldTimeLearner;
+class TemperatureManager;
+class ThermalModel;
+class FanController;
+
+// Sondy łączności systemów (captive portal) - liczone osobno od stron panelu
+enum PortalProbe : uint8_t {
+  PROBE_ANDROID,      // /generate_204, /gen_204
+  PROBE_APPLE,        // /hotspot-detect.html, /library/test/success.html
+  PROBE_WINDOWS,      // /connecttest.txt, /ncsi.txt
+  PROBE_FIREFOX,      // /canonical.html, /success.txt
+  PROBE_KIND_COUNT
+};
+
+#define FASTDATA_JSON_SIZE (256 + ZONE_COUNT * 96)
+#define FASTDATA_DOC_SIZE (256 + ZONE_COUNT * 128)
 
 class SubwooferWebServer {
 private:
-  WebServer server;
+  HttpServer server;
   DNSServer dnsServer;  // DNS
   ConfigManager* config;
   ConsoleLogger* logger;
-  RelayController* relayController;
+  WifiManager* wifi;
+  RelayController* relayControllers;    // ZONE_COUNT stref
   SensorManager* sensorManager;
-  bool active;
-  unsigned long startTime;
-  int connectedClients;
-  int batteryPin;
-  const unsigned long WIFI_TIMEOUT = 120000;  // 2 minuty
-  const char* nazwaWifi = "Subwoofer";
-  const char* hasloWifi = "Subwoofer321";
+  HeapMonitor* heapMonitor;
+  BatteryGuard* batteryGuard;
+  SnapshotBuffer* snapshot;
+  PowerManager* powerManager;
+  AudioGate* audioGates;                // ZONE_COUNT stref
+  HoldTimeLearner* holdTimeLearner;
+  TemperatureManager* temperatureManager;
+  ThermalModel* thermalModels;          // ZONE_COUNT stref
+  FanController* fanControllers;        // ZONE_COUNT stref
+
+  uint32_t probeCount[PROBE_KIND_COUNT];
+  uint32_t portalRedirects;              // nieznana ścieżka z przeglądarki -> panel
+  uint32_t notFoundRejected;             // nieznana ścieżka bez text/html -> 404
+  uint32_t rootPages;                    // zbudowane strony panelu
+  unsigned long restartAt;               // ms, 0 = brak zaplanowanego restartu
 
   void setupRoutes();
   void handleRoot();
+  void handleProbe(PortalProbe probe);
+  void handleNotFound();
   void handleSet();
   void handleTrigger();
   void handleForceShutdown();
   void handleFastData();
   void handleData();
   void handleLogs();
+  void handleDiag();
   void handleHelp();
   void handleFactory();
   void handleRestart();
 
-  String getRelayStatusText();
-  String getRelayStatusClass();
+  const char* getRelayStatusText(const ZoneSnapshot& zone);
+  const char* getRelayStatusClass(const ZoneSnapshot& zone);
 
 public:
   SubwooferWebServer();
-  void init(ConfigManager* config, ConsoleLogger* logger, RelayController* relayController, SensorManager* sensorManager, int batteryPin);
+  void init(ConfigManager* config, ConsoleLogger* logger, WifiManager* wifi, RelayController* relayControllers, SensorManager* sensorManager, HeapMonitor* heapMonitor, BatteryGuard* batteryGuard, SnapshotBuffer* snapshot);
   void handleClient();
-  bool isActive() { return active; }
+  bool isActive() { return wifi->isApActive(); }
+  int getConnectedClients() { return wifi->getStationCount(); }
+  void setPowerManager(PowerManager* powerManager) { this->powerManager = powerManager; }
+  void setAudioGates(AudioGate* audioGates) { this->audioGates = audioGates; }
+  void setHoldTimeLearner(HoldTimeLearner* holdTimeLearner) { this->holdTimeLearner = holdTimeLearner; }
+  void setTemperatureManager(TemperatureManager* temperatureManager) { this->temperatureManager = temperatureManager; }
+  void setThermalModels(ThermalModel* thermalModels) { this->thermalModels = thermalModels; }
+  void setFanControllers(FanController* fanControllers) { this->fanControllers = fanControllers; }
   void activate();
-  const char* getNazwaWifi() { return nazwaWifi; }
-  const char* getHasloWifi() { return hasloWifi; }
+
+  // Budowanie odpowiedzi bez wysyłania (używane też przez benchmark)
+  String buildRootPage();
+  size_t buildFastDataJson(char* buffer, size_t size);
 };
 
 #endif
@@ -0,0 +1,445 @@
+#include "TemperatureManager.h"
+#include <esp_timer.h>
+
+#define TEMP_FAMILY_DS18S20 0x10   // 9 bitów, 0.5 C na LSB, bez rejestru konfiguracji
+#define TEMP_FAMILY_DS1822 0x22
+#define TEMP_FAMILY_DS18B20 0x28
+#define TEMP_FAMILY_DS1825 0x3B
+
+// Komendy funkcji DS18B20
+#define TEMP_CMD_CONVERT 0x44
+#define TEMP_CMD_READ_SCRATCH 0xBE
+#define TEMP_CMD_WRITE_SCRATCH 0x4E
+#define TEMP_CMD_READ_POWER 0xB4
+
+// Czas konwersji DS18B20 dla 9..12 bitów [ms]
+static const uint16_t TEMP_CONVERSION_MS[] = { 94, 188, 375, 750 };
+
+// Odległość od progu [C], powyżej której wystarcza 9, 10 i 11 bitów
+static const float TEMP_RES_BANDS[] = { 10.0f, 5.0f, 2.0f };
+
+static uint8_t resolutionForDistance(float distance) {
+  uint8_t resolution = TEMP_RES_MIN;
+  for (float band : TEMP_RES_BANDS) {
+    if (distance > band) break;
+    resolution++;
+  }
+  return resolution;
+}
+
+static void formatRom(const uint8_t* rom, char* out) {
+  for (int i = 0; i < 8; i++) {
+    snprintf(out + i * 2, 3, "%02X", rom[i]);
+  }
+}
+
+TemperatureManager::TemperatureManager() :
+  wire(nullptr),
+  config(nullptr),
+  logger(nullptr),
+  deviceCount(0),
+  missingSensor(false),
+  parasite(false),
+  lastScan(0),
+  conversionStart(0),
+  cycleTime(0),
+  conversionPending(false),
+  readIndex(0),
+  cycles(0),
+  lastBusUs(0),
+  maxBusUs(0),
+  cycleBusUs(0),
+  conversionMs(TEMP_CONVERSION_MS[TEMP_RES_MAX - TEMP_RES_MIN]),
+  fastRise(false),
+  fastCycles(0),
+  resolutionSwitches(0),
+  totalConversionMs(0) {
+  memset(devices, 0, sizeof(devices));
+  memset(roleDevice, -1, sizeof(roleDevice));
+  memset(resolutionCycles, 0, sizeof(resolutionCycles));
+}
+
+void TemperatureManager::init(OneWireBus* wire, ConfigManager* config, ConsoleLogger* logger) {
+  this->wire = wire;
+  this->config = config;
+  this->logger = logger;
+  scan();
+}
+
+// Wyszukanie adresów ROM - odczyty idą już tylko po adresie. Czujnik
+// znaleziony ponownie zachowuje odczyt i liczniki.
+void TemperatureManager::scan() {
+  lastScan = millis();
+  TempSensor previous[TEMP_MAX_SENSORS];
+  uint8_t previousCount = deviceCount;
+  memcpy(previous, devices, sizeof(previous));
+  deviceCount = 0;
+
+  uint8_t rom[8];
+  wire->reset_search();
+  while (deviceCount < TEMP_MAX_SENSORS && wire->search(rom)) {
+    if (OneWireBus::crc8(rom, 7) != rom[7]) continue;
+    if (rom[0] != TEMP_FAMILY_DS18S20 && rom[0] != TEMP_FAMILY_DS1822 &&
+        rom[0] != TEMP_FAMILY_DS18B20 && rom[0] != TEMP_FAMILY_DS1825) continue;
+
+    TempSensor& device = devices[deviceCount];
+    bool known = false;
+    for (uint8_t i = 0; i < previousCount && !known; i++) {
+      if (memcmp(previous[i].rom, rom, sizeof(rom)) == 0) {
+        device = previous[i];
+        known = true;
+      }
+    }
+    if (known) {
+      deviceCount++;
+      continue;
+    }
+
+    memcpy(device.rom, rom, sizeof(device.rom));
+    device.celsius = DEVICE_DISCONNECTED_C;
+    device.readTime = 0;
+    device.reads = 0;
+    device.crcErrors = 0;
+    device.readErrors = 0;
+    device.failures = 0;
+    device.resolution = TEMP_RES_MAX;  // do pierwszego odczytu zakładany najdłuższy czas
+    device.resolutionSwitches = 0;
+    device.ratePerS = 0;
+    device.rateRefTime = 0;
+    deviceCount++;
+  }
+
+  // Czy któryś czujnik jest zasilany z linii danych (odpowiada zerem)
+  parasite = false;
+  if (deviceCount > 0 && wire->reset()) {
+    wire->skip();
+    wire->write(TEMP_CMD_READ_POWER);
+    parasite = wire->read_bit() == 0;
+  }
+  oneWireIdle(wire);
+
+  if (deviceCount != previousCount) {
+    logger->addLog("TEMPERATURE", deviceCount > 0 ? "info" : "warning", "Czujniki DS18B20 na magistrali: %u%s", deviceCount,
+                   parasite ? " (zasilanie pasożytnicze)" : "");
+  }
+#if ONEWIRE_USE_RMT
+  if (parasite) logger->addLog("TEMPERATURE", "warning", "Sterownik RMT nie podtrzymuje zasilania pasożytniczego");
+#endif
+  mapRoles();
+}
+
+// Role czujników wg adresów ROM z konfiguracji. Wywoływane po wyszukaniu i
+// przed każdą konwersją - zmiana przypisania komendą działa od razu.
+void TemperatureManager::mapRoles() {
+  int8_t previous[TEMP_ROLE_COUNT];
+  memcpy(previous, roleDevice, sizeof(previous));
+  memset(roleDevice, -1, sizeof(roleDevice));
+  for (uint8_t i = 0; i < deviceCount; i++) {
+    devices[i].role = -1;
+  }
+
+  bool anyAssigned = false;
+  missingSensor = false;
+  for (int r = 0; r < TEMP_ROLE_COUNT; r++) {
+    if (!config->isTempSensorAssigned(r)) continue;
+    anyAssigned = true;
+    for (uint8_t i = 0; i < deviceCount; i++) {
+      if (memcmp(devices[i].rom, config->getTempSensorRom(r), sizeof(devices[i].rom)) == 0) {
+        roleDevice[r] = i;
+        devices[i].role = r;
+      }
+    }
+    if (roleDevice[r] < 0) missingSensor = true;
+  }
+  // Bez przypisań jednoznaczny jest tylko pojedynczy czujnik jedynej strefy
+  if (!anyAssigned && ZONE_COUNT == 1 && deviceCount == 1) {
+    roleDevice[0] = 0;
+    devices[0].role = 0;
+  }
+
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    if (roleDevice[z] == previous[z]) continue;
+    if (roleDevice[z] >= 0) {
+      char rom[17];
+      formatRom(devices[roleDevice[z]].rom, rom);
+      logger->addLog("TEMPERATURE", "info", "Czujnik strefy %d: %s", z, rom);
+    } else if (config->isTempSensorAssigned(z)) {
+      logger->addLog("TEMPERATURE", "error", "Brak przypisanego czujnika strefy %d na magistrali", z);
+    } else {
+      logger->addLog("TEMPERATURE", "warning", "Strefa %d bez przypisanego czujnika - komenda tempsensor", z);
+    }
+  }
+}
+
+// Skip-ROM + Convert T - wszystkie czujniki mierzą jednocześnie
+bool TemperatureManager::startConversion() {
+  bool present = wire->reset();
+  if (present) {
+    wire->skip();
+    wire->write(TEMP_CMD_CONVERT, parasite);
+  }
+  oneWireIdle(wire);
+  return present;
+}
+
+bool TemperatureManager::readScratchPad(const uint8_t* rom, uint8_t* scratch) {
+  bool present = wire->reset();
+  if (present) {
+    wire->select(rom);
+    wire->write(TEMP_CMD_READ_SCRATCH);
+    wire->read_bytes(scratch, 9);
+  }
+  oneWireIdle(wire);
+  return present;
+}
+
+// Zapis TH, TL i konfiguracji tylko do scratchpadu - bez Copy Scratchpad,
+// więc EEPROM czujnika się nie zużywa
+void TemperatureManager::writeScratchPad(const uint8_t* rom, const uint8_t* scratch) {
+  if (wire->reset()) {
+    wire->select(rom);
+    wire->write(TEMP_CMD_WRITE_SCRATCH);
+    wire->write(scratch[2]);
+    wire->write(scratch[3]);
+    if (rom[0] != TEMP_FAMILY_DS18S20) wire->write(scratch[4]);
+    wire->reset();
+  }
+  oneWireIdle(wire);
+}
+
+// Zwraca true po odczycie wszystkich czujników z bieżącej konwersji
+bool TemperatureManager::update() {
+  unsigned long now = millis();
+
+  if ((deviceCount == 0 || missingSensor) && !conversionPending && now - lastScan >= TEMP_RESCAN_INTERVAL_MS) {
+    scan();
+  }
+  if (deviceCount == 0) return false;
+
+  if (!conversionPending) {
+    unsigned long interval = fastRise ? TEMP_READ_INTERVAL_FAST : TEMP_READ_INTERVAL;
+    if (cycleTime == 0 || now - cycleTime >= interval) {
+      mapRoles();
+
+      // Czas konwersji wyznacza czujnik o najwyższej rozdzielczości
+      uint8_t maxResolution = TEMP_RES_MIN;
+      for (uint8_t i = 0; i < deviceCount; i++) {
+        if (devices[i].resolution > maxResolution) maxResolution = devices[i].resolution;
+      }
+      conversionMs = TEMP_CONVERSION_MS[maxResolution - TEMP_RES_MIN];
+      resolutionCycles[maxResolution - TEMP_RES_MIN]++;
+
+      int64_t busStart = esp_timer_get_time();
+      startConversion();
+      cycleBusUs = (uint32_t)(esp_timer_get_time() - busStart);
+      conversionStart = now;
+      conversionPending = true;
+      readIndex = 0;
+    }
+    return false;
+  }
+
+  if (now - conversionStart < conversionMs) {
+    return false;
+  }
+
+  int64_t busStart = esp_timer_get_time();
+  readDevice(readIndex);
+  cycleBusUs += (uint32_t)(esp_timer_get_time() - busStart);
+  readIndex++;
+  if (readIndex < deviceCount) return false;
+
+  conversionPending = false;
+  cycleTime = now;
+  cycles++;
+  totalConversionMs += conversionMs;
+  lastBusUs = cycleBusUs;
+  if (lastBusUs > maxBusUs) maxBusUs = lastBusUs;
+
+  // Szybki wzrost w dowolnej strefie skraca odstęp między konwersjami
+  fastRise = false;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    if (roleDevice[z] >= 0 && devices[roleDevice[z]].ratePerS >= TEMP_FAST_RISE) fastRise = true;
+  }
+  if (fastRise) fastCycles++;
+  return true;
+}
+
+// Odczyt scratchpadu po adresie z własną kontrolą CRC. Pojedynczy błąd CRC
+// zostawia poprzednią wartość (rośnie jej wiek), TEMP_MAX_FAILURES kolejnych
+// albo brak odpowiedzi ją unieważnia.
+bool TemperatureManager::readDevice(uint8_t index) {
+  TempSensor& device = devices[index];
+  uint8_t scratch[9];
+  device.reads++;
+
+  bool allZero = true;
+  bool present = readScratchPad(device.rom, scratch);
+  for (int i = 0; present && i < 9; i++) {
+    if (scratch[i] != 0) allZero = false;
+  }
+  if (!present || allZero) {
+    device.readErrors++;
+    if (device.failures < 0xFF) device.failures++;
+    device.celsius = DEVICE_DISCONNECTED_C;
+    return false;
+  }
+
+  if (OneWireBus::crc8(scratch, 8) != scratch[8]) {
+    device.crcErrors++;
+    if (device.failures < 0xFF) device.failures++;
+    if (device.failures >= TEMP_MAX_FAILURES) device.celsius = DEVICE_DISCONNECTED_C;
+    return false;
+  }
+  device.failures = 0;
+
+  int16_t raw = (int16_t)(((uint16_t)scratch[1] << 8) | scratch[0]);
+  float celsius;
+  if (device.rom[0] == TEMP_FAMILY_DS18S20) {
+    celsius = raw / 2.0f;
+  } else {
+    // Rejestr konfiguracji jest źródłem prawdy - czujnik po zaniku zasilania
+    // wraca do rozdzielczości z EEPROM
+    device.resolution = ((scratch[4] >> 5) & 0x03) + TEMP_RES_MIN;
+    // Przy niższej rozdzielczości najmłodsze bity są nieokreślone
+    raw &= ~((1 << (TEMP_RES_MAX - device.resolution)) - 1);
+    celsius = raw / 16.0f;
+  }
+
+  unsigned long now = millis();
+  if (device.rateRefTime == 0 || device.celsius == DEVICE_DISCONNECTED_C) {
+    device.rateRefCelsius = celsius;
+    device.rateRefTime = now;
+  } else if (now - device.rateRefTime >= TEMP_RATE_WINDOW_MS) {
+    device.ratePerS = (celsius - device.rateRefCelsius) * 1000.0f / (now - device.rateRefTime);
+    device.rateRefCelsius = celsius;
+    device.rateRefTime = now;
+  }
+  device.celsius = celsius;
+  device.readTime = now;
+
+  if (device.rom[0] != TEMP_FAMILY_DS18S20) {
+    uint8_t resolution = targetResolution(index, device);
+    if (resolution != device.resolution) applyResolution(device, scratch, resolution);
+  }
+  return true;
+}
+
+// Rozdzielczość z odległości od najbliższego progu strefy. Przy wzroście
+// liczy się też temperatura przewidywana za TEMP_LOOKAHEAD_S, a zejście
+// na niższą rozdzielczość wymaga dodatkowego TEMP_RES_HYST zapasu.
+uint8_t TemperatureManager::targetResolution(uint8_t index, const TempSensor& device) {
+  if (device.role < 0 || device.role >= ZONE_COUNT) return TEMP_AUX_RESOLUTION;
+  int zone = device.role;
+
+  float low = device.celsius;
+  float high = device.celsius + max(0.0f, device.ratePerS) * TEMP_LOOKAHEAD_S;
+  const float thresholds[] = { config->getTempMin(zone), config->getTempPrzegrzania(zone), config->getTempMax(zone) };
+
+  float distance = 1000.0f;
+  for (float threshold : thresholds) {
+    float d = threshold < low ? low - threshold : (threshold > high ? threshold - high : 0.0f);
+    if (d < distance) distance = d;
+  }
+
+  uint8_t resolution = resolutionForDistance(distance);
+  if (resolution < device.resolution) {
+    resolution = min(device.resolution, resolutionForDistance(distance - TEMP_RES_HYST));
+  }
+  return resolution;
+}
+
+// Nowa rozdzielczość obowiązuje od następnej konwersji
+void TemperatureManager::applyResolution(TempSensor& device, uint8_t* scratch, uint8_t resolution) {
+  scratch[4] = ((resolution - TEMP_RES_MIN) << 5) | 0x1F;
+  writeScratchPad(device.rom, scratch);
+  device.resolution = resolution;
+  device.resolutionSwitches++;
+  resolutionSwitches++;
+}
+
+float TemperatureManager::getTemperature(uint8_t index) {
+  if (index >= deviceCount || devices[index].readTime == 0) return DEVICE_DISCONNECTED_C;
+  if (millis() - devices[index].readTime > TEMP_MAX_AGE_MS) return DEVICE_DISCONNECTED_C;
+  return devices[index].celsius;
+}
+
+// Brak przypisanego czujnika na magistrali to brak odczytu
+float TemperatureManager::getRoleTemperature(int role) {
+  if (role < 0 || role >= TEMP_ROLE_COUNT || roleDevice[role] < 0) return DEVICE_DISCONNECTED_C;
+  return getTemperature(roleDevice[role]);
+}
+
+unsigned long TemperatureManager::getAgeMs(uint8_t index) {
+  if (index >= deviceCount || devices[index].readTime == 0) return 0;
+  return millis() - devices[index].readTime;
+}
+
+void TemperatureManager::fillSnapshot(SensorSnapshot& snapshot) {
+  snapshot.temperatureTime = cycleTime;
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    snapshot.zones[z].temperature = getZoneTemperature(z);
+    snapshot.zones[z].temperatureValid = isZoneValid(z);
+  }
+  snapshot.tempSensorCount = deviceCount;
+  for (uint8_t i = 0; i < deviceCount; i++) {
+    snapshot.tempSensors[i].celsius = getTemperature(i);
+    snapshot.tempSensors[i].readTime = devices[i].readTime;
+  }
+}
+
+void TemperatureManager::addDiagnostics(JsonObject diag) {
+  diag["count"] = deviceCount;
+  diag["cycles"] = cycles;
+  diag["conversionMs"] = conversionMs;
+  diag["avgConversionMs"] = cycles > 0 ? (uint32_t)(totalConversionMs / cycles) : 0;
+  diag["intervalMs"] = fastRise ? TEMP_READ_INTERVAL_FAST : TEMP_READ_INTERVAL;
+  diag["fastCycles"] = fastCycles;
+  diag["resolutionSwitches"] = resolutionSwitches;
+  diag["lastBusUs"] = lastBusUs;
+  diag["maxBusUs"] = maxBusUs;
+
+  JsonArray byResolution = diag.createNestedArray("cyclesByResolution");
+  for (uint32_t count : resolutionCycles) {
+    byResolution.add(count);
+  }
+
+  JsonArray list = diag.createNestedArray("sensors");
+  for (uint8_t i = 0; i < deviceCount; i++) {
+    char rom[17];
+    formatRom(devices[i].rom, rom);
+    JsonObject entry = list.createNestedObject();
+    entry["rom"] = rom;
+    entry["role"] = ConfigManager::getTempRoleName(devices[i].role);
+    entry["temp"] = devices[i].celsius;
+    entry["valid"] = isValid(i);
+    entry["failures"] = devices[i].failures;
+    entry["ageMs"] = getAgeMs(i);
+    entry["reads"] = devices[i].reads;
+    entry["crcErrors"] = devices[i].crcErrors;
+    entry["readErrors"] = devices[i].readErrors;
+    entry["resolution"] = devices[i].resolution;
+    entry["switches"] = devices[i].resolutionSwitches;
+    entry["rate"] = devices[i].ratePerS;
+  }
+}
+
+void TemperatureManager::printDiagnostics(Stream* out) {
+  out->println();
+  out->println("TEMPERATURA:");
+  out->printf("  czujników:       %u, cykli %lu (szybkich %lu), odstęp %u ms\n", deviceCount, (unsigned long)cycles,
+              (unsigned long)fastCycles, fastRise ? TEMP_READ_INTERVAL_FAST : TEMP_READ_INTERVAL);
+  out->printf("  konwersja:       %u ms, średnio %lu ms, zmian rozdzielczości %lu\n", conversionMs,
+              cycles > 0 ? (unsigned long)(totalConversionMs / cycles) : 0UL, (unsigned long)resolutionSwitches);
+  out->printf("  cykle 9/10/11/12 bit: %lu/%lu/%lu/%lu\n", (unsigned long)resolutionCycles[0], (unsigned long)resolutionCycles[1],
+              (unsigned long)resolutionCycles[2], (unsigned long)resolutionCycles[3]);
+  out->printf("  czas magistrali: ostatni %lu us, max %lu us\n", (unsigned long)lastBusUs, (unsigned long)maxBusUs);
+  for (uint8_t i = 0; i < deviceCount; i++) {
+    char rom[17];
+    formatRom(devices[i].rom, rom);
+    out->printf("  [%u] %s %-12s %6.2f C  %+.3f C/s  %2u bit  %5lu ms  CRC %lu  brak %lu / %lu\n", i, rom,
+                ConfigManager::getTempRoleName(devices[i].role), devices[i].celsius,
+                devices[i].ratePerS, devices[i].resolution, getAgeMs(i),
+                (unsigned long)devices[i].crcErrors, (unsigned long)devices[i].readErrors, (unsigned long)devices[i].reads);
+  }
+}
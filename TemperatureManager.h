@@ -0,0 +1,131 @@
+#ifndef TEMPERATURE_MANAGER_H
+#define TEMPERATURE_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "OneWireBus.h"
+#include "ConfigManager.h"
+#include "ConsoleLogger.h"
+#include "SensorSnapshot.h"
+#include "Zones.h"
+
+#define TEMP_READ_INTERVAL 1000          // ms między konwersjami
+#define TEMP_READ_INTERVAL_FAST 250      // ms, przy szybkim wzroście temperatury
+#define TEMP_RESCAN_INTERVAL_MS 30000    // ponowne wyszukiwanie, gdy brakuje przypisanego czujnika
+
+// Adaptacyjna rozdzielczość: 9 bitów (94 ms) daleko od progów strefy,
+// do 12 bitów (750 ms) tuż przy progu
+#define TEMP_RES_MIN 9
+#define TEMP_RES_MAX 12
+#define TEMP_RES_HYST 1.0                // C, histereza powrotu do niższej rozdzielczości
+#define TEMP_AUX_RESOLUTION 9            // czujniki pomocnicze nie mają progów
+#define TEMP_LOOKAHEAD_S 10              // odległość od progu liczona też dla temperatury za 10 s
+#define TEMP_FAST_RISE 0.05              // C/s (3 C/min) - próg szybkiego wzrostu
+#define TEMP_RATE_WINDOW_MS 15000        // okno szybkości zmian - dłuższe niż szum kwantyzacji 9 bitów
+#define TEMP_MAX_FAILURES 3              // kolejne nieudane odczyty (CRC) unieważniają ostatnią wartość
+#define TEMP_MAX_AGE_MS 5000             // starszy odczyt traktowany jako brak odczytu
+
+// Brak odczytu - ta sama wartość co w bibliotece DallasTemperature
+#ifndef DEVICE_DISCONNECTED_C
+#define DEVICE_DISCONNECTED_C -127
+#endif
+
+// Stan jednego czujnika DS18B20
+struct TempSensor {
+  uint8_t rom[8];
+  float celsius;              // DEVICE_DISCONNECTED_C = brak poprawnego odczytu
+  unsigned long readTime;     // ms, 0 = brak odczytu
+  uint32_t reads;
+  uint32_t crcErrors;         // scratchpad z błędną sumą CRC
+  uint32_t readErrors;        // brak odpowiedzi lub same zera (zwarcie magistrali)
+  uint8_t failures;           // kolejne nieudane odczyty, 0 po poprawnym
+  int8_t role;                // rola z mapy w ConfigManager, -1 = brak
+  uint8_t resolution;         // bity, odczytane z rejestru konfiguracji
+  uint32_t resolutionSwitches;
+  float ratePerS;             // C/s, zmiana w ostatnim oknie TEMP_RATE_WINDOW_MS
+  float rateRefCelsius;
+  unsigned long rateRefTime;  // ms, 0 = brak punktu odniesienia
+};
+
+// Wiele czujników DS18B20 na jednej magistrali 1-Wire. Komendy DS18B20
+// wysyłane są bezpośrednio przez OneWireBus, więc działają z każdym
+// sterownikiem magistrali (OneWire albo OneWireRmt). Adresy ROM
+// wyszukiwane są raz przy starcie. Jedna konwersja skip-ROM obejmuje
+// wszystkie czujniki, po czasie konwersji każdy czytany jest po adresie -
+// jeden czujnik na wywołanie update(), żeby nie wydłużać pojedynczej
+// iteracji pętli.
+//
+// Rolę czujnika (radiator strefy, obudowa, przetwornica) wyznacza adres ROM
+// przypisany w ConfigManager, nie kolejność wyszukiwania. Strefa, której
+// czujnika brak na magistrali albo która nie ma przypisania, nie ma odczytu
+// (stan awarii czujnika). Jedyny wyjątek: bez żadnych przypisań, przy jednej
+// strefie i jednym czujniku na magistrali, czujnik należy do strefy 0.
+// Brak przypisanego czujnika powoduje ponowne wyszukiwanie co
+// TEMP_RESCAN_INTERVAL_MS.
+//
+// Rozdzielczość każdego czujnika strefy dobierana jest po odczycie do
+// odległości od najbliższego progu (tempMin/tempPrzegrzania/tempMax) i
+// zapisywana tylko do scratchpadu (bez kopiowania do EEPROM czujnika).
+// Czas oczekiwania na konwersję wynika z najwyższej rozdzielczości na
+// magistrali. Przy szybkim wzroście temperatury konwersje są częstsze.
+//
+// Odczyt jest ważny najwyżej TEMP_MAX_AGE_MS i do TEMP_MAX_FAILURES
+// kolejnych błędów - potem getTemperature() zwraca DEVICE_DISCONNECTED_C,
+// a strefa przechodzi w stan awarii czujnika zamiast działać na starej wartości.
+class TemperatureManager {
+private:
+  OneWireBus* wire;
+  ConfigManager* config;
+  ConsoleLogger* logger;
+
+  TempSensor devices[TEMP_MAX_SENSORS];
+  uint8_t deviceCount;
+  int8_t roleDevice[TEMP_ROLE_COUNT];    // indeks czujnika roli, -1 = brak odczytu
+  bool missingSensor;                    // przypisanego czujnika nie ma na magistrali
+  bool parasite;                 // czujnik zasilany z linii danych
+  unsigned long lastScan;
+
+  unsigned long conversionStart;
+  unsigned long cycleTime;       // ms, koniec ostatniego pełnego cyklu
+  bool conversionPending;
+  uint8_t readIndex;             // następny czujnik do odczytu w bieżącym cyklu
+  uint32_t cycles;
+  uint32_t lastBusUs;            // czas magistrali ostatniego cyklu (bez oczekiwania na konwersję)
+  uint32_t maxBusUs;
+  uint32_t cycleBusUs;
+
+  uint16_t conversionMs;         // oczekiwanie bieżącej konwersji
+  bool fastRise;
+  uint32_t fastCycles;
+  uint32_t resolutionSwitches;
+  uint32_t resolutionCycles[TEMP_RES_MAX - TEMP_RES_MIN + 1];  // cykle wg najwyższej rozdzielczości
+  uint64_t totalConversionMs;
+
+  void scan();
+  void mapRoles();
+  bool startConversion();
+  bool readScratchPad(const uint8_t* rom, uint8_t* scratch);
+  void writeScratchPad(const uint8_t* rom, const uint8_t* scratch);
+  bool readDevice(uint8_t index);
+  uint8_t targetResolution(uint8_t index, const TempSensor& device);
+  void applyResolution(TempSensor& device, uint8_t* scratch, uint8_t resolution);
+
+public:
+  TemperatureManager();
+  void init(OneWireBus* wire, ConfigManager* config, ConsoleLogger* logger);
+  bool update();
+
+  uint8_t getDeviceCount() { return deviceCount; }
+  const uint8_t* getRom(uint8_t index) { return devices[index].rom; }
+  float getTemperature(uint8_t index);
+  bool isValid(uint8_t index) { return getTemperature(index) != DEVICE_DISCONNECTED_C; }
+  float getRoleTemperature(int role);
+  float getZoneTemperature(int zone) { return getRoleTemperature(zone); }
+  bool isZoneValid(int zone) { return getZoneTemperature(zone) != DEVICE_DISCONNECTED_C; }
+  unsigned long getAgeMs(uint8_t index);
+  void fillSnapshot(SensorSnapshot& snapshot);
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
+};
+
+#endif
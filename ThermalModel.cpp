@@ -0,0 +1,213 @@
+#include "ThermalModel.h"
+
+ThermalModel::ThermalModel() :
+  samples(0),
+  residual(0),
+  ambient(0),
+  ambientValid(false),
+  settleTemp(0),
+  settleTime(0),
+  settled(false),
+  coolingSamples(0),
+  lastUpdate(0),
+  sampleStart(0),
+  sampleTemp(0),
+  onMs(0),
+  fanMs(0),
+  lastOn(false),
+  lastFan(0),
+  timeToLimitS(-1),
+  riding(false),
+  boosted(false),
+  fanBoosts(0),
+  avoidedShutdowns(0),
+  predictedShutdowns(0) {
+  // Punkt startowy: ~0.3 C/min grzania, stała czasowa 20 min, pełny wentylator 3x szybciej
+  theta[0] = 0.005f;
+  theta[1] = 1.0f / 1200;
+  theta[2] = 2.0f / 1200;
+  memset(P, 0, sizeof(P));
+  for (int i = 0; i < 3; i++) {
+    P[i][i] = THERMAL_P0;
+  }
+}
+
+// Wywoływane przy każdym nowym odczycie temperatury strefy
+void ThermalModel::update(float temp, float limit, bool relaysOn, float fan) {
+  unsigned long now = millis();
+
+  // Ustalenie: przez THERMAL_SETTLE_MS przy wyłączonym wzmacniaczu
+  // temperatura nie odeszła od punktu odniesienia o więcej niż THERMAL_SETTLE_C
+  if (relaysOn) {
+    settleTime = 0;
+    settled = false;
+  } else if (settleTime == 0 || fabsf(temp - settleTemp) > THERMAL_SETTLE_C) {
+    settleTemp = temp;
+    settleTime = now;
+    settled = false;
+  } else if (now - settleTime >= THERMAL_SETTLE_MS) {
+    settled = true;
+  }
+
+  if (!ambientValid) {
+    ambient = temp;
+    ambientValid = true;
+  } else if (settled) {
+    // Ustalona temperatura wyłączonego wzmacniacza to otoczenie - w dół od razu, w górę powoli
+    ambient = temp < ambient ? temp : ambient + THERMAL_AMBIENT_ALPHA * (temp - ambient);
+  }
+
+  if (sampleStart == 0) {
+    sampleStart = now;
+    sampleTemp = temp;
+  } else {
+    // Udział pracy i wypełnienie ważone czasem od poprzedniego odczytu
+    unsigned long dt = now - lastUpdate;
+    if (lastOn) onMs += dt;
+    fanMs += lastFan * dt;
+
+    unsigned long elapsed = now - sampleStart;
+    if (elapsed >= THERMAL_SAMPLE_MS) {
+      float y = (temp - sampleTemp) * 1000.0f / elapsed;
+      float delta = (temp + sampleTemp) / 2 - ambient;
+      if (onMs == 0 && !settled) {
+        // Całe okno bez pracy wzmacniacza i przed ustaleniem - stygnięcie
+        coolingSamples++;
+      } else {
+        fit(y, onMs / elapsed, fanMs / elapsed, delta);
+      }
+      sampleStart = now;
+      sampleTemp = temp;
+      onMs = 0;
+      fanMs = 0;
+    }
+  }
+
+  lastUpdate = now;
+  lastOn = relaysOn;
+  lastFan = fan;
+  timeToLimitS = relaysOn && isValid() ? timeToLimit(temp, limit, fan) : -1;
+}
+
+// Krok RLS dla regresora x = [on, -delta, -fan*delta]
+void ThermalModel::fit(float y, float on, float fan, float delta) {
+  float x[3] = { on, -delta, -fan * delta };
+
+  float Px[3];
+  float denom = THERMAL_FORGET;
+  for (int i = 0; i < 3; i++) {
+    Px[i] = P[i][0] * x[0] + P[i][1] * x[1] + P[i][2] * x[2];
+    denom += x[i] * Px[i];
+  }
+
+  float error = y - (theta[0] * x[0] + theta[1] * x[1] + theta[2] * x[2]);
+  for (int i = 0; i < 3; i++) {
+    theta[i] += Px[i] / denom * error;
+  }
+
+  float trace = 0;
+  for (int i = 0; i < 3; i++) {
+    trace += P[i][i];
+  }
+  float forget = trace > THERMAL_P_MAX ? 1.0f : THERMAL_FORGET;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      P[i][j] = (P[i][j] - Px[i] * Px[j] / denom) / forget;
+    }
+  }
+
+  residual += 0.1f * (fabsf(error) - residual);
+  samples++;
+}
+
+// Prognoza używana dopiero po zebraniu danych i przy fizycznie sensownych parametrach
+bool ThermalModel::isValid() {
+  return samples >= THERMAL_MIN_SAMPLES && theta[0] > 0 && theta[1] > 0;
+}
+
+// Temperatura ustalona przy pracującym wzmacniaczu
+float ThermalModel::steadyState(float fan) {
+  return ambient + theta[0] / conductance(fan);
+}
+
+// Czas [s] do osiągnięcia limitu przy pracującym wzmacniaczu, -1 = nie osiągnie
+long ThermalModel::timeToLimit(float temp, float limit, float fan) {
+  if (temp >= limit) return 0;
+  float g = conductance(fan);
+  float tss = ambient + theta[0] / g;
+  if (tss <= limit) return -1;
+  return (long)(logf((tss - temp) / (tss - limit)) / g);
+}
+
+// Najmniejsze wypełnienie (nie mniejsze niż z krzywej), przy którym limit
+// jest dalej niż THERMAL_HORIZON_S albo nie zostanie osiągnięty
+float ThermalModel::requiredFan(float temp, float limit, float baseFan) {
+  float fan = baseFan;
+  if (isValid()) {
+    while (fan < 1.0f) {
+      long ttl = timeToLimit(temp, limit, fan);
+      if (ttl < 0 || ttl >= THERMAL_HORIZON_S) break;
+      fan = min(fan + (float)THERMAL_FAN_STEP, 1.0f);
+    }
+  }
+
+  bool boost = fan > baseFan;
+  if (boost && !boosted) fanBoosts++;
+  boosted = boost;
+  return fan;
+}
+
+// overshoot - dopuszczony zapas ponad limit [C], 0 = twardy limit
+ThermalVerdict ThermalModel::evaluate(float temp, float limit, float overshoot) {
+  ThermalVerdict verdict;
+  if (temp >= limit) {
+    bool recovers = overshoot > 0 && isValid() && temp < limit + overshoot && steadyState(1.0f) < limit;
+    verdict = recovers ? THERMAL_RIDE : THERMAL_SHUTDOWN;
+  } else if (!isValid()) {
+    verdict = THERMAL_OK;
+  } else {
+    long ttl = timeToLimit(temp, limit, 1.0f);
+    verdict = ttl >= 0 && ttl <= THERMAL_SHUTDOWN_LEAD_S ? THERMAL_SHUTDOWN : THERMAL_OK;
+    if (verdict == THERMAL_SHUTDOWN) predictedShutdowns++;
+  }
+
+  if (verdict == THERMAL_RIDE && !riding) avoidedShutdowns++;
+  riding = verdict == THERMAL_RIDE;
+  return verdict;
+}
+
+void ThermalModel::addDiagnostics(JsonObject diag) {
+  diag["valid"] = isValid();
+  diag["samples"] = samples;
+  diag["heatCps"] = theta[0];
+  diag["g0"] = theta[1];
+  diag["g1"] = theta[2];
+  diag["residualCps"] = residual;
+  diag["ambient"] = ambient;
+  diag["ambientSettled"] = settled;
+  diag["coolingSamples"] = coolingSamples;
+  diag["steadyState"] = steadyState(lastFan);
+  diag["steadyStateFullFan"] = steadyState(1.0f);
+  diag["timeToLimitS"] = timeToLimitS;
+  diag["fanBoosts"] = fanBoosts;
+  diag["avoidedShutdowns"] = avoidedShutdowns;
+  diag["predictedShutdowns"] = predictedShutdowns;
+}
+
+void ThermalModel::printDiagnostics(Stream* out) {
+  out->println();
+  out->println("MODEL CIEPLNY:");
+  out->printf("  stan:            %s, próbek %lu, błąd %.4f C/s\n", isValid() ? "aktywny" : "uczenie",
+              (unsigned long)samples, residual);
+  out->printf("  parametry:       h %.4f C/s, g0 %.5f 1/s, g1 %.5f 1/s\n", theta[0], theta[1], theta[2]);
+  out->printf("  otoczenie:       %.1f C%s, ustalona %.1f C (pełny wentylator %.1f C)\n", ambient,
+              settled ? " (ustalone)" : "", steadyState(lastFan), steadyState(1.0f));
+  out->printf("  stygnięcie:      %lu próbek pominiętych w dopasowaniu\n", (unsigned long)coolingSamples);
+  if (timeToLimitS >= 0) {
+    out->printf("  limit za:        %ld s\n", timeToLimitS);
+  } else {
+    out->println("  limit za:        -");
+  }
+  out->printf("  wentylator:      %lu podkręceń, %lu unikniętych i %lu przewidzianych wyłączeń\n",
+              (unsigned long)fanBoosts, (unsigned long)avoidedShutdowns, (unsigned long)predictedShutdowns);
+}
@@ -0,0 +1,87 @@
+#ifndef THERMAL_MODEL_H
+#define THERMAL_MODEL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define THERMAL_SAMPLE_MS 10000          // okno próbki do dopasowania modelu
+#define THERMAL_FORGET 0.995             // zapominanie RLS (~30 min pamięci przy próbce 10 s)
+#define THERMAL_P0 0.01                  // początkowa kowariancja parametrów
+#define THERMAL_P_MAX 1.0                // bez zapominania powyżej - brak pobudzenia nie rozdmuchuje P
+#define THERMAL_MIN_SAMPLES 30           // 5 min danych przed użyciem prognozy
+#define THERMAL_AMBIENT_ALPHA 0.002      // powolny wzrost estymaty otoczenia przy wyłączonym wzmacniaczu
+#define THERMAL_SETTLE_MS 300000         // wyłączony wzmacniacz ustalony po 5 min bez zmiany...
+#define THERMAL_SETTLE_C 0.5             // ...większej niż 0.5 C (LSB przy 9 bitach)
+#define THERMAL_HORIZON_S 600            // wentylator dobierany tak, by limit był dalej niż 10 min
+#define THERMAL_FAN_STEP 0.05
+#define THERMAL_SHUTDOWN_LEAD_S 30       // wyłączenie, gdy nawet pełny wentylator nie zatrzyma wzrostu
+
+enum ThermalVerdict {
+  THERMAL_OK,
+  THERMAL_RIDE,        // powyżej tempMax w dopuszczonym zapasie, pełny wentylator sprowadzi temperaturę poniżej
+  THERMAL_SHUTDOWN     // przekroczenia nie da się uniknąć
+};
+
+// Model cieplny strefy pierwszego rzędu:
+//   dT/dt = h * on - (g0 + g1 * fan) * (T - Ta)
+// on - udział czasu pracy przekaźników, fan - wypełnienie wentylatora 0..1,
+// Ta - estymata temperatury otoczenia, aktualizowana dopiero, gdy
+// temperatura wyłączonego wzmacniacza się ustali (radiator wystygł) - w
+// trakcie stygnięcia szła by za radiatorem. Próbki stygnięcia nie trafiają
+// do dopasowania: przy nieaktualnym Ta zaniżają różnicę T - Ta i
+// zawyżają g0, a model przestaje przewidywać przegrzanie.
+// Parametry h, g0, g1 dopasowywane są online (RLS z zapominaniem) z próbek
+// co THERMAL_SAMPLE_MS. Z modelu wynika temperatura ustalona i czas do
+// tempMax przy danym wypełnieniu - na tej podstawie wentylator jest
+// podkręcany z wyprzedzeniem, a wyłączenie następuje tylko wtedy, gdy
+// nawet pełny wentylator nie zatrzyma wzrostu.
+//
+// Model działa tylko poniżej tempMax - osiągnięcie tempMax zawsze oznacza
+// wyłączenie. Jazda ponad tempMax (THERMAL_RIDE) możliwa jest wyłącznie
+// przy jawnie ustawionym zapasie overshoot > 0.
+class ThermalModel {
+private:
+  float theta[3];                // h [C/s], g0 [1/s], g1 [1/s]
+  float P[3][3];
+  uint32_t samples;
+  float residual;                // średni błąd |dT/dt| [C/s]
+
+  float ambient;
+  bool ambientValid;
+  float settleTemp;              // punkt odniesienia ustalenia przy wyłączonym wzmacniaczu
+  unsigned long settleTime;      // ms, 0 = wzmacniacz pracuje
+  bool settled;
+  uint32_t coolingSamples;       // próbki stygnięcia pominięte w dopasowaniu
+
+  unsigned long lastUpdate;
+  unsigned long sampleStart;
+  float sampleTemp;
+  float onMs;
+  float fanMs;
+  bool lastOn;
+  float lastFan;
+
+  long timeToLimitS;             // przy bieżącym wypełnieniu, -1 = nie zostanie osiągnięty
+  bool riding;
+  bool boosted;
+  uint32_t fanBoosts;
+  uint32_t avoidedShutdowns;
+  uint32_t predictedShutdowns;
+
+  void fit(float y, float on, float fan, float delta);
+  float conductance(float fan) { return theta[1] + max(theta[2], 0.0f) * fan; }
+
+public:
+  ThermalModel();
+  void update(float temp, float limit, bool relaysOn, float fan);
+  bool isValid();
+  float steadyState(float fan);
+  long timeToLimit(float temp, float limit, float fan);
+  float requiredFan(float temp, float limit, float baseFan);
+  ThermalVerdict evaluate(float temp, float limit, float overshoot = 0);
+  long getTimeToLimit() { return timeToLimitS; }
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
+};
+
+#endif
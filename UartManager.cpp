@@ -1,6 +1,17 @@
 #include "UartManager.h"
+#include "Benchmark.h"
+#include "HeapMonitor.h"
+#include "RelayController.h"
+#include "BatteryGuard.h"
+#include "PowerManager.h"
+#include "AudioGate.h"
+#include "HoldTimeLearner.h"
+#include "TemperatureManager.h"
+#include "ThermalModel.h"
+#include "FanController.h"
+#include "WifiManager.h"
 
-UartManager::UartManager() : active(true), startTime(0) {
+UartManager::UartManager() : benchmark(nullptr), heapMonitor(nullptr), relayControllers(nullptr), snapshot(nullptr), batteryGuard(nullptr), powerManager(nullptr), audioGates(nullptr), holdTimeLearner(nullptr), temperatureManager(nullptr), thermalModels(nullptr), fanControllers(nullptr), wifiManager(nullptr), editZone(0), quiet(false), active(true), startTime(0) {
 }
 
 void UartManager::init(Stream* serial) {
@@ -28,42 +39,7 @@ void UartManager::parseCommands(ConfigManager* config) {
   while (serial->available()) {
     char c = serial->read();
     if (c == '\n' || c == '\r') {
-      linia.trim();
-      if (linia.startsWith("czas=")) {
-        config->setCzasPoSyg(linia.substring(5).toInt());
-        config->showSettings();
-      } else if (linia.startsWith("napiecie=")) {
-        config->setProgNapiecia(linia.substring(9).toFloat());
-        config->showSettings();
-      } else if (linia.startsWith("audio=")) {
-        config->setAudioThreshold(linia.substring(6).toFloat());
-        config->showSettings();
-      } else if (linia.startsWith("tmin=")) {
-        config->setTempMin(linia.substring(5).toFloat());
-        config->showSettings();
-      } else if (linia.startsWith("tprzegrz=")) {
-        config->setTempPrzegrzania(linia.substring(10).toFloat());
-        config->showSettings();
-      } else if (linia.startsWith("tmax=")) {
-        config->setTempMax(linia.substring(5).toFloat());
-        config->showSettings();
-      } else if (linia.startsWith("delayrelay=")) {
-        config->setDelayRelaySwitch(linia.substring(11).toInt());
-        config->showSettings();
-      } else if (linia.startsWith("savetemp=")) {
-        config->setTempSave(linia.substring(9).toFloat());
-        config->showSettings();
-      } else if (linia.equalsIgnoreCase("SAVE")) {
-        config->saveSettings();
-      } else if (linia.equalsIgnoreCase("SHOW")) {
-        config->showSettings();
-      } else if (linia.equalsIgnoreCase("HELP")) {
-        config->showSettings();
-      } else if (linia.equalsIgnoreCase("RETURN FABRIC")) {
-        config->resetToDefaults();
-      } else if (linia.equalsIgnoreCase("RESTART")) {
-        ESP.restart();
-      }
+      executeCommand(linia, config);
       serial->println();
       delay(4000);
       showCommands();
@@ -72,22 +48,279 @@ void UartManager::parseCommands(ConfigManager* config) {
   }
 }
 
+// W trybie cichym (benchmark) komendy nie wypisują ustawień
+void UartManager::echoSettings(ConfigManager* config) {
+  if (!quiet) config->showSettings();
+}
+
+void UartManager::executeCommand(String& linia, ConfigManager* config) {
+  linia.trim();
+  if (linia.startsWith("czas=")) {
+    config->setCzasPoSyg(linia.substring(5).toInt());
+    echoSettings(config);
+  } else if (linia.startsWith("napiecie=")) {
+    config->setProgNapiecia(linia.substring(9).toFloat());
+    echoSettings(config);
+  } else if (linia.startsWith("zone=")) {
+    editZone = constrain(linia.substring(5).toInt(), 0, ZONE_COUNT - 1);
+    serial->printf("Edytowana strefa: %d\n", editZone);
+  } else if (linia.startsWith("audio=")) {
+    config->setAudioThreshold(linia.substring(6).toFloat(), editZone);
+    echoSettings(config);
+  } else if (linia.startsWith("tmin=")) {
+    config->setTempMin(linia.substring(5).toFloat(), editZone);
+    echoSettings(config);
+  } else if (linia.startsWith("tprzegrz=")) {
+    config->setTempPrzegrzania(linia.substring(10).toFloat(), editZone);
+    echoSettings(config);
+  } else if (linia.startsWith("tmax=")) {
+    config->setTempMax(linia.substring(5).toFloat(), editZone);
+    echoSettings(config);
+  } else if (linia.startsWith("delayrelay=")) {
+    config->setDelayRelaySwitch(linia.substring(11).toInt(), editZone);
+    echoSettings(config);
+  } else if (linia.startsWith("audiomode=")) {
+    config->setAudioMode(linia.substring(10).toInt() == AUDIO_MODE_FLOOR ? AUDIO_MODE_FLOOR : AUDIO_MODE_ABSOLUTE);
+    echoSettings(config);
+  } else if (linia.startsWith("audiodb=")) {
+    config->setAudioFloorDb(constrain(linia.substring(8).toFloat(), 3.0f, 40.0f));
+    echoSettings(config);
+  } else if (linia.startsWith("audiohyst=")) {
+    config->setAudioHystDb(constrain(linia.substring(10).toFloat(), 0.0f, 20.0f));
+    echoSettings(config);
+  } else if (linia.startsWith("audioconfirm=")) {
+    config->setAudioConfirmMs(constrain(linia.substring(13).toInt(), 0, 2000));
+    echoSettings(config);
+  } else if (linia.startsWith("lockout=")) {
+    config->setAudioLockoutMs(constrain(linia.substring(8).toInt(), 0, 60000));
+    echoSettings(config);
+  } else if (linia.startsWith("prearm=")) {
+    config->setPreArmMs(constrain(linia.substring(7).toInt(), 0, 10000));
+    echoSettings(config);
+  } else if (linia.startsWith("holdmode=")) {
+    config->setHoldMode(linia.substring(9).toInt() == HOLD_MODE_ADAPTIVE ? HOLD_MODE_ADAPTIVE : HOLD_MODE_FIXED);
+    echoSettings(config);
+  } else if (linia.startsWith("holdpct=")) {
+    config->setHoldPercentile(constrain(linia.substring(8).toInt(), 50, 99));
+    echoSettings(config);
+  } else if (linia.startsWith("holdmin=")) {
+    config->setHoldMinS(constrain(linia.substring(8).toInt(), 5, 600));
+    echoSettings(config);
+  } else if (linia.startsWith("holdmax=")) {
+    config->setHoldMaxS(constrain(linia.substring(8).toInt(), (long)config->getHoldMinS(), 600L));
+    echoSettings(config);
+  } else if (linia.startsWith("overshoot=")) {
+    config->setTempOvershoot(constrain(linia.substring(10).toFloat(), 0.0f, (float)TEMP_OVERSHOOT_MAX));
+    echoSettings(config);
+  } else if (linia.startsWith("tempsensor=")) {
+    // tempsensor=ROLA:ADRES - ADRES to 16 znaków hex, numer [N] z listy TEMP albo '-'
+    String value = linia.substring(11);
+    int colon = value.indexOf(':');
+    int role = colon > 0 ? ConfigManager::parseTempRole(value.substring(0, colon)) : -1;
+    String address = colon > 0 ? value.substring(colon + 1) : "";
+    uint8_t rom[8];
+    bool valid = role >= 0;
+    if (valid && address == "-") {
+      config->setTempSensorRom(role, nullptr);
+    } else if (valid && address.length() == 16) {
+      for (int i = 0; i < 8 && valid; i++) {
+        char* end;
+        String byteText = address.substring(i * 2, i * 2 + 2);
+        rom[i] = (uint8_t)strtoul(byteText.c_str(), &end, 16);
+        valid = *end == '\0';
+      }
+      if (valid) config->setTempSensorRom(role, rom);
+    } else if (valid && temperatureManager && address.length() > 0 && address.length() <= 2 && isDigit(address[0]) &&
+               address.toInt() < temperatureManager->getDeviceCount()) {
+      config->setTempSensorRom(role, temperatureManager->getRom(address.toInt()));
+    } else {
+      valid = false;
+    }
+    if (valid) {
+      echoSettings(config);
+    } else {
+      serial->println("Błędne przypisanie - tempsensor=ROLA:ADRES, ROLA: strefa0..2/obudowa/przetwornica, ADRES: 16 hex, numer z TEMP lub -");
+    }
+  } else if (linia.startsWith("savetemp=")) {
+    config->setTempSave(linia.substring(9).toFloat(), editZone);
+    echoSettings(config);
+  } else if (linia.startsWith("fancurve=")) {
+    // fancurve=0:0,33:33,67:67,100:100
+    uint8_t temps[FAN_CURVE_POINTS];
+    uint8_t duties[FAN_CURVE_POINTS];
+    String values = linia.substring(9);
+    int count = 0;
+    int start = 0;
+    while (count < FAN_CURVE_POINTS && start < (int)values.length()) {
+      int end = values.indexOf(',', start);
+      if (end < 0) end = values.length();
+      String point = values.substring(start, end);
+      int colon = point.indexOf(':');
+      if (colon < 0) break;
+      temps[count] = constrain(point.substring(0, colon).toInt(), 0, 100);
+      duties[count] = constrain(point.substring(colon + 1).toInt(), 0, 100);
+      count++;
+      start = end + 1;
+    }
+    if (count != FAN_CURVE_POINTS || start < (int)values.length() || !config->setFanCurve(temps, duties)) {
+      serial->printf("Błędna krzywa - %d punktów T:D, T rosnąco, wartości 0..100\n", FAN_CURVE_POINTS);
+    } else {
+      echoSettings(config);
+    }
+  } else if (linia.startsWith("fanrpm=")) {
+    config->setFanMaxRpm(constrain(linia.substring(7).toInt(), 0, 20000));
+    echoSettings(config);
+  } else if (linia.startsWith("fanslew=")) {
+    config->setFanSlew(constrain(linia.substring(8).toInt(), 1, 100));
+    echoSettings(config);
+  } else if (linia.startsWith("tachpulses=")) {
+    config->setFanTachPulses(constrain(linia.substring(11).toInt(), 1, 4));
+    echoSettings(config);
+  } else if (linia.startsWith("relayhold=")) {
+    // relayhold=WYJŚCIE:PULLIN_MS:PROCENT, np. relayhold=1:100:60
+    String values = linia.substring(10);
+    int first = values.indexOf(':');
+    int second = first < 0 ? -1 : values.indexOf(':', first + 1);
+    int output = first < 0 ? -1 : values.substring(0, first).toInt();
+    if (second < 0 || output < 0 || output >= RELAY_OUTPUT_COUNT) {
+      serial->printf("Składnia: relayhold=WYJŚCIE:MS:PROCENT (wyjście 0..%d)\n", RELAY_OUTPUT_COUNT - 1);
+    } else {
+      config->setRelayPullInMs(constrain(values.substring(first + 1, second).toInt(), 20, 1000), output);
+      config->setRelayHoldPct(constrain(values.substring(second + 1).toInt(), 20, 100), output);
+      echoSettings(config);
+      serial->println("Włączenie/wyłączenie PWM wyjścia wymaga zapisu i restartu.");
+    }
+  } else if (linia.equalsIgnoreCase("SAVE")) {
+    config->saveSettings();
+  } else if (linia.equalsIgnoreCase("SHOW")) {
+    config->showSettings();
+  } else if (linia.equalsIgnoreCase("HELP")) {
+    config->showSettings();
+  } else if (linia.equalsIgnoreCase("RETURN FABRIC")) {
+    config->resetToDefaults();
+  } else if (linia.equalsIgnoreCase("BENCH")) {
+    if (benchmark) {
+      benchmark->runAll();
+      benchmark->printResults(serial);
+    }
+  } else if (linia.equalsIgnoreCase("HEAP")) {
+    if (heapMonitor) heapMonitor->printDiagnostics(serial);
+  } else if (linia.equalsIgnoreCase("STATUS")) {
+    showStatus();
+  } else if (linia.equalsIgnoreCase("BATT")) {
+    if (batteryGuard) batteryGuard->printDiagnostics(serial);
+  } else if (linia.equalsIgnoreCase("HOLD")) {
+    if (holdTimeLearner) holdTimeLearner->printDiagnostics(serial);
+  } else if (linia.equalsIgnoreCase("TEMP")) {
+    if (temperatureManager) temperatureManager->printDiagnostics(serial);
+  } else if (linia.equalsIgnoreCase("FAN")) {
+    if (fanControllers) {
+      for (int z = 0; z < ZONE_COUNT; z++) {
+        if (ZONE_COUNT > 1) serial->printf("\nSTREFA %d", z);
+        fanControllers[z].printDiagnostics(serial);
+      }
+    }
+  } else if (linia.equalsIgnoreCase("THERMAL")) {
+    if (thermalModels) {
+      for (int z = 0; z < ZONE_COUNT; z++) {
+        if (ZONE_COUNT > 1) serial->printf("\nSTREFA %d", z);
+        thermalModels[z].printDiagnostics(serial);
+      }
+    }
+  } else if (linia.equalsIgnoreCase("GATE")) {
+    if (audioGates) {
+      for (int z = 0; z < ZONE_COUNT; z++) {
+        if (ZONE_COUNT > 1) serial->printf("\nSTREFA %d", z);
+        audioGates[z].printDiagnostics(serial);
+      }
+    }
+  } else if (linia.equalsIgnoreCase("WIFI")) {
+    if (wifiManager) wifiManager->printDiagnostics(serial);
+  } else if (linia.equalsIgnoreCase("POWER")) {
+    if (powerManager) powerManager->printDiagnostics(serial);
+  } else if (linia.equalsIgnoreCase("RELAY")) {
+    if (relayControllers) {
+      for (int z = 0; z < ZONE_COUNT; z++) {
+        if (ZONE_COUNT > 1) serial->printf("\nSTREFA %d", z);
+        relayControllers[z].printDiagnostics(serial);
+      }
+    }
+  } else if (linia.equalsIgnoreCase("RESTART")) {
+    ESP.restart();
+  }
+}
+
+void UartManager::showStatus() {
+  if (!snapshot) return;
+  SensorSnapshot state;
+  snapshot->read(state);
+
+  serial->println();
+  serial->println("STAN:");
+  serial->printf("  akumulator:   %.2f V\n", state.batteryVoltage);
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    const ZoneSnapshot& zone = state.zones[z];
+    if (ZONE_COUNT > 1) serial->printf(" strefa %d:\n", z);
+    serial->printf("  audio:        %.3f V (szum %.3f V, próg %.3f V)\n", zone.audioEnvelope, zone.audioFloor, zone.audioTrigger);
+    if (zone.temperatureValid) {
+      serial->printf("  temperatura:  %.1f C (%lu ms temu)\n", zone.temperature, state.timestamp - state.temperatureTime);
+    } else {
+      serial->println("  temperatura:  brak odczytu");
+    }
+    serial->printf("  przekaźniki:  %s\n", zone.relaysActive ? "aktywne" : "wyłączone");
+    if (zone.timeRemaining >= 0) {
+      serial->printf("  wyłączenie za: %ld s\n", zone.timeRemaining);
+    }
+  }
+}
+
 void UartManager::showCommands() {
   serial->println();
   serial->println("DOSTEPNE KOMENDY:");
   serial->println("  czas=XX               - czas podtrzymania [s] po sygnale audio");
+  serial->println("  holdmode=X            - podtrzymanie: 0 = stałe, 1 = wyuczone z przerw");
+  serial->println("  holdpct=XX            - percentyl przerw pokrytych podtrzymaniem [%]");
+  serial->println("  holdmin=XX/holdmax=XX - granice wyuczonego podtrzymania [s]");
   serial->println("  napiecie=XX.X         - minimalne napięcie akumulatora [V]");
+  if (ZONE_COUNT > 1) {
+    serial->printf("  zone=X                - strefa dla audio/delayrelay/tmin/tprzegrz/tmax/savetemp (teraz %d)\n", editZone);
+  }
   serial->println("  audio=X.XXX           - próg detekcji sygnału audio");
+  serial->println("  audiomode=X           - detekcja: 0 = próg bezwzględny, 1 = szum + dB");
+  serial->println("  audiodb=XX            - próg ponad poziom szumu [dB] (tryb 1)");
+  serial->println("  audiohyst=X.X         - histereza progu wyłączenia [dB]");
+  serial->println("  audioconfirm=XXX      - minimalny czas sygnału przed startem [ms]");
+  serial->println("  lockout=XXXX          - blokada detekcji po wyłączeniu [ms]");
   serial->println("  delayrelay=XXXX       - opóźnienie przekaźników [ms]");
+  serial->println("  prearm=XXXX           - pre-arm przetwornicy [ms], 0 = wyłączony");
   serial->println();
   serial->println("  tmin=XX.X             - temperatura startu wentylatora [C]");
   serial->println("  tprzegrz=XX.X         - temperatura ostrzegawcza [C]");
   serial->println("  tmax=XX.X             - temperatura krytyczna [C]");
   serial->println("  savetemp=XX.X         - temperatura zakończenia chłodzenia [C]");
+  serial->println("  tempsensor=ROLA:ADRES  - czujnik roli (strefa0..2, obudowa, przetwornica): ROM hex, numer z TEMP lub -");
+  serial->println("  overshoot=X.X         - zapas ponad tmax przy prognozie spadku [C], 0 = wyłączenie na tmax");
+  serial->println("  fancurve=T:D,T:D,T:D,T:D - krzywa wentylatora: % przedziału tmin..tmax : % mocy");
+  serial->println("  fanrpm=XXXX           - obroty przy 100% (z tachometrem), 0 = bez regulacji obrotów");
+  serial->println("  fanslew=XX            - maksymalna zmiana wypełnienia [%/s]");
+  serial->println("  tachpulses=X          - impulsy tachometru na obrót");
+  serial->println("  relayhold=O:MS:PCT    - ekonomizer cewki wyjścia O (0 przetwornica, 1 głośnik): pull-in, podtrzymanie [%], 100 = wyłączony");
   serial->println();
   serial->println("  SAVE                  - zapisuje ustawienia do EEPROM");
   serial->println("  SHOW/HELP             - pokazuje zapisane ustawienia");
   serial->println("  RETURN FABRIC         - wczytuje domyślne ustawienia");
+  serial->println("  HEAP                  - stan sterty i liczniki alokacji");
+  serial->println("  STATUS                - aktualne odczyty czujników i przekaźników");
+  serial->println("  BATT                  - ochrona akumulatora i historia odcięć");
+  serial->println("  RELAY                 - czasy przełączeń i jitter przekaźników");
+  serial->println("  HOLD                  - histogram przerw i oszczędność czasu pracy");
+  serial->println("  TEMP                  - czujniki DS18B20, błędy CRC i czas magistrali");
+  serial->println("  THERMAL               - model cieplny i prognoza czasu do tempMax");
+  serial->println("  FAN                   - wentylatory: wypełnienie, obroty, alarmy zatrzymania");
+  serial->println("  GATE                  - bramka audio i odrzucone wyzwolenia");
+  serial->println("  POWER                 - stany zasilania, czas w stanach i szacowany pobór");
+  serial->println("  WIFI                  - Access Point: czas pracy, klienci, sesje");
+  serial->println("  BENCH                 - uruchamia benchmark ścieżek krytycznych");
   serial->println("  RESTART               - restartuje urządzenie");
   serial->println();
 }
@@ -3,21 +3,65 @@
 
 #include <Arduino.h>
 #include "ConfigManager.h"
+#include "SensorSnapshot.h"
+
+class BenchmarkRunner;
+class HeapMonitor;
+class RelayController;
+class BatteryGuard;
+class PowerManager;
+class AudioGate;
+class HoldTimeLearner;
+class TemperatureManager;
+class ThermalModel;
+class FanController;
+class WifiManager;
 
 class UartManager {
 private:
   Stream* serial;
+  BenchmarkRunner* benchmark;
+  HeapMonitor* heapMonitor;
+  RelayController* relayControllers;    // ZONE_COUNT stref
+  SnapshotBuffer* snapshot;
+  BatteryGuard* batteryGuard;
+  PowerManager* powerManager;
+  AudioGate* audioGates;                // ZONE_COUNT stref
+  HoldTimeLearner* holdTimeLearner;
+  TemperatureManager* temperatureManager;
+  ThermalModel* thermalModels;          // ZONE_COUNT stref
+  FanController* fanControllers;        // ZONE_COUNT stref
+  WifiManager* wifiManager;
+  int editZone;                         // strefa zmieniana komendami audio/tmin/...
+  bool quiet;                           // bez wypisywania ustawień po komendzie
   bool active;
   unsigned long startTime;
   const unsigned long UART_TIMEOUT = 120000;  // 2 minuty
 
+  void echoSettings(ConfigManager* config);
+
 public:
   UartManager();
   void init(Stream* serial);
   void checkTimeout();
+  void setBenchmark(BenchmarkRunner* benchmark) { this->benchmark = benchmark; }
+  void setHeapMonitor(HeapMonitor* heapMonitor) { this->heapMonitor = heapMonitor; }
+  void setRelayControllers(RelayController* relayControllers) { this->relayControllers = relayControllers; }
+  void setSnapshot(SnapshotBuffer* snapshot) { this->snapshot = snapshot; }
+  void setBatteryGuard(BatteryGuard* batteryGuard) { this->batteryGuard = batteryGuard; }
+  void setPowerManager(PowerManager* powerManager) { this->powerManager = powerManager; }
+  void setAudioGates(AudioGate* audioGates) { this->audioGates = audioGates; }
+  void setHoldTimeLearner(HoldTimeLearner* holdTimeLearner) { this->holdTimeLearner = holdTimeLearner; }
+  void setTemperatureManager(TemperatureManager* temperatureManager) { this->temperatureManager = temperatureManager; }
+  void setThermalModels(ThermalModel* thermalModels) { this->thermalModels = thermalModels; }
+  void setFanControllers(FanController* fanControllers) { this->fanControllers = fanControllers; }
+  void setWifiManager(WifiManager* wifiManager) { this->wifiManager = wifiManager; }
+  void showStatus();
   void parseCommands(ConfigManager* config);
+  void executeCommand(String& linia, ConfigManager* config);
   void showCommands();
   bool isActive() { return active; }
+  void setQuiet(bool quiet) { this->quiet = quiet; }
   void activate();
 };
 
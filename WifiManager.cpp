@@ -0,0 +1,146 @@
+#include "WifiManager.h"
+
+WifiManager::WifiManager() :
+  logger(nullptr),
+  eventMux(portMUX_INITIALIZER_UNLOCKED),
+  apActive(false),
+  apStartTime(0),
+  lastStationLeft(0),
+  totalApUptimeMs(0),
+  apStarts(0),
+  stationCount(0),
+  peakStations(0),
+  sessionCount(0),
+  totalSessionMs(0),
+  longestSessionMs(0),
+  lastSessionMs(0),
+  pendingConnects(0),
+  pendingDisconnects(0) {
+  memset(sessions, 0, sizeof(sessions));
+}
+
+void WifiManager::init(ConsoleLogger* logger) {
+  this->logger = logger;
+  WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) {
+    handleEvent(event, info);
+  });
+}
+
+// Callback zadania zdarzeń Arduino - bez logowania i bez Serial
+void WifiManager::handleEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  unsigned long now = millis();
+
+  portENTER_CRITICAL(&eventMux);
+  if (event == ARDUINO_EVENT_WIFI_AP_STACONNECTED) {
+    const uint8_t* mac = info.wifi_ap_staconnected.mac;
+    for (int i = 0; i < WIFI_MAX_STATIONS; i++) {
+      if (sessions[i].since == 0) {
+        memcpy(sessions[i].mac, mac, sizeof(sessions[i].mac));
+        sessions[i].since = max(now, 1UL);
+        break;
+      }
+    }
+    stationCount++;
+    if (stationCount > peakStations) peakStations = stationCount;
+    pendingConnects++;
+  } else if (event == ARDUINO_EVENT_WIFI_AP_STADISCONNECTED) {
+    const uint8_t* mac = info.wifi_ap_stadisconnected.mac;
+    for (int i = 0; i < WIFI_MAX_STATIONS; i++) {
+      if (sessions[i].since != 0 && memcmp(sessions[i].mac, mac, sizeof(sessions[i].mac)) == 0) {
+        lastSessionMs = now - sessions[i].since;
+        totalSessionMs += lastSessionMs;
+        if (lastSessionMs > longestSessionMs) longestSessionMs = lastSessionMs;
+        sessionCount++;
+        sessions[i].since = 0;
+        break;
+      }
+    }
+    if (stationCount > 0) stationCount--;
+    if (stationCount == 0) lastStationLeft = now;
+    pendingDisconnects++;
+  }
+  portEXIT_CRITICAL(&eventMux);
+}
+
+void WifiManager::start() {
+  if (apActive) return;
+  WiFi.softAP(nazwaWifi, hasloWifi);
+  apActive = true;
+  apStartTime = millis();
+  lastStationLeft = 0;
+  apStarts++;
+  logger->addLog("WIFI", "success", "Access Point uruchomiony (%s)", WiFi.softAPIP().toString().c_str());
+}
+
+void WifiManager::stop() {
+  if (!apActive) return;
+  WiFi.softAPdisconnect(true);
+  unsigned long now = millis();
+  totalApUptimeMs += now - apStartTime;
+  apActive = false;
+  closeSessions(now);
+}
+
+// Po wyłączeniu AP zdarzenia rozłączenia mogą nie przyjść - sesje zamykane tutaj
+void WifiManager::closeSessions(unsigned long now) {
+  portENTER_CRITICAL(&eventMux);
+  for (int i = 0; i < WIFI_MAX_STATIONS; i++) {
+    if (sessions[i].since == 0) continue;
+    lastSessionMs = now - sessions[i].since;
+    totalSessionMs += lastSessionMs;
+    if (lastSessionMs > longestSessionMs) longestSessionMs = lastSessionMs;
+    sessionCount++;
+    sessions[i].since = 0;
+  }
+  stationCount = 0;
+  portEXIT_CRITICAL(&eventMux);
+}
+
+void WifiManager::update() {
+  if (pendingConnects > 0 || pendingDisconnects > 0) {
+    portENTER_CRITICAL(&eventMux);
+    uint8_t connects = pendingConnects;
+    uint8_t disconnects = pendingDisconnects;
+    pendingConnects = 0;
+    pendingDisconnects = 0;
+    portEXIT_CRITICAL(&eventMux);
+
+    if (connects > 0) {
+      logger->addLog("WIFI", "info", "Klient połączony (%d aktywnych)", getStationCount());
+    }
+    if (disconnects > 0) {
+      logger->addLog("WIFI", "info", "Klient rozłączony po %lus (%d aktywnych)", lastSessionMs / 1000, getStationCount());
+    }
+  }
+
+  if (!apActive || hasStations()) return;
+  unsigned long idleSince = lastStationLeft != 0 ? lastStationLeft : apStartTime;
+  if (millis() - idleSince > WIFI_AP_TIMEOUT_MS) {
+    Serial.println("Web server timeout – brak klientów, wyłączam AP.");
+    logger->addLog("WIFI", "warning", "Timeout - wyłączanie Access Point");
+    stop();
+  }
+}
+
+void WifiManager::addDiagnostics(JsonObject diag) {
+  diag["active"] = apActive;
+  diag["uptimeS"] = getApUptimeMs() / 1000;
+  diag["totalUptimeS"] = (totalApUptimeMs + getApUptimeMs()) / 1000;
+  diag["starts"] = apStarts;
+  diag["stations"] = getStationCount();
+  diag["peakStations"] = peakStations;
+  diag["sessions"] = sessionCount;
+  diag["avgSessionS"] = sessionCount > 0 ? totalSessionMs / sessionCount / 1000 : 0;
+  diag["longestSessionS"] = longestSessionMs / 1000;
+}
+
+void WifiManager::printDiagnostics(Stream* out) {
+  out->println();
+  out->println("WIFI:");
+  out->printf("  AP:              %s, czas pracy %lus (łącznie %lus, uruchomień %lu)\n",
+              apActive ? "aktywny" : "wyłączony", getApUptimeMs() / 1000,
+              (totalApUptimeMs + getApUptimeMs()) / 1000, (unsigned long)apStarts);
+  out->printf("  klienci:         %d (maks. %u)\n", getStationCount(), peakStations);
+  out->printf("  sesje:           %lu, średnio %lus, najdłuższa %lus\n", (unsigned long)sessionCount,
+              sessionCount > 0 ? totalSessionMs / sessionCount / 1000 : 0, longestSessionMs / 1000);
+}
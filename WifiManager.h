@@ -0,0 +1,70 @@
+#ifndef WIFI_MANAGER_H
+#define WIFI_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include "ConsoleLogger.h"
+
+#define WIFI_AP_TIMEOUT_MS 120000UL    // AP bez klientów - wyłączenie po 2 minutach
+#define WIFI_MAX_STATIONS 4            // domyślny limit klientów softAP
+
+// Sesja klienta AP (od połączenia do rozłączenia)
+struct WifiStationSession {
+  uint8_t mac[6];
+  unsigned long since;         // ms, 0 = wolne miejsce
+};
+
+// Cykl życia Access Pointa sterowany zdarzeniami WiFi. Liczba klientów
+// aktualizowana jest w callbacku WiFi.onEvent (zadanie zdarzeń Arduino), więc
+// pętla nie odpytuje sterownika - hasStations() to odczyt zmiennej, a serwer
+// WWW i DNS przy zerze klientów nic nie robią. Wyłączenie AP po
+// WIFI_AP_TIMEOUT_MS bez klientów, liczone od startu AP albo od rozłączenia
+// ostatniego klienta. Wpisy do logu z kontekstu pętli (update()).
+class WifiManager {
+private:
+  ConsoleLogger* logger;
+  portMUX_TYPE eventMux;
+  const char* nazwaWifi = "Subwoofer";
+  const char* hasloWifi = "Subwoofer321";
+
+  bool apActive;
+  unsigned long apStartTime;
+  unsigned long lastStationLeft;        // ms, 0 = od startu AP nikt się nie rozłączył
+  unsigned long totalApUptimeMs;        // zakończone okresy pracy AP
+  uint32_t apStarts;
+
+  volatile uint8_t stationCount;
+  uint8_t peakStations;
+  WifiStationSession sessions[WIFI_MAX_STATIONS];
+  uint32_t sessionCount;
+  unsigned long totalSessionMs;
+  unsigned long longestSessionMs;
+  unsigned long lastSessionMs;
+
+  // Zdarzenia do zalogowania w pętli
+  volatile uint8_t pendingConnects;
+  volatile uint8_t pendingDisconnects;
+
+  void handleEvent(arduino_event_id_t event, arduino_event_info_t info);
+  void closeSessions(unsigned long now);
+
+public:
+  WifiManager();
+  void init(ConsoleLogger* logger);
+  void start();
+  void stop();
+  void update();
+
+  bool isApActive() { return apActive; }
+  bool hasStations() { return stationCount > 0; }
+  int getStationCount() { return stationCount; }
+  unsigned long getApUptimeMs() { return apActive ? millis() - apStartTime : 0; }
+  const char* getNazwaWifi() { return nazwaWifi; }
+  const char* getHasloWifi() { return hasloWifi; }
+  void addDiagnostics(JsonObject diag);
+  void printDiagnostics(Stream* out);
+};
+
+#endif
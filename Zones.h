@@ -0,0 +1,25 @@
+#ifndef ZONES_H
+#define ZONES_H
+
+#include <Arduino.h>
+
+// Liczba stref (wzmacniaczy) - każda ma własne wejście audio, parę
+// przekaźników, czujnik temperatury, wentylator i blok konfiguracji.
+// Akumulator, WiFi, UART i telemetria są wspólne.
+#ifndef ZONE_COUNT
+#define ZONE_COUNT 1
+#endif
+
+#define ZONE_MAX 3
+
+static_assert(ZONE_COUNT >= 1 && ZONE_COUNT <= ZONE_MAX, "ZONE_COUNT poza zakresem 1..ZONE_MAX");
+
+// Piny jednej strefy
+struct ZonePins {
+  int audio;      // wejście ADC
+  int power;      // przekaźnik przetwornicy
+  int speaker;    // przekaźnik głośnika
+  int fan;        // wentylator (PWM)
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Minimalny zamiennik Arduino.h do testów na PC - tylko to, czego używają
+// moduły budowane w test/. Czas sterowany przez test (hostMillis).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define HIGH 1
+#define LOW 0
+#define IRAM_ATTR
+#define constrain(a, l, h) ((a) < (l) ? (l) : ((a) > (h) ? (h) : (a)))
+
+inline unsigned long hostMillis = 0;
+
+inline unsigned long millis() {
+  return hostMillis;
+}
+
+class Stream {
+public:
+  size_t printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vprintf(format, args);
+    va_end(args);
+    return written < 0 ? 0 : written;
+  }
+  size_t print(const char* text) { return fputs(text, stdout) < 0 ? 0 : strlen(text); }
+  size_t print(unsigned long value) { return printf("%lu", value); }
+  size_t println(const char* text) { return print(text) + println(); }
+  size_t println(unsigned long value) { return print(value) + println(); }
+  size_t println(uint32_t value) { return println((unsigned long)value); }
+  size_t println() { return fputs("\n", stdout) < 0 ? 0 : 1; }
+};
+
+inline Stream Serial;
+
+#endif
@@ -0,0 +1,32 @@
+#include <stdlib.h>
+#include <new>
+
+// libstdc++ jest na PC biblioteką współdzieloną, więc -Wl,--wrap=malloc nie
+// obejmuje jej wywołań. Zastępcze operatory new kierują alokacje C++ przez
+// malloc z tego pliku - tak jak na ESP32, gdzie libstdc++ linkowana jest
+// statycznie.
+void* operator new(size_t size) {
+  void* ptr = malloc(size ? size : 1);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  free(ptr);
+}
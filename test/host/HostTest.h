@@ -0,0 +1,33 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+// Minimalne asercje testów na PC; main() zwraca hostTestResult()
+
+inline int hostTestFailures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("%s:%d: CHECK(%s) nie spełnione\n", __FILE__, __LINE__, #cond); \
+      hostTestFailures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(actual, expected) \
+  do { \
+    long long actualValue = (long long)(actual); \
+    long long expectedValue = (long long)(expected); \
+    if (actualValue != expectedValue) { \
+      printf("%s:%d: %s = %lld, oczekiwano %lld\n", __FILE__, __LINE__, #actual, actualValue, expectedValue); \
+      hostTestFailures++; \
+    } \
+  } while (0)
+
+inline int hostTestResult(const char* name) {
+  printf("%s: %s\n", name, hostTestFailures == 0 ? "OK" : "FAIL");
+  return hostTestFailures == 0 ? 0 : 1;
+}
+
+#endif
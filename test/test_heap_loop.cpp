@@ -0,0 +1,123 @@
+#include <Arduino.h>
+#include <string.h>
+#include "HostTest.h"
+#include "HeapMonitor.h"
+#include "ThermalModel.h"
+#include "RelaySequencer.h"
+
+// Wskaźnik widoczny dla kompilatora - bez niego para malloc/free w teście
+// zostaje usunięta przy optymalizacji
+static void* volatile escape;
+
+// Iteracja stanu ustalonego: odczyt temperatury co 750 ms, model cieplny
+// aktualizowany i oceniany jak w loop() szkicu
+static void thermalIteration(ThermalModel& model, unsigned long i) {
+  hostMillis += 750;
+  bool relaysOn = (i / 2000) % 2 == 0;
+  float temp = 35.0f + (relaysOn ? 0.002f : -0.001f) * (i % 2000);
+  model.update(temp, 70.0f, relaysOn, 0.3f);
+  model.requiredFan(temp, 70.0f, 0.3f);
+  model.evaluate(temp, 70.0f, 0.0f);
+}
+
+// Wyjście sekwencera bez sprzętu - timer odpalany w iteracji
+class IdleOutput : public RelaySequencerOutput {
+public:
+  bool scheduled = false;
+  int64_t due = 0;
+
+  void applyStep(uint8_t index, bool forward, int64_t now) override {}
+  void scheduleAt(int64_t due, int64_t now) override { scheduled = true; this->due = due; }
+  void cancelSchedule() override { scheduled = false; }
+  unsigned long getConfigDelayMs() override { return 3000; }
+  unsigned long getPreArmMs() override { return 2000; }
+};
+
+// Cykl pre-arm / start / wyłączenie co kilkadziesiąt iteracji
+static void relayIteration(RelaySequencer& sequencer, IdleOutput& output, unsigned long i) {
+  int64_t now = (int64_t)hostMillis * 1000;
+  switch (i % 40) {
+    case 0: sequencer.preArm(now); break;
+    case 2: sequencer.start(now); break;
+    case 20: sequencer.shutdown(now); break;
+  }
+  if (output.scheduled && output.due <= now) {
+    output.scheduled = false;
+    sequencer.timerExpired(now);
+  }
+  sequencer.takeStartupCompleted();
+  sequencer.takeShutdownCompleted();
+  sequencer.takePreArmExpired();
+}
+
+// Licznik widzi alokacje z kodu C++ i C
+static void testCounterSeesAllocations() {
+  uint32_t before = HeapMonitor::getAllocCount(HEAP_SYS_CORE);
+  float* buffer = new float[16];
+  escape = buffer;
+  char* text = (char*)calloc(8, 1);
+  escape = text;
+  delete[] buffer;
+  free(text);
+  CHECK(HeapMonitor::getAllocCount(HEAP_SYS_CORE) - before >= 2);
+}
+
+// Pętla bez alokacji przechodzi test po rozgrzewce
+static void testSteadyStatePasses() {
+  HeapMonitor monitor;
+  ThermalModel model;
+  IdleOutput output;
+  RelaySequencer sequencer(&output);
+  for (unsigned long i = 0; i < HEAP_LOOP_WARMUP + 10000; i++) {
+    monitor.beginLoop();
+    thermalIteration(model, i);
+    relayIteration(sequencer, output, i);
+    monitor.endLoop();
+  }
+  CHECK(sequencer.getSwitchCount() > 0);
+  CHECK(strcmp(monitor.getLoopCheckStatus(), "PASS") == 0);
+  CHECK_EQ(monitor.getMaxLoopAllocs(), 0);
+  CHECK_EQ(monitor.getAllocatingLoops(), 0);
+}
+
+// Pojedyncza alokująca iteracja po rozgrzewce kończy test wynikiem FAIL
+static void testAllocatingIterationFails() {
+  HeapMonitor monitor;
+  ThermalModel model;
+  for (unsigned long i = 0; i < HEAP_LOOP_WARMUP + 100; i++) {
+    monitor.beginLoop();
+    thermalIteration(model, i);
+    if (i == HEAP_LOOP_WARMUP + 50) {
+      escape = malloc(32);
+      free(escape);
+    }
+    monitor.endLoop();
+  }
+  CHECK(strcmp(monitor.getLoopCheckStatus(), "FAIL") == 0);
+  CHECK_EQ(monitor.getAllocatingLoops(), 1);
+}
+
+// Alokacje w rozgrzewce nie są błędem
+static void testWarmupAllocationsIgnored() {
+  HeapMonitor monitor;
+  for (unsigned long i = 0; i < HEAP_LOOP_WARMUP + 10; i++) {
+    monitor.beginLoop();
+    if (i == 0) {
+      escape = malloc(8);
+      free(escape);
+    }
+    monitor.endLoop();
+  }
+  CHECK(strcmp(monitor.getLoopCheckStatus(), "PASS") == 0);
+}
+
+int main() {
+  HeapMonitor loopMonitor;
+  loopMonitor.init();
+  CHECK(HeapMonitor::hasAllocHooks());
+  testCounterSeesAllocations();
+  testSteadyStatePasses();
+  testAllocatingIterationFails();
+  testWarmupAllocationsIgnored();
+  return hostTestResult("test_heap_loop");
+}
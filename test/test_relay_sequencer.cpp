@@ -0,0 +1,241 @@
+#include <Arduino.h>
+#include "HostTest.h"
+#include "RelaySequencer.h"
+
+// Trzy kroki o różnych opóźnieniach - lustro przy wyłączaniu jest widoczne
+// w odstępach. Krok 2 wymaga potwierdzenia, pre-arm wykonuje kroki 0 i 1.
+static const RelayStep TEST_STEPS[] = {
+  { 0, HIGH, 0,                  STEP_ALWAYS },
+  { 1, HIGH, 100,                STEP_ALWAYS },
+  { 2, HIGH, RELAY_DELAY_CONFIG, STEP_CONFIRMED },
+};
+static const uint8_t TEST_STEP_COUNT = sizeof(TEST_STEPS) / sizeof(TEST_STEPS[0]);
+
+#define TEST_CONFIG_DELAY_MS 250
+#define TEST_PREARM_MS 400
+#define MAX_EVENTS 32
+
+struct StepEvent {
+  uint8_t index;
+  bool forward;
+  int64_t time;
+};
+
+// Wyjście zapisujące kroki; timer odpalany przez runUntil()
+class RecordingOutput : public RelaySequencerOutput {
+public:
+  StepEvent events[MAX_EVENTS];
+  int eventCount = 0;
+  bool scheduled = false;
+  int64_t due = 0;
+  unsigned long configDelayMs = TEST_CONFIG_DELAY_MS;
+  unsigned long preArmMs = TEST_PREARM_MS;
+
+  void applyStep(uint8_t index, bool forward, int64_t now) override {
+    if (eventCount < MAX_EVENTS) events[eventCount++] = { index, forward, now };
+  }
+  void scheduleAt(int64_t due, int64_t now) override {
+    CHECK(due > now);
+    scheduled = true;
+    this->due = due;
+  }
+  void cancelSchedule() override { scheduled = false; }
+  unsigned long getConfigDelayMs() override { return configDelayMs; }
+  unsigned long getPreArmMs() override { return preArmMs; }
+};
+
+// Odpala zaplanowane terminy do chwili until [us]
+static void runUntil(RelaySequencer& sequencer, RecordingOutput& output, int64_t until) {
+  while (output.scheduled && output.due <= until) {
+    output.scheduled = false;
+    sequencer.timerExpired(output.due);
+  }
+}
+
+static void checkEvent(RecordingOutput& output, int n, uint8_t index, bool forward, int64_t time) {
+  CHECK(n < output.eventCount);
+  if (n >= output.eventCount) return;
+  CHECK_EQ(output.events[n].index, index);
+  CHECK_EQ(output.events[n].forward, forward);
+  CHECK_EQ(output.events[n].time, time);
+}
+
+static void testStartupDelays() {
+  RecordingOutput output;
+  RelaySequencer sequencer(&output, TEST_STEPS, TEST_STEP_COUNT);
+  CHECK(sequencer.start(1000));
+  CHECK_EQ(sequencer.getMode(), SEQUENCER_STARTUP);
+  runUntil(sequencer, output, 10000000);
+
+  CHECK_EQ(output.eventCount, 3);
+  checkEvent(output, 0, 0, true, 1000);
+  checkEvent(output, 1, 1, true, 1000 + 100000);
+  checkEvent(output, 2, 2, true, 1000 + 100000 + 250000);
+  CHECK_EQ(sequencer.getMode(), SEQUENCER_IDLE);
+  CHECK(sequencer.isRelaysActive());
+  CHECK(sequencer.takeStartupCompleted());
+  CHECK(!sequencer.takeStartupCompleted());
+  CHECK_EQ(sequencer.getStartupGapUs(), 350000);
+}
+
+// Krok j cofany po opóźnieniu kroku j+1: odstępy startu w odwrotnej kolejności
+static void testShutdownMirrorsStartup() {
+  RecordingOutput output;
+  RelaySequencer sequencer(&output, TEST_STEPS, TEST_STEP_COUNT);
+  sequencer.start(0);
+  runUntil(sequencer, output, 1000000);
+
+  const int64_t stop = 2000000;
+  CHECK(sequencer.shutdown(stop));
+  CHECK(!sequencer.shutdown(stop));
+  runUntil(sequencer, output, 10000000);
+
+  CHECK_EQ(output.eventCount, 6);
+  checkEvent(output, 3, 2, false, stop);
+  checkEvent(output, 4, 1, false, stop + 250000);
+  checkEvent(output, 5, 0, false, stop + 250000 + 100000);
+  CHECK_EQ(sequencer.getMode(), SEQUENCER_IDLE);
+  CHECK_EQ(sequencer.getPosition(), 0);
+  CHECK(!sequencer.isRelaysActive());
+  CHECK(sequencer.takeShutdownCompleted());
+  CHECK_EQ(sequencer.getShutdownGapUs(), 350000);
+}
+
+// Przerwany start cofa tylko wykonane kroki, spóźniony timer niczego nie zmienia
+static void testAbortMidStartup() {
+  RecordingOutput output;
+  RelaySequencer sequencer(&output, TEST_STEPS, TEST_STEP_COUNT);
+  sequencer.start(0);
+  runUntil(sequencer, output, 150000);
+  CHECK_EQ(sequencer.getPosition(), 2);
+  CHECK(output.scheduled);
+
+  CHECK(sequencer.shutdown(150000));
+  runUntil(sequencer, output, 10000000);
+  CHECK_EQ(output.eventCount, 4);
+  checkEvent(output, 2, 1, false, 150000);
+  checkEvent(output, 3, 0, false, 150000 + 100000);
+  CHECK_EQ(sequencer.getMode(), SEQUENCER_IDLE);
+  CHECK(!sequencer.isRelaysActive());
+  CHECK(!sequencer.takeShutdownCompleted());   // strefa nie była aktywna
+
+  // Callback, który czekał na mux, gdy zmieniono kierunek
+  sequencer.timerExpired(350000);
+  CHECK_EQ(output.eventCount, 4);
+  CHECK_EQ(sequencer.getPosition(), 0);
+}
+
+// Wznowienie w trakcie wyłączania nie czeka ponownie na upłynięte opóźnienie
+static void testResumeFromShutdown() {
+  RecordingOutput output;
+  RelaySequencer sequencer(&output, TEST_STEPS, TEST_STEP_COUNT);
+  sequencer.start(0);
+  runUntil(sequencer, output, 1000000);
+  sequencer.takeStartupCompleted();
+
+  sequencer.shutdown(2000000);
+  runUntil(sequencer, output, 2100000);
+  CHECK_EQ(sequencer.getPosition(), 2);
+  CHECK_EQ(sequencer.getMode(), SEQUENCER_SHUTDOWN);
+
+  CHECK(sequencer.start(2100000));
+  runUntil(sequencer, output, 10000000);
+  CHECK_EQ(output.eventCount, 5);
+  checkEvent(output, 3, 2, false, 2000000);
+  checkEvent(output, 4, 2, true, 2100000);
+  CHECK_EQ(sequencer.getMode(), SEQUENCER_IDLE);
+  CHECK(sequencer.isRelaysActive());
+  CHECK(sequencer.takeStartupCompleted());
+  CHECK(!output.scheduled);
+}
+
+// Wznowienie po cofnięciu kroku 1: krok 1 od razu (opóźnienie od kroku 0
+// minęło), krok 2 po pełnym opóźnieniu od ponownego kroku 1
+static void testResumeAfterUndoneStep() {
+  RecordingOutput output;
+  RelaySequencer sequencer(&output, TEST_STEPS, TEST_STEP_COUNT);
+  sequencer.start(0);
+  runUntil(sequencer, output, 150000);
+  sequencer.shutdown(150000);
+  CHECK_EQ(sequencer.getPosition(), 1);
+
+  sequencer.start(160000);
+  runUntil(sequencer, output, 10000000);
+  CHECK_EQ(output.eventCount, 5);
+  checkEvent(output, 2, 1, false, 150000);
+  checkEvent(output, 3, 1, true, 160000);           // 0 + 100 ms już minęło
+  checkEvent(output, 4, 2, true, 160000 + 250000);
+}
+
+// Brak potwierdzenia w preArmMs cofa kroki pre-arm
+static void testPreArmExpiry() {
+  RecordingOutput output;
+  RelaySequencer sequencer(&output, TEST_STEPS, TEST_STEP_COUNT);
+  CHECK(sequencer.preArm(0));
+  CHECK(!sequencer.preArm(1000));
+  runUntil(sequencer, output, 399999);
+  CHECK_EQ(output.eventCount, 2);
+  CHECK_EQ(sequencer.getMode(), SEQUENCER_PREARM);
+  CHECK_EQ(sequencer.getPosition(), 2);
+
+  runUntil(sequencer, output, 10000000);
+  CHECK_EQ(output.eventCount, 4);
+  checkEvent(output, 2, 1, false, 400000);
+  checkEvent(output, 3, 0, false, 400000 + 100000);
+  CHECK_EQ(sequencer.getMode(), SEQUENCER_IDLE);
+  CHECK(!sequencer.isRelaysActive());
+  CHECK(sequencer.takePreArmExpired());
+  CHECK_EQ(sequencer.getPreArmFalse(), 1);
+  CHECK(!sequencer.takeShutdownCompleted());
+}
+
+// Potwierdzenie po pre-arm skraca oczekiwanie na krok STEP_CONFIRMED
+static void testPreArmConfirmed() {
+  RecordingOutput output;
+  RelaySequencer sequencer(&output, TEST_STEPS, TEST_STEP_COUNT);
+  sequencer.preArm(0);
+  runUntil(sequencer, output, 150000);
+
+  CHECK(sequencer.start(200000));
+  CHECK_EQ(sequencer.getLastGapSavedMs(), 100);
+  CHECK_EQ(sequencer.getLastRemainingMs(), 150);
+  runUntil(sequencer, output, 10000000);
+  CHECK_EQ(output.eventCount, 3);
+  checkEvent(output, 2, 2, true, 100000 + 250000);
+  CHECK(sequencer.isRelaysActive());
+  CHECK(!sequencer.takePreArmExpired());
+}
+
+static void testPreArmDisabled() {
+  RecordingOutput output;
+  output.preArmMs = 0;
+  RelaySequencer sequencer(&output, TEST_STEPS, TEST_STEP_COUNT);
+  CHECK(!sequencer.preArm(0));
+  CHECK_EQ(output.eventCount, 0);
+}
+
+// Tablica szkicu: przetwornica od razu, głośnik po delayRelaySwitch
+static void testDefaultSequence() {
+  RecordingOutput output;
+  output.configDelayMs = 3000;
+  RelaySequencer sequencer(&output);
+  sequencer.start(0);
+  runUntil(sequencer, output, 100000000);
+  CHECK_EQ(output.eventCount, RELAY_STEP_COUNT);
+  checkEvent(output, 0, 0, true, 0);
+  checkEvent(output, 1, 1, true, 3000000);
+  CHECK_EQ(RELAY_STARTUP_STEPS[output.events[1].index].output, RELAY_OUT_SPEAKER);
+}
+
+int main() {
+  testStartupDelays();
+  testShutdownMirrorsStartup();
+  testAbortMidStartup();
+  testResumeFromShutdown();
+  testResumeAfterUndoneStep();
+  testPreArmExpiry();
+  testPreArmConfirmed();
+  testPreArmDisabled();
+  testDefaultSequence();
+  return hostTestResult("test_relay_sequencer");
+}